@@ -0,0 +1,59 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+// posix_memalign and free
+#include <cstdlib>
+// std::bad_alloc
+#include <new>
+// the container we are allocating for
+#include <vector>
+
+// alignment of every simulation array, one cache line (also the width of an AVX-512 register)
+#define CACHE_LINE_SIZE 64
+
+// minimal standard allocator returning memory aligned to a given boundary
+template <typename T, std::size_t Alignment = CACHE_LINE_SIZE>
+class AlignedAllocator
+{
+    public:
+    typedef T value_type;
+
+    // allows the container to allocate other types with the same alignment
+    template <typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    // constructors (stateless allocator)
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    // allocate n objects of type T on an aligned boundary
+    T* allocate(std::size_t n)
+    {
+        void* memory = NULL;
+        if (posix_memalign(&memory, Alignment, n * sizeof(T)) != 0)
+            throw std::bad_alloc();
+        return static_cast<T*>(memory);
+    }
+
+    // release memory obtained from allocate
+    void deallocate(T* memory, std::size_t)
+    {
+        free(memory);
+    }
+};
+
+// all aligned allocators are interchangeable
+template <typename T, typename U, std::size_t Alignment>
+bool operator == (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return true; }
+template <typename T, typename U, std::size_t Alignment>
+bool operator != (const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return false; }
+
+// a vector whose data starts on a cache line
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
+
+#endif // ALIGNED_ALLOCATOR_H
@@ -0,0 +1,212 @@
+// class declaration
+#include "BlockSparseMatrix.h"
+
+// the pool the products run on
+#include "ThreadPool.h"
+
+// sorting the columns of a row
+#include <algorithm>
+
+// SSE is part of x86-64, the block columns and vector entries are one register each
+#if defined(__SSE__)
+#define BLOCK_SPARSE_SSE
+#include <xmmintrin.h>
+#endif
+
+// number of rows handed to a thread at a time, also the size of the chunks the dot products are summed over
+#define BLOCK_GRAIN 512
+
+void MultiplyBlock(const float* block, const float* x, float* y)
+{
+#ifdef BLOCK_SPARSE_SSE
+    __m128 sum = _mm_mul_ps(_mm_load_ps(block), _mm_set1_ps(x[0]));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block + BLOCK_STRIDE), _mm_set1_ps(x[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block + 2 * BLOCK_STRIDE), _mm_set1_ps(x[2])));
+    _mm_store_ps(y, sum);
+#else
+    for (unsigned int r = 0; r < 3; r++)
+        y[r] = block[r] * x[0] + block[BLOCK_STRIDE + r] * x[1] + block[2 * BLOCK_STRIDE + r] * x[2];
+    y[3] = 0.0f;
+#endif
+}
+
+// constructor
+BlockSparseMatrix::BlockSparseMatrix()
+{
+    rows_ = 0;
+}
+
+// destructor
+BlockSparseMatrix::~BlockSparseMatrix()
+{
+    // arrays release themselves
+}
+
+void BlockSparseMatrix::Clear()
+{
+    rows_ = 0;
+    row_offsets_.resize(0);
+    columns_.resize(0);
+    diagonal_.resize(0);
+    spring_blocks_.resize(0);
+    values_.resize(0);
+    partial_.resize(0);
+}
+
+void BlockSparseMatrix::Build(const SpringTable &springs, unsigned int rows)
+{
+    rows_ = rows;
+    row_offsets_.assign(rows_ + 1, 0);
+    columns_.resize(0);
+    diagonal_.resize(rows_);
+    spring_blocks_.resize(springs.incidence_.size());
+
+    // a row has a block for the particle itself and one for every particle it shares a spring with
+    std::vector<unsigned int> row;
+    for (unsigned int p = 0; p < rows_; p++)
+    {
+        row.assign(1, p);
+        for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+        {
+            unsigned int s = springs.incidence_[i] >> 1;
+            row.push_back((springs.incidence_[i] & 1) ? springs.right_[s] : springs.left_[s]);
+        }
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+
+        row_offsets_[p] = columns_.size();
+        columns_.insert(columns_.end(), row.begin(), row.end());
+        row_offsets_[p + 1] = columns_.size();
+
+        // remember where every spring of the particle lands in the row
+        AlignedVector<unsigned int>::const_iterator begin = columns_.begin() + row_offsets_[p];
+        AlignedVector<unsigned int>::const_iterator end = columns_.end();
+        diagonal_[p] = std::lower_bound(begin, end, p) - columns_.begin();
+        for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+        {
+            unsigned int s = springs.incidence_[i] >> 1;
+            unsigned int other = (springs.incidence_[i] & 1) ? springs.right_[s] : springs.left_[s];
+            spring_blocks_[i] = std::lower_bound(begin, end, other) - columns_.begin();
+        }
+    }
+
+    values_.assign(BLOCK_SIZE * columns_.size(), 0.0f);
+    partial_.assign((rows_ + BLOCK_GRAIN - 1) / BLOCK_GRAIN, 0.0);
+}
+
+void BlockSparseMatrix::ZeroRow(unsigned int row)
+{
+    std::fill(values_.begin() + BLOCK_SIZE * row_offsets_[row], values_.begin() + BLOCK_SIZE * row_offsets_[row + 1], 0.0f);
+}
+
+double BlockSparseMatrix::MultiplyRows(const float* x, float* y, unsigned int first, unsigned int last) const
+{
+    double dot = 0.0;
+    for (unsigned int p = first; p < last; p++)
+    {
+        float* out = y + BLOCK_STRIDE * p;
+        const float* in = x + BLOCK_STRIDE * p;
+#ifdef BLOCK_SPARSE_SSE
+        // every block adds its three columns scaled by the entries of x
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned int b = row_offsets_[p]; b < row_offsets_[p + 1]; b++)
+        {
+            const float* block = &values_[BLOCK_SIZE * b];
+            const float* entry = x + BLOCK_STRIDE * columns_[b];
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block), _mm_set1_ps(entry[0])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block + BLOCK_STRIDE), _mm_set1_ps(entry[1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block + 2 * BLOCK_STRIDE), _mm_set1_ps(entry[2])));
+        }
+        _mm_store_ps(out, sum);
+#else
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        float product[BLOCK_STRIDE];
+        for (unsigned int b = row_offsets_[p]; b < row_offsets_[p + 1]; b++)
+        {
+            MultiplyBlock(&values_[BLOCK_SIZE * b], x + BLOCK_STRIDE * columns_[b], product);
+            for (unsigned int r = 0; r < 3; r++)
+                out[r] += product[r];
+        }
+#endif
+        dot += in[0] * out[0] + in[1] * out[1] + in[2] * out[2];
+    }
+    return dot;
+}
+
+void BlockSparseMatrix::Multiply(const AlignedVector<float> &x, AlignedVector<float> &y, ThreadPool* pool) const
+{
+    const float* in = x.data();
+    float* out = y.data();
+    ThreadPool::RunRange(pool, 0, rows_, BLOCK_GRAIN, [this, in, out] (unsigned int first, unsigned int last)
+    {
+        MultiplyRows(in, out, first, last);
+    });
+}
+
+double BlockSparseMatrix::MultiplyDot(const AlignedVector<float> &x, AlignedVector<float> &y, ThreadPool* pool)
+{
+    const float* in = x.data();
+    float* out = y.data();
+    ThreadPool::RunRange(pool, 0, rows_, BLOCK_GRAIN, [this, in, out] (unsigned int first, unsigned int last)
+    {
+        partial_[first / BLOCK_GRAIN] = MultiplyRows(in, out, first, last);
+    });
+
+    // chunks are summed in a fixed order so the result does not depend on the threads
+    double dot = 0.0;
+    for (unsigned int c = 0; c < partial_.size(); c++)
+        dot += partial_[c];
+    return dot;
+}
+
+void BlockSparseMatrix::ExtractDiagonal(AlignedVector<float> &blocks, ThreadPool* pool) const
+{
+    blocks.resize(BLOCK_SIZE * rows_);
+    ThreadPool::RunRange(pool, 0, rows_, BLOCK_GRAIN, [this, &blocks] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+            std::copy(Block(diagonal_[p]), Block(diagonal_[p]) + BLOCK_SIZE, &blocks[BLOCK_SIZE * p]);
+    });
+}
+
+void BlockSparseMatrix::ExtractInverseDiagonal(AlignedVector<float> &blocks, ThreadPool* pool) const
+{
+    blocks.assign(BLOCK_SIZE * rows_, 0.0f);
+    ThreadPool::RunRange(pool, 0, rows_, BLOCK_GRAIN, [this, &blocks] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            // element (r, c) of the diagonal block and of its inverse
+            const float* a = Block(diagonal_[p]);
+            float* inverse = &blocks[BLOCK_SIZE * p];
+            #define A(r, c) a[(c) * BLOCK_STRIDE + (r)]
+            #define INVERSE(r, c) inverse[(c) * BLOCK_STRIDE + (r)]
+
+            // transposed cofactors over the determinant
+            INVERSE(0, 0) = A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1);
+            INVERSE(0, 1) = A(0, 2) * A(2, 1) - A(0, 1) * A(2, 2);
+            INVERSE(0, 2) = A(0, 1) * A(1, 2) - A(0, 2) * A(1, 1);
+            INVERSE(1, 0) = A(1, 2) * A(2, 0) - A(1, 0) * A(2, 2);
+            INVERSE(1, 1) = A(0, 0) * A(2, 2) - A(0, 2) * A(2, 0);
+            INVERSE(1, 2) = A(0, 2) * A(1, 0) - A(0, 0) * A(1, 2);
+            INVERSE(2, 0) = A(1, 0) * A(2, 1) - A(1, 1) * A(2, 0);
+            INVERSE(2, 1) = A(0, 1) * A(2, 0) - A(0, 0) * A(2, 1);
+            INVERSE(2, 2) = A(0, 0) * A(1, 1) - A(0, 1) * A(1, 0);
+            float determinant = A(0, 0) * INVERSE(0, 0) + A(0, 1) * INVERSE(1, 0) + A(0, 2) * INVERSE(2, 0);
+
+            #undef A
+            #undef INVERSE
+
+            // a singular block is left out of the preconditioner
+            if (determinant == 0.0f)
+            {
+                std::fill(inverse, inverse + BLOCK_SIZE, 0.0f);
+                inverse[0] = inverse[BLOCK_STRIDE + 1] = inverse[2 * BLOCK_STRIDE + 2] = 1.0f;
+                continue;
+            }
+            for (unsigned int c = 0; c < 3; c++)
+                for (unsigned int r = 0; r < 3; r++)
+                    inverse[c * BLOCK_STRIDE + r] /= determinant;
+        }
+    });
+}
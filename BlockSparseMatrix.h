@@ -0,0 +1,140 @@
+#ifndef BLOCK_SPARSE_MATRIX_H
+#define BLOCK_SPARSE_MATRIX_H
+
+// the spring graph the pattern follows
+#include "Spring.h"
+
+// cache line aligned arrays
+#include "AlignedAllocator.h"
+
+#include <vector>
+
+// floats per block (3 columns of 4, the fourth row is padding) and per vector entry (x, y, z and padding),
+// so a block column or a vector entry is exactly one SSE register
+#define BLOCK_SIZE 12
+#define BLOCK_STRIDE 4
+
+// pool the products are spread over
+class ThreadPool;
+
+// square matrix of 3x3 float blocks in block compressed sparse rows (BSR). The pattern is built once from the
+// spring topology: row p has a block for particle p and for every particle it shares a spring with. Afterwards only
+// the values change, assembly code finds its blocks through Diagonal() and SpringBlock().
+// Vectors multiplied by the matrix hold BLOCK_STRIDE floats per row.
+class BlockSparseMatrix
+{
+    public:
+    // constructor
+    BlockSparseMatrix();
+    // destructor
+    ~BlockSparseMatrix();
+
+    // builds the pattern from the incidence lists of a spring table, the values are set to zero
+    void Build(const SpringTable &springs, unsigned int rows);
+    void Clear();
+
+    // number of block rows and of stored blocks
+    unsigned int Rows() const;
+    unsigned int Blocks() const;
+
+    // blocks [RowBegin(p), RowEnd(p)) make up row p, in increasing column order
+    unsigned int RowBegin(unsigned int row) const;
+    unsigned int RowEnd(unsigned int row) const;
+    unsigned int Column(unsigned int block) const;
+    // block holding the diagonal of a row
+    unsigned int Diagonal(unsigned int row) const;
+    // block of row p for the other end of incidence entry i of the spring table (springs.incidence_[i], p's list)
+    unsigned int SpringBlock(unsigned int incidence) const;
+
+    // block values, column major with a padded row (element (r, c) is at c * BLOCK_STRIDE + r)
+    float* Block(unsigned int block);
+    const float* Block(unsigned int block) const;
+    // zeroes the blocks of a row
+    void ZeroRow(unsigned int row);
+    // block += scale * a (a given as 9 floats, row major)
+    void AddToBlock(unsigned int block, const float a[9], float scale);
+
+    // y = A x
+    void Multiply(const AlignedVector<float> &x, AlignedVector<float> &y, ThreadPool* pool) const;
+    // y = A x and returns x . y, what conjugate gradient needs, summed per chunk in a fixed order
+    double MultiplyDot(const AlignedVector<float> &x, AlignedVector<float> &y, ThreadPool* pool);
+
+    // copies the diagonal blocks (BLOCK_SIZE floats per row), or their inverses for a block Jacobi preconditioner
+    void ExtractDiagonal(AlignedVector<float> &blocks, ThreadPool* pool) const;
+    void ExtractInverseDiagonal(AlignedVector<float> &blocks, ThreadPool* pool) const;
+
+    private:
+    // y = A x on rows [first, last), returns x . y over those rows
+    double MultiplyRows(const float* x, float* y, unsigned int first, unsigned int last) const;
+
+    unsigned int rows_;
+    AlignedVector<unsigned int> row_offsets_;
+    AlignedVector<unsigned int> columns_;
+    AlignedVector<unsigned int> diagonal_;
+    AlignedVector<unsigned int> spring_blocks_;
+    AlignedVector<float> values_;
+    // per chunk partial sums of MultiplyDot
+    std::vector<double> partial_;
+};
+
+//
+// Accessors
+//
+
+inline unsigned int BlockSparseMatrix::Rows() const
+{
+    return rows_;
+}
+
+inline unsigned int BlockSparseMatrix::Blocks() const
+{
+    return columns_.size();
+}
+
+inline unsigned int BlockSparseMatrix::RowBegin(unsigned int row) const
+{
+    return row_offsets_[row];
+}
+
+inline unsigned int BlockSparseMatrix::RowEnd(unsigned int row) const
+{
+    return row_offsets_[row + 1];
+}
+
+inline unsigned int BlockSparseMatrix::Column(unsigned int block) const
+{
+    return columns_[block];
+}
+
+inline unsigned int BlockSparseMatrix::Diagonal(unsigned int row) const
+{
+    return diagonal_[row];
+}
+
+inline unsigned int BlockSparseMatrix::SpringBlock(unsigned int incidence) const
+{
+    return spring_blocks_[incidence];
+}
+
+inline float* BlockSparseMatrix::Block(unsigned int block)
+{
+    return &values_[BLOCK_SIZE * block];
+}
+
+inline const float* BlockSparseMatrix::Block(unsigned int block) const
+{
+    return &values_[BLOCK_SIZE * block];
+}
+
+inline void BlockSparseMatrix::AddToBlock(unsigned int block, const float a[9], float scale)
+{
+    float* values = Block(block);
+    for (unsigned int r = 0; r < 3; r++)
+        for (unsigned int c = 0; c < 3; c++)
+            values[c * BLOCK_STRIDE + r] += scale * a[3 * r + c];
+}
+
+// y = block x for a single block and vector entry (BLOCK_STRIDE floats each)
+void MultiplyBlock(const float* block, const float* x, float* y);
+
+#endif // BLOCK_SPARSE_MATRIX_H
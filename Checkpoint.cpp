@@ -0,0 +1,339 @@
+// class declaration
+#include "Checkpoint.h"
+
+// the saved simulation
+#include "Simulation.h"
+// checkpoints are restored from a mapping
+#include "MappedFile.h"
+
+// std::max
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// the first bytes of every checkpoint
+#define CHECKPOINT_MAGIC "CLOTHCKP"
+// written as is, reads back as something else on a machine of the other byte order
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+// every section starts on a cache line
+#define CHECKPOINT_ALIGNMENT 64
+
+// the arrays of a checkpoint, in file order
+enum CheckpointSection : unsigned int
+{
+    kPositionX = 0,
+    kPositionY,
+    kPositionZ,
+    kVelocityX,
+    kVelocityY,
+    kVelocityZ,
+    kInverseMass,
+    kFlags,
+    kSpringLeft,
+    kSpringRight,
+    kSpringRest,
+    kSpringStiffness,
+    kSpringDamping,
+    kCollidables,
+    kSectionCount
+};
+
+// the kinds of collidable
+enum CollidableType : uint32_t
+{
+    kFloorCollidable = 0,
+    kSphereCollidable = 1
+};
+
+// a collidable as saved
+struct CollidableRecord
+{
+    uint32_t type;
+    float position[3];
+    float size;
+    float static_friction;
+    float kinetic_friction;
+    uint32_t reserved;
+};
+
+// the size of an element of every section
+static const size_t kElementSize[kSectionCount] =
+{
+    sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+    sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int), sizeof(float), sizeof(float), sizeof(float),
+    sizeof(CollidableRecord)
+};
+
+// the start of every file, the sections follow
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // Simulation::Scene and Simulation::Integration
+    uint32_t scene;
+    uint32_t method;
+    uint32_t adaptive_step;
+    uint32_t reserved;
+    // simulated time since the reset and time owed by Advance
+    double time;
+    double pending_time;
+    float delta_time;
+    float frame_delta_time;
+    float step_estimate;
+    // scene parameters
+    float air_resistance;
+    float gravity;
+    float kinetic;
+    float static_friction;
+    float wind;
+    float wind_dir[3];
+    float size;
+    // cloth properties
+    float cloth_mass;
+    float cloth_k;
+    float cloth_d;
+    float cloth_gravity;
+    float cloth_air;
+    float cloth_wind;
+    float y_pos;
+    // solver settings
+    uint32_t xpbd_mode;
+    uint32_t xpbd_iterations;
+    uint32_t xpbd_substeps;
+    float xpbd_relaxation;
+    uint32_t pd_iterations;
+    // offset from the start of the file and element count of every section
+    uint64_t offsets[kSectionCount];
+    uint64_t counts[kSectionCount];
+};
+
+// the next multiple of the section alignment
+static inline uint64_t AlignSection(uint64_t offset)
+{
+    return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+// copies section of the mapped file into the first elements of array, which holds at least as many. Its length,
+// padded for the vector kernels, and the zeros of the padding stay as they are
+template <typename T, typename Vector>
+static inline void CopySection(const char* const data[kSectionCount], const uint64_t counts[kSectionCount],
+                               unsigned int section, Vector &array)
+{
+    const T* first = (const T*)data[section];
+    std::copy(first, first + counts[section], array.begin());
+}
+
+bool Checkpoint::Write(const std::string &checkpoint_file, const Simulation &simulation)
+{
+    const ClothObject &object = *simulation.object_;
+    const ParticleSystem &particles = object.mass_particles_;
+    const SpringTable &springs = object.springs_;
+
+    std::vector<CollidableRecord> collidables(simulation.n_collidables_);
+    for (unsigned int obj = 0; obj < simulation.n_collidables_; obj++)
+    {
+        const Collidable* collidable = simulation.collidables_[obj];
+        CollidableRecord &record = collidables[obj];
+        memset(&record, 0, sizeof(record));
+        record.type = dynamic_cast<const Sphere*>(collidable) ? kSphereCollidable : kFloorCollidable;
+        record.position[0] = collidable->position_.x;
+        record.position[1] = collidable->position_.y;
+        record.position[2] = collidable->position_.z;
+        record.size = collidable->size_;
+        record.static_friction = collidable->static_friction_;
+        record.kinetic_friction = collidable->kinetic_friction_;
+    }
+
+    const void* data[kSectionCount] =
+    {
+        particles.pos_x_.data(), particles.pos_y_.data(), particles.pos_z_.data(),
+        particles.vel_x_.data(), particles.vel_y_.data(), particles.vel_z_.data(),
+        particles.inv_mass_.data(), particles.flags_.data(),
+        springs.left_.data(), springs.right_.data(), springs.rest_.data(), springs.k_.data(), springs.d_.data(),
+        collidables.data()
+    };
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.scene = simulation.current_scene_;
+    header.method = simulation.method_;
+    header.adaptive_step = simulation.adaptive_step_;
+    header.time = simulation.time_;
+    header.pending_time = simulation.pending_time_;
+    header.delta_time = simulation.delta_time_;
+    header.frame_delta_time = simulation.frame_delta_time_;
+    header.step_estimate = simulation.step_controller_.estimate_;
+    header.air_resistance = simulation.air_resistance_;
+    header.gravity = simulation.gravity_;
+    header.kinetic = simulation.kinetic_;
+    header.static_friction = simulation.static_;
+    header.wind = simulation.wind_;
+    header.wind_dir[0] = simulation.wind_dir_.x;
+    header.wind_dir[1] = simulation.wind_dir_.y;
+    header.wind_dir[2] = simulation.wind_dir_.z;
+    header.size = simulation.size_;
+    header.cloth_mass = object.cloth_mass_;
+    header.cloth_k = object.cloth_k_;
+    header.cloth_d = object.cloth_d_;
+    header.cloth_gravity = object.cloth_gravity_;
+    header.cloth_air = object.cloth_air_;
+    header.cloth_wind = object.cloth_wind_;
+    header.y_pos = object.y_pos_;
+    header.xpbd_mode = object.xpbd_solver_.mode_;
+    header.xpbd_iterations = object.xpbd_solver_.iterations_;
+    header.xpbd_substeps = object.xpbd_solver_.substeps_;
+    header.xpbd_relaxation = object.xpbd_solver_.relaxation_;
+    header.pd_iterations = object.projective_solver_.iterations_;
+    for (unsigned int section = kPositionX; section <= kFlags; section++)
+        header.counts[section] = particles.Size();
+    for (unsigned int section = kSpringLeft; section <= kSpringDamping; section++)
+        header.counts[section] = springs.Size();
+    header.counts[kCollidables] = collidables.size();
+    uint64_t offset = AlignSection(sizeof(header));
+    for (unsigned int section = 0; section < kSectionCount; section++)
+    {
+        header.offsets[section] = offset;
+        offset = AlignSection(offset + header.counts[section] * kElementSize[section]);
+    }
+
+    // the whole file in memory first (the padding zeroed), then one write
+    std::vector<char> blob(offset, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    for (unsigned int section = 0; section < kSectionCount; section++)
+        if (header.counts[section] > 0)
+            memcpy(blob.data() + header.offsets[section], data[section], header.counts[section] * kElementSize[section]);
+
+    // a reader never sees a half written checkpoint
+    std::string temporary = checkpoint_file + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), checkpoint_file.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::Restore(const std::string &checkpoint_file, Simulation &simulation)
+{
+    MappedFile file;
+    if (!file.Open(checkpoint_file) || file.Size() < sizeof(CheckpointHeader))
+        return false;
+
+    // the header, and every section, must be where it says within the file
+    const CheckpointHeader &header = *(const CheckpointHeader*)file.Data();
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != CHECKPOINT_VERSION
+        || header.byte_order != CHECKPOINT_BYTE_ORDER || header.scene > Simulation::kScenarioTwo
+        || header.method > Simulation::kProjectiveDynamics)
+        return false;
+    const char* data[kSectionCount];
+    for (unsigned int section = 0; section < kSectionCount; section++)
+    {
+        if (header.offsets[section] % CHECKPOINT_ALIGNMENT != 0 || header.offsets[section] > file.Size()
+            || header.counts[section] > (file.Size() - header.offsets[section]) / kElementSize[section])
+            return false;
+        data[section] = file.Data() + header.offsets[section];
+    }
+    uint64_t n_particles = header.counts[kPositionX];
+    uint64_t n_springs = header.counts[kSpringLeft];
+    for (unsigned int section = kPositionX; section <= kFlags; section++)
+        if (header.counts[section] != n_particles)
+            return false;
+    for (unsigned int section = kSpringLeft; section <= kSpringDamping; section++)
+        if (header.counts[section] != n_springs)
+            return false;
+    const CollidableRecord* collidables = (const CollidableRecord*)data[kCollidables];
+    for (uint64_t obj = 0; obj < header.counts[kCollidables]; obj++)
+        if (collidables[obj].type > kSphereCollidable)
+            return false;
+
+    // the grid scenes are built again, an .obj cloth cannot be
+    if (header.scene != simulation.current_scene_)
+    {
+        if (header.scene == Simulation::kScenarioOne)
+            simulation.SetSceneOne();
+        else if (header.scene == Simulation::kScenarioTwo)
+            simulation.SetSceneTwo();
+        else
+            return false;
+    }
+    ClothObject &object = *simulation.object_;
+    ParticleSystem &particles = object.mass_particles_;
+    SpringTable &springs = object.springs_;
+    if (n_particles != particles.Size() || n_springs != springs.Size()
+        || header.counts[kCollidables] != simulation.n_collidables_
+        || memcmp(data[kSpringLeft], springs.left_.data(), n_springs * sizeof(unsigned int)) != 0
+        || memcmp(data[kSpringRight], springs.right_.data(), n_springs * sizeof(unsigned int)) != 0)
+        return false;
+
+    CopySection<float>(data, header.counts, kPositionX, particles.pos_x_);
+    CopySection<float>(data, header.counts, kPositionY, particles.pos_y_);
+    CopySection<float>(data, header.counts, kPositionZ, particles.pos_z_);
+    CopySection<float>(data, header.counts, kVelocityX, particles.vel_x_);
+    CopySection<float>(data, header.counts, kVelocityY, particles.vel_y_);
+    CopySection<float>(data, header.counts, kVelocityZ, particles.vel_z_);
+    CopySection<float>(data, header.counts, kInverseMass, particles.inv_mass_);
+    CopySection<unsigned int>(data, header.counts, kFlags, particles.flags_);
+    CopySection<float>(data, header.counts, kSpringRest, springs.rest_);
+    CopySection<float>(data, header.counts, kSpringStiffness, springs.k_);
+    CopySection<float>(data, header.counts, kSpringDamping, springs.d_);
+    for (unsigned int obj = 0; obj < simulation.n_collidables_; obj++)
+    {
+        // another kind of collidable in the same place, made anew
+        Collidable* &collidable = simulation.collidables_[obj];
+        const CollidableRecord &record = collidables[obj];
+        glm::vec3 position(record.position[0], record.position[1], record.position[2]);
+        if ((record.type == kSphereCollidable) != (dynamic_cast<Sphere*>(collidable) != NULL))
+        {
+            delete collidable;
+            if (record.type == kSphereCollidable)
+                collidable = new Sphere(record.static_friction, record.kinetic_friction, record.size, position);
+            else
+                collidable = new Floor(record.static_friction, record.kinetic_friction, record.size, position);
+        }
+        collidable->position_ = position;
+        collidable->size_ = record.size;
+        collidable->static_friction_ = record.static_friction;
+        collidable->kinetic_friction_ = record.kinetic_friction;
+    }
+
+    simulation.method_ = (Simulation::Integration)header.method;
+    simulation.adaptive_step_ = header.adaptive_step != 0;
+    simulation.time_ = header.time;
+    simulation.pending_time_ = header.pending_time;
+    simulation.delta_time_ = header.delta_time;
+    simulation.frame_delta_time_ = header.frame_delta_time;
+    simulation.step_controller_.estimate_ = header.step_estimate;
+    simulation.air_resistance_ = header.air_resistance;
+    simulation.gravity_ = header.gravity;
+    simulation.kinetic_ = header.kinetic;
+    simulation.static_ = header.static_friction;
+    simulation.wind_ = header.wind;
+    simulation.wind_dir_ = glm::vec3(header.wind_dir[0], header.wind_dir[1], header.wind_dir[2]);
+    simulation.size_ = header.size;
+    object.cloth_mass_ = header.cloth_mass;
+    object.cloth_k_ = header.cloth_k;
+    object.cloth_d_ = header.cloth_d;
+    object.cloth_gravity_ = header.cloth_gravity;
+    object.cloth_air_ = header.cloth_air;
+    object.cloth_wind_ = header.cloth_wind;
+    object.y_pos_ = header.y_pos;
+    object.xpbd_solver_.mode_ = header.xpbd_mode == XpbdSolver::kJacobi ? XpbdSolver::kJacobi : XpbdSolver::kGaussSeidel;
+    object.xpbd_solver_.iterations_ = std::max(1u, header.xpbd_iterations);
+    object.xpbd_solver_.substeps_ = std::max(1u, header.xpbd_substeps);
+    object.xpbd_solver_.relaxation_ = header.xpbd_relaxation;
+    object.projective_solver_.iterations_ = std::max(1u, header.pd_iterations);
+    // the masses, stiffnesses or pins may differ from the ones the projective dynamics system was factored with
+    object.projective_solver_.Invalidate();
+    return true;
+}
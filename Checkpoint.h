@@ -0,0 +1,29 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+class Simulation;
+
+// format version, bumped whenever the layout of the file or the meaning of a field changes
+#define CHECKPOINT_VERSION 1
+
+// .clothckp files: the state of a running simulation, enough to carry on from it as if it had never stopped. A fixed
+// header holds the scene, the integrator and its step state (method, explicit step, step controller estimate, time owed
+// by Advance), the simulated time, the scene and cloth parameters and the solver settings; sections starting on cache
+// lines hold the particles' positions, velocities, inverse masses and flags, the springs' ends, rest lengths,
+// stiffnesses and dampings, and the collidables. The file is assembled in memory and written with a single write.
+// The topology (particles and spring ends) is not rebuilt from it, the simulation must hold the same cloth: a grid
+// scene is set up again when the checkpoint is of another one, an .obj cloth must have been read beforehand.
+class Checkpoint
+{
+    public:
+    // writes the state of simulation, through a temporary file renamed once complete, returns false on failure
+    static bool Write(const std::string &checkpoint_file, const Simulation &simulation);
+    // puts simulation back in the saved state, every array copied straight from a mapping of the file. Returns false
+    // when the file is missing, from another version or made for another cloth, the state is left as it was (in the
+    // checkpoint's grid scene if that had to be set up)
+    static bool Restore(const std::string &checkpoint_file, Simulation &simulation);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,264 @@
+// Command line runner: steps a scene without a display and writes the cloth out as .obj files
+
+// the simulated scene
+#include "Simulation.h"
+// scoped timers and the trace export
+#include "Profiler.h"
+// the frame sequence written on its own thread
+#include "FrameRecorder.h"
+// saved and restored states
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// prints the options
+static void PrintUsage(const char* program)
+{
+    printf("usage: %s [options]\n"
+           "  --scene default|one|two   built in scene (default: one)\n"
+           "  --obj FILE                cloth read from an .obj file, dropped on the floor\n"
+           "  --frames N                number of 1/60 s frames to simulate (default: 600)\n"
+           "  --method explicit|implicit|xpbd|pd\n"
+           "                            integrator (default: explicit)\n"
+           "  --mass M --stiffness K --damping D\n"
+           "                            cloth properties (default: 1, 10000, 10)\n"
+           "  --self-collision 0|1|2    off, between particles, also against triangles\n"
+           "                            (default: CLOTH_SELF_COLLISION, else off)\n"
+           "  --output FILE             .obj written after the last frame\n"
+           "  --every N                 also writes FILE_<frame>.obj every N frames\n"
+           "  --cache FILE              records every frame (every N with --every) into a .clothpc point cache\n"
+           "  --restore FILE            carries on from a checkpoint of the same scene (or .obj cloth), the method,\n"
+           "                            mass, stiffness and damping given as options replace the saved ones\n"
+           "  --checkpoint FILE         saves the state of the simulation after the last frame\n"
+           "  --trace FILE              records the phases of every step as a Chrome trace (trace_event JSON)\n"
+           "the CLOTH_* environment variables of the viewer apply as well\n", program);
+}
+
+// reads a positive count of frames, false for anything else (signs, trailing characters, zero or too large)
+static bool ParseCount(const char* value, unsigned int &count)
+{
+    if (value[0] < '0' || value[0] > '9')
+        return false;
+    char* end;
+    errno = 0;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (*end != '\0' || errno == ERANGE || parsed == 0 || parsed > UINT_MAX)
+        return false;
+    count = (unsigned int) parsed;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string scene = "one";
+    std::string obj;
+    std::string method = "explicit";
+    std::string output;
+    std::string cache;
+    std::string trace;
+    std::string restore;
+    std::string checkpoint;
+    unsigned int frames = 600;
+    unsigned int every = 0;
+    // -1 leaves the self collision as CLOTH_SELF_COLLISION configured it
+    int self_collision = -1;
+    // the defaults of the viewer's sliders
+    float mass = 1.0, stiffness = 10000.0, damping = 10.0;
+    // the options given, they replace the ones of a restored checkpoint
+    bool set_method = false, set_mass = false, set_stiffness = false, set_damping = false;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string option = argv[arg];
+        if (option == "--help" || option == "-h")
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        if (arg + 1 >= argc)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++arg];
+        if (option == "--scene")
+            scene = value;
+        else if (option == "--obj")
+            obj = value;
+        else if (option == "--frames")
+        {
+            if (!ParseCount(value, frames))
+            {
+                fprintf(stderr, "--frames takes a positive integer, not %s\n", value);
+                return 1;
+            }
+        }
+        else if (option == "--method")
+        {
+            method = value;
+            set_method = true;
+        }
+        else if (option == "--mass")
+        {
+            mass = atof(value);
+            set_mass = true;
+        }
+        else if (option == "--stiffness")
+        {
+            stiffness = atof(value);
+            set_stiffness = true;
+        }
+        else if (option == "--damping")
+        {
+            damping = atof(value);
+            set_damping = true;
+        }
+        else if (option == "--self-collision")
+        {
+            if (value[0] < '0' || value[0] > '2' || value[1] != '\0')
+            {
+                fprintf(stderr, "--self-collision takes 0, 1 or 2, not %s\n", value);
+                return 1;
+            }
+            self_collision = value[0] - '0';
+        }
+        else if (option == "--output")
+            output = value;
+        else if (option == "--every")
+        {
+            if (!ParseCount(value, every))
+            {
+                fprintf(stderr, "--every takes a positive integer, not %s\n", value);
+                return 1;
+            }
+        }
+        else if (option == "--cache")
+            cache = value;
+        else if (option == "--trace")
+            trace = value;
+        else if (option == "--restore")
+            restore = value;
+        else if (option == "--checkpoint")
+            checkpoint = value;
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    Simulation simulation;
+    Simulation::Integration integration;
+    if (method == "explicit")
+        integration = Simulation::kExplicitEuler;
+    else if (method == "implicit")
+        integration = Simulation::kImplicitEuler;
+    else if (method == "xpbd")
+        integration = Simulation::kXpbd;
+    else if (method == "pd")
+        integration = Simulation::kProjectiveDynamics;
+    else
+    {
+        fprintf(stderr, "unknown method %s\n", method.c_str());
+        return 1;
+    }
+    simulation.method_ = integration;
+    if (self_collision >= 0)
+    {
+        simulation.object_->self_collision_.enabled_ = self_collision != 0;
+        simulation.object_->self_collision_.triangles_enabled_ = self_collision == 2;
+    }
+
+    // the properties are read when the springs and particles are made, set them before the scene
+    simulation.object_->cloth_mass_ = mass;
+    simulation.object_->cloth_k_ = stiffness;
+    simulation.object_->cloth_d_ = damping;
+    if (!obj.empty())
+    {
+        if (!simulation.ReadObjFile(obj))
+        {
+            fprintf(stderr, "could not read %s\n", obj.c_str());
+            return 1;
+        }
+        simulation.Reset();
+    }
+    else if (scene == "default")
+        simulation.SetDefaultScene();
+    else if (scene == "one")
+        simulation.SetSceneOne();
+    else if (scene == "two")
+        simulation.SetSceneTwo();
+    else
+    {
+        fprintf(stderr, "unknown scene %s\n", scene.c_str());
+        return 1;
+    }
+
+    if (!restore.empty())
+    {
+        if (!Checkpoint::Restore(restore, simulation))
+        {
+            fprintf(stderr, "could not restore %s\n", restore.c_str());
+            return 1;
+        }
+        if (set_method)
+            simulation.method_ = integration;
+        if (set_mass)
+            simulation.SetMass(mass);
+        if (set_stiffness)
+            simulation.SetStiffness(stiffness);
+        if (set_damping)
+            simulation.SetDamping(damping);
+        printf("restored %s at %.3f s\n", restore.c_str(), simulation.time_);
+    }
+
+    printf("%u particles, %u springs, %u threads\n", simulation.object_->mass_particles_.Size(),
+           simulation.object_->springs_.Size(), simulation.thread_pool_->Size());
+
+    // the frames are written while the next ones are simulated, the simulation only waits when the writer is
+    // RECORD_RING_SIZE frames behind
+    FrameRecorder recorder;
+    if (every > 0 && !output.empty())
+        recorder.Start(output, *simulation.object_, every);
+    FrameRecorder cache_recorder;
+    if (!cache.empty() && (!FrameRecorder::IsPointCache(cache)
+                           || !cache_recorder.Start(cache, *simulation.object_, std::max(every, 1u))))
+    {
+        fprintf(stderr, "cannot record a point cache into %s\n", cache.c_str());
+        return 1;
+    }
+
+    // as fast as possible, a frame is always 1/60 s of simulated time
+    Profiler::SetEnabled(!trace.empty());
+    unsigned long steps = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 1; frame <= frames; frame++)
+    {
+        PROFILE_SCOPE("Frame");
+        steps += simulation.Advance(1.0 / 60.0);
+        recorder.Capture(*simulation.object_, true);
+        cache_recorder.Capture(*simulation.object_, true);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    recorder.Stop();
+    cache_recorder.Stop();
+
+    if (!output.empty())
+        simulation.object_->WriteObject(output);
+    if (!checkpoint.empty() && !Checkpoint::Write(checkpoint, simulation))
+        fprintf(stderr, "could not write %s\n", checkpoint.c_str());
+    Profiler::SetEnabled(false);
+    if (!trace.empty() && !Profiler::WriteChromeTrace(trace))
+        fprintf(stderr, "could not write %s\n", trace.c_str());
+
+    printf("%u frames, %lu steps in %.3f s: %.1f steps/s, sim/real %.2f\n", frames, steps, seconds,
+           seconds > 0.0 ? steps / seconds : 0.0, seconds > 0.0 ? frames / 60.0 / seconds : 0.0);
+    return 0;
+}
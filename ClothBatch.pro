@@ -0,0 +1,17 @@
+# Command line runner stepping the simulation without a display:
+#   qmake ClothBatch.pro -o Makefile.batch && make -f Makefile.batch
+
+TEMPLATE = app
+TARGET = ClothBatch
+CONFIG += console
+CONFIG -= qt app_bundle
+INCLUDEPATH += .
+LIBS += -lpthread
+
+# leaves every OpenGL call out of the core
+DEFINES += CLOTH_HEADLESS
+# the objects differ from the viewer's, keep them apart
+OBJECTS_DIR = batch
+
+include(ClothCore.pri)
+SOURCES += ClothBatch.cpp
@@ -0,0 +1,472 @@
+// Microbenchmarks of the simulation hot paths over cloth grids of increasing size and loaded .obj meshes
+
+// the simulated scene
+#include "Simulation.h"
+// the cache of the scratch file
+#include "ClothCache.h"
+// the point cache write and read timings
+#include "PointCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+// mkdtemp and rmdir
+#include <unistd.h>
+
+// scratch directory made for every run under $TMPDIR (or /tmp) and removed at the end, it holds the .obj of the
+// write and read timings, its .clothbin cache and the point cache
+#define BENCH_SCRATCH "cloth_bench_XXXXXX"
+// frames in the scratch point cache
+#define BENCH_CACHE_FRAMES 60
+// largest cloths the solvers of a linear system are timed on, their steps (and the factorisation of projective
+// dynamics, about n log n entries) take too long beyond that
+#define BENCH_IMPLICIT_PARTICLES 300000
+#define BENCH_PROJECTIVE_PARTICLES 300000
+
+// options shared by every measurement
+struct BenchOptions
+{
+    // untimed runs before the timed ones
+    unsigned int warmup;
+    // timed runs, fewer when a case goes over max_time
+    unsigned int repetitions;
+    unsigned int min_repetitions;
+    double max_time;
+    // "table", "csv" or "json"
+    std::string format;
+    // only the benchmarks whose name contains filter
+    std::string filter;
+    // scratch files in the scratch directory
+    std::string obj;
+    std::string point_cache;
+};
+
+// statistics of one benchmark on one mesh
+struct BenchResult
+{
+    std::string name;
+    std::string mesh;
+    unsigned int particles;
+    unsigned int springs;
+    unsigned int repetitions;
+    double median_ns;
+    double min_ns;
+    double mean_ns;
+    double stddev_ns;
+};
+
+// runs setup then task, untimed warmup times and then timed repetitions times, setup is never timed
+static BenchResult Measure(const BenchOptions &options, const std::string &name, const std::string &mesh,
+                           unsigned int particles, unsigned int springs,
+                           const std::function<void()> &setup, const std::function<void()> &task)
+{
+    for (unsigned int run = 0; run < options.warmup; run++)
+    {
+        setup();
+        task();
+    }
+
+    std::vector<double> times;
+    double total = 0.0;
+    for (unsigned int run = 0; run < options.repetitions; run++)
+    {
+        setup();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        task();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        times.push_back(ns);
+        total += ns;
+        if (times.size() >= options.min_repetitions && total * 1e-9 > options.max_time)
+            break;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.mesh = mesh;
+    result.particles = particles;
+    result.springs = springs;
+    result.repetitions = times.size();
+    std::sort(times.begin(), times.end());
+    unsigned int middle = times.size() / 2;
+    result.median_ns = times.size() % 2 ? times[middle] : 0.5 * (times[middle - 1] + times[middle]);
+    result.min_ns = times.front();
+    result.mean_ns = total / times.size();
+    double variance = 0.0;
+    for (unsigned int run = 0; run < times.size(); run++)
+        variance += (times[run] - result.mean_ns) * (times[run] - result.mean_ns);
+    result.stddev_ns = times.size() > 1 ? std::sqrt(variance / (times.size() - 1)) : 0.0;
+    return result;
+}
+
+// every benchmark on the cloth currently in the simulation
+static void RunMesh(const BenchOptions &options, Simulation &simulation, const std::string &mesh,
+                    std::vector<BenchResult> &results)
+{
+    ClothObject* object = simulation.object_;
+    ParticleSystem &particles = object->mass_particles_;
+    SpringTable &springs = object->springs_;
+    unsigned int n_particles = particles.Size();
+    unsigned int n_springs = springs.Size();
+    glm::vec3 gravity(0.0, -simulation.gravity_, 0.0);
+    glm::vec3 wind = simulation.wind_ * simulation.wind_dir_;
+    // collidables around the cloth, it starts above them and is put back before every run
+    Floor floor(simulation.static_, simulation.kinetic_, 2.0 * simulation.size_, glm::vec3(0.0));
+    Sphere sphere(simulation.static_, simulation.kinetic_, simulation.size_ / 4.0,
+                  glm::vec3(0.0, object->y_pos_, 0.0));
+    std::function<void()> reset = [&simulation] () { simulation.Reset(); };
+    std::function<void()> nothing = [] () {};
+    // the positions of the current frame, interleaved as the point cache takes them
+    std::vector<float> positions(3 * n_particles);
+    PointCacheWriter cache_writer;
+    PointCacheReader cache_reader;
+    unsigned int cache_frame = 0;
+
+    struct Case
+    {
+        const char* name;
+        std::function<void()> setup;
+        std::function<void()> task;
+        // skipped on larger cloths, 0 for no limit
+        unsigned int max_particles = 0;
+    };
+    std::vector<Case> cases =
+    {
+        { "ComputeForces", reset, [&] () { object->ComputeForces(gravity, wind, simulation.air_resistance_); } },
+        // the per particle gather, whichever mode the simulation uses
+        { "ComputeGatheredForces", reset, [&] ()
+            {
+                ClothObject::ForceMode mode = object->force_mode_;
+                object->force_mode_ = ClothObject::kParticleGather;
+                object->ComputeForces(gravity, wind, simulation.air_resistance_);
+                object->force_mode_ = mode;
+            } },
+        // the scalar per spring path, one Spring view at a time
+        { "Spring::UpdateParticles", reset, [&] ()
+            {
+                for (unsigned int s = 0; s < n_springs; s++)
+                    Spring(&springs, &particles, s).UpdateParticles();
+            } },
+        { "Floor::ComputeCollision", reset, [&] ()
+            {
+                for (unsigned int p = 0; p < n_particles; p++)
+                    floor.ComputeCollision(PointMass(&particles, p), object->cloth_gravity_);
+            } },
+        { "Sphere::ComputeCollision", reset, [&] ()
+            {
+                for (unsigned int p = 0; p < n_particles; p++)
+                    sphere.ComputeCollision(PointMass(&particles, p), object->cloth_gravity_);
+            } },
+        { "CollideParticles", reset, [&] () { simulation.CollideParticles(simulation.delta_time_); } },
+        // on for the run whether or not the simulation has it on
+        { "SelfCollision::Resolve", reset, [&] ()
+            {
+                SelfCollision &self = object->self_collision_;
+                bool enabled = self.enabled_;
+                self.enabled_ = true;
+                self.Resolve(particles, simulation.delta_time_, simulation.thread_pool_);
+                self.enabled_ = enabled;
+            } },
+        { "StepExplicitEuler", reset, [&] () { simulation.StepExplicitEuler(); } },
+        { "StepImplicitEuler", reset, [&] () { simulation.StepImplicitEuler(); }, BENCH_IMPLICIT_PARTICLES },
+        { "StepXpbd", reset, [&] () { simulation.StepXpbd(); } },
+        { "StepProjectiveDynamics", reset, [&] () { simulation.StepProjectiveDynamics(); },
+          BENCH_PROJECTIVE_PARTICLES },
+        { "ComputeNormals", nothing, [&] () { object->ComputeNormals(); } },
+        { "WriteObject", nothing, [&] ()
+            {
+                std::string file = options.obj;
+                object->WriteObject(file);
+            } },
+        // chunks parsed on the simulation's threads
+        { "ReadObject", nothing, [&] ()
+            {
+                ClothObject loaded;
+                loaded.thread_pool_ = simulation.thread_pool_;
+                loaded.use_cache_ = false;
+                std::string file = options.obj;
+                loaded.ReadObject(file);
+            } },
+        // the mapped reader on the calling thread alone
+        { "ReadObjectMapped", nothing, [&] ()
+            {
+                ClothObject loaded;
+                loaded.obj_reader_ = ClothObject::kMappedReader;
+                loaded.use_cache_ = false;
+                std::string file = options.obj;
+                loaded.ReadObject(file);
+            } },
+        // the original line by line reader on the same file
+        { "ReadObjectStream", nothing, [&] ()
+            {
+                ClothObject loaded;
+                loaded.obj_reader_ = ClothObject::kStreamReader;
+                loaded.use_cache_ = false;
+                std::string file = options.obj;
+                loaded.ReadObject(file);
+            } },
+        // the .clothbin cache written by the first read of the file
+        { "ReadObjectCache", nothing, [&] ()
+            {
+                ClothObject loaded;
+                std::string file = options.obj;
+                loaded.ReadObject(file);
+            } },
+        // one frame coded and appended, the key frames among the others
+        { "PointCacheAppend", nothing, [&] () { cache_writer.Append(positions.data(), cache_frame++); } },
+        // the frames of the scratch cache one after the other, each decoded from the one before
+        { "PointCacheRead", nothing, [&] ()
+            {
+                cache_reader.ReadFrame(cache_frame++ % cache_reader.Frames(), particles);
+            } },
+        // a frame anywhere, decoded from its key frame
+        { "PointCacheSeek", nothing, [&] ()
+            {
+                cache_frame = (cache_frame + BENCH_CACHE_FRAMES / 2 + 7) % cache_reader.Frames();
+                cache_reader.ReadFrame(cache_frame, particles);
+            } },
+    };
+
+    for (unsigned int c = 0; c < cases.size(); c++)
+    {
+        if (std::string(cases[c].name).find(options.filter) == std::string::npos)
+            continue;
+        if (cases[c].max_particles && n_particles > cases[c].max_particles)
+        {
+            fprintf(stderr, "%-26s %-20s skipped, more than %u particles\n", cases[c].name, mesh.c_str(),
+                    cases[c].max_particles);
+            continue;
+        }
+        // the read needs a file to read, and the cached read a cache of it
+        if (std::string(cases[c].name).compare(0, 10, "ReadObject") == 0)
+        {
+            std::string file = options.obj;
+            object->WriteObject(file);
+            if (std::string(cases[c].name) == "ReadObjectCache")
+            {
+                ClothObject cached;
+                cached.ReadObject(file);
+            }
+        }
+        // the frames of a short run, appended to an open cache or read back from a closed one
+        if (std::string(cases[c].name).compare(0, 10, "PointCache") == 0)
+        {
+            simulation.Reset();
+            cache_writer.Open(options.point_cache, *object);
+            for (unsigned int frame = 0; frame < BENCH_CACHE_FRAMES; frame++)
+            {
+                simulation.Advance(1.0 / 60.0);
+                for (unsigned int p = 0; p < n_particles; p++)
+                {
+                    positions[3 * p] = particles.pos_x_[p];
+                    positions[3 * p + 1] = particles.pos_y_[p];
+                    positions[3 * p + 2] = particles.pos_z_[p];
+                }
+                cache_writer.Append(positions.data(), frame);
+            }
+            cache_frame = BENCH_CACHE_FRAMES;
+            if (std::string(cases[c].name) != "PointCacheAppend")
+            {
+                cache_writer.Close();
+                cache_reader.Open(options.point_cache);
+                cache_frame = 0;
+            }
+        }
+        results.push_back(Measure(options, cases[c].name, mesh, n_particles, n_springs, cases[c].setup, cases[c].task));
+        const BenchResult &result = results.back();
+        fprintf(stderr, "%-26s %-20s %12.0f ns\n", result.name.c_str(), result.mesh.c_str(), result.median_ns);
+        cache_writer.Close();
+        cache_reader.Close();
+    }
+    simulation.Reset();
+}
+
+// text as a JSON string, quoted, with quotes, backslashes and control characters escaped
+static std::string JsonString(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (unsigned int c = 0; c < text.size(); c++)
+    {
+        unsigned char character = text[c];
+        if (character == '"' || character == '\\')
+        {
+            quoted += '\\';
+            quoted += character;
+        }
+        else if (character < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+            quoted += escaped;
+        }
+        else
+            quoted += character;
+    }
+    return quoted + "\"";
+}
+
+// one line (or object) per result
+static void PrintResults(const BenchOptions &options, const std::vector<BenchResult> &results, unsigned int threads)
+{
+    if (options.format == "json")
+    {
+        printf("{\n  \"threads\": %u,\n  \"warmup\": %u,\n  \"results\": [\n", threads, options.warmup);
+        for (unsigned int r = 0; r < results.size(); r++)
+        {
+            const BenchResult &result = results[r];
+            printf("    {\"name\": %s, \"mesh\": %s, \"particles\": %u, \"springs\": %u, \"repetitions\": %u, "
+                   "\"median_ns\": %.1f, \"min_ns\": %.1f, \"mean_ns\": %.1f, \"stddev_ns\": %.1f, "
+                   "\"ns_per_particle\": %.4f, \"ns_per_spring\": %.4f}%s\n",
+                   JsonString(result.name).c_str(), JsonString(result.mesh).c_str(), result.particles, result.springs,
+                   result.repetitions,
+                   result.median_ns, result.min_ns, result.mean_ns, result.stddev_ns,
+                   result.particles ? result.median_ns / result.particles : 0.0,
+                   result.springs ? result.median_ns / result.springs : 0.0, r + 1 < results.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+    else if (options.format == "csv")
+    {
+        printf("name,mesh,particles,springs,threads,repetitions,median_ns,min_ns,mean_ns,stddev_ns,ns_per_particle,ns_per_spring\n");
+        for (unsigned int r = 0; r < results.size(); r++)
+        {
+            const BenchResult &result = results[r];
+            printf("%s,%s,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.4f,%.4f\n", result.name.c_str(), result.mesh.c_str(),
+                   result.particles, result.springs, threads, result.repetitions, result.median_ns, result.min_ns,
+                   result.mean_ns, result.stddev_ns, result.particles ? result.median_ns / result.particles : 0.0,
+                   result.springs ? result.median_ns / result.springs : 0.0);
+        }
+    }
+    else
+    {
+        printf("%-26s %-20s %9s %9s %14s %9s %10s %10s\n", "benchmark", "mesh", "particles", "springs", "median ns",
+               "stddev %", "ns/part", "ns/spring");
+        for (unsigned int r = 0; r < results.size(); r++)
+        {
+            const BenchResult &result = results[r];
+            printf("%-26s %-20s %9u %9u %14.0f %9.1f %10.3f %10.3f\n", result.name.c_str(), result.mesh.c_str(),
+                   result.particles, result.springs, result.median_ns,
+                   result.mean_ns > 0.0 ? 100.0 * result.stddev_ns / result.mean_ns : 0.0,
+                   result.particles ? result.median_ns / result.particles : 0.0,
+                   result.springs ? result.median_ns / result.springs : 0.0);
+        }
+    }
+}
+
+// prints the options
+static void PrintUsage(const char* program)
+{
+    printf("usage: %s [options]\n"
+           "  --sizes A,B,..     grid sizes, A x A cells each (default: 10,100,500,1000), the implicit and\n"
+           "                     projective steps are skipped above %u and %u particles\n"
+           "  --obj FILE         also runs on an .obj mesh, can be repeated\n"
+           "  --filter TEXT      only the benchmarks whose name contains TEXT\n"
+           "  --warmup N         untimed runs first (default: 2)\n"
+           "  --repetitions N    timed runs (default: 15)\n"
+           "  --max-time S       stops a benchmark after S seconds once it has 3 runs (default: 2)\n"
+           "  --format table|csv|json\n"
+           "                     output on stdout, progress goes to stderr (default: table)\n"
+           "the CLOTH_* environment variables of the viewer apply as well\n", program, BENCH_IMPLICIT_PARTICLES,
+           BENCH_PROJECTIVE_PARTICLES);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    options.warmup = 2;
+    options.repetitions = 15;
+    options.min_repetitions = 3;
+    options.max_time = 2.0;
+    options.format = "table";
+    std::vector<unsigned int> sizes = { 10, 100, 500, 1000 };
+    std::vector<std::string> objs;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string option = argv[arg];
+        if (option == "--help" || option == "-h" || arg + 1 >= argc)
+        {
+            PrintUsage(argv[0]);
+            return option == "--help" || option == "-h" ? 0 : 1;
+        }
+        std::string value = argv[++arg];
+        if (option == "--sizes")
+        {
+            sizes.clear();
+            std::stringstream list(value);
+            std::string size;
+            while (std::getline(list, size, ','))
+                sizes.push_back(atoi(size.c_str()));
+        }
+        else if (option == "--obj")
+            objs.push_back(value);
+        else if (option == "--filter")
+            options.filter = value;
+        else if (option == "--warmup")
+            options.warmup = atoi(value.c_str());
+        else if (option == "--repetitions")
+            options.repetitions = std::max(1, atoi(value.c_str()));
+        else if (option == "--max-time")
+            options.max_time = atof(value.c_str());
+        else if (option == "--format")
+            options.format = value;
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    options.min_repetitions = std::min(options.min_repetitions, options.repetitions);
+
+    const char* tmp = getenv("TMPDIR");
+    std::string scratch = std::string(tmp && *tmp ? tmp : "/tmp") + "/" + BENCH_SCRATCH;
+    if (!mkdtemp(&scratch[0]))
+    {
+        fprintf(stderr, "could not make a scratch directory %s\n", scratch.c_str());
+        return 1;
+    }
+    options.obj = scratch + "/cloth.obj";
+    options.point_cache = scratch + "/cloth.clothpc";
+
+    Simulation simulation;
+    // the defaults of the viewer's sliders
+    simulation.object_->cloth_mass_ = 1.0;
+    simulation.object_->cloth_k_ = 10000.0;
+    simulation.object_->cloth_d_ = 10.0;
+    std::vector<BenchResult> results;
+
+    for (unsigned int s = 0; s < sizes.size(); s++)
+    {
+        ClothObject* object = simulation.object_;
+        object->ClearObject();
+        object->y_pos_ = 0.75 * simulation.size_;
+        object->GenClothGrid(sizes[s], sizes[s], 1.5 * simulation.size_);
+        simulation.Reset();
+        RunMesh(options, simulation, "grid_" + std::to_string(sizes[s]), results);
+    }
+    for (unsigned int o = 0; o < objs.size(); o++)
+    {
+        simulation.object_->ClearObject();
+        if (!simulation.ReadObjFile(objs[o]))
+        {
+            fprintf(stderr, "could not read %s\n", objs[o].c_str());
+            rmdir(scratch.c_str());
+            return 1;
+        }
+        simulation.Reset();
+        std::string mesh = objs[o].substr(objs[o].find_last_of('/') + 1);
+        RunMesh(options, simulation, mesh, results);
+    }
+
+    PrintResults(options, results, simulation.thread_pool_->Size());
+    remove(options.obj.c_str());
+    remove(ClothCache::CacheFile(options.obj).c_str());
+    remove(options.point_cache.c_str());
+    rmdir(scratch.c_str());
+    return 0;
+}
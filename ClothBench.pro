@@ -0,0 +1,18 @@
+# Microbenchmarks of the simulation hot paths, without a display:
+#   qmake ClothBench.pro -o Makefile.bench && make -f Makefile.bench
+#   ./ClothBench --format json > bench.json
+
+TEMPLATE = app
+TARGET = ClothBench
+CONFIG += console
+CONFIG -= qt app_bundle
+INCLUDEPATH += .
+LIBS += -lpthread
+
+# leaves every OpenGL call out of the core
+DEFINES += CLOTH_HEADLESS
+# the objects differ from the viewer's, keep them apart
+OBJECTS_DIR = bench
+
+include(ClothCore.pri)
+SOURCES += ClothBench.cpp
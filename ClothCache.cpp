@@ -0,0 +1,239 @@
+// class declaration
+#include "ClothCache.h"
+
+// the cached object
+#include "ClothObject.h"
+// the cache is read from a mapping
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+// file modification times
+#include <sys/stat.h>
+
+// the first bytes of every cache
+#define CACHE_MAGIC "CLOTHBIN"
+// written as is, reads back as something else on a machine of the other byte order
+#define CACHE_BYTE_ORDER 0x01020304u
+// every section starts on a cache line
+#define CACHE_ALIGNMENT 64
+// spring option bits
+#define CACHE_BEND_SPRINGS 1
+
+// the arrays of a cache, in file order
+enum CacheSection : unsigned int
+{
+    kVertices = 0,
+    kNormals,
+    kTextureCoords,
+    kTriangles,
+    kSpringLeft,
+    kSpringRight,
+    kSpringRest,
+    kColorOffsets,
+    kIncidenceOffsets,
+    kIncidence,
+    kSectionCount
+};
+
+// the size of an element of every section
+static const size_t kElementSize[kSectionCount] =
+{
+    sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(ObjTriangle),
+    sizeof(unsigned int), sizeof(unsigned int), sizeof(float),
+    sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int)
+};
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vertices are stored as three packed floats");
+static_assert(sizeof(ObjTriangle) == 10 * sizeof(unsigned int), "triangles are stored as ten packed indices");
+
+// the start of every file, the sections follow
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // ClothObject::object_properties_
+    uint32_t properties;
+    // the springs made, a cache made with other options is stale
+    uint32_t spring_options;
+    // the size the vertices were scaled to, a cache for another size is stale
+    float target_size;
+    float object_size;
+    float centre[3];
+    // offset from the start of the file and element count of every section
+    uint64_t offsets[kSectionCount];
+    uint64_t counts[kSectionCount];
+};
+
+// the next multiple of the section alignment
+static inline uint64_t AlignSection(uint64_t offset)
+{
+    return (offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+std::string ClothCache::CacheFile(const std::string &obj_file)
+{
+    size_t dot = obj_file.rfind('.');
+    size_t slash = obj_file.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return obj_file + ".clothbin";
+    return obj_file.substr(0, dot) + ".clothbin";
+}
+
+bool ClothCache::IsFresh(const std::string &cache_file, const std::string &obj_file)
+{
+    struct stat cache_stat, obj_stat;
+    if (stat(cache_file.c_str(), &cache_stat) != 0 || stat(obj_file.c_str(), &obj_stat) != 0)
+        return false;
+    if (cache_stat.st_mtim.tv_sec != obj_stat.st_mtim.tv_sec)
+        return cache_stat.st_mtim.tv_sec > obj_stat.st_mtim.tv_sec;
+    return cache_stat.st_mtim.tv_nsec >= obj_stat.st_mtim.tv_nsec;
+}
+
+bool ClothCache::Write(const std::string &cache_file, const ClothObject &object)
+{
+    const SpringTable &springs = object.springs_;
+    const void* data[kSectionCount] =
+    {
+        object.vertices_.data(), object.normals_.data(), object.texture_coords_.data(), object.triangles_.data(),
+        springs.left_.data(), springs.right_.data(), springs.rest_.data(),
+        springs.color_offsets_.data(), springs.incidence_offsets_.data(), springs.incidence_.data()
+    };
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CLOTH_CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.properties = object.object_properties_;
+    header.spring_options = object.bend_springs_ ? CACHE_BEND_SPRINGS : 0;
+    header.target_size = object.target_size_;
+    header.object_size = object.object_size_;
+    header.centre[0] = object.centre_of_gravity_.x;
+    header.centre[1] = object.centre_of_gravity_.y;
+    header.centre[2] = object.centre_of_gravity_.z;
+    header.counts[kVertices] = object.vertices_.size();
+    header.counts[kNormals] = object.normals_.size();
+    header.counts[kTextureCoords] = object.texture_coords_.size();
+    header.counts[kTriangles] = object.triangles_.size();
+    header.counts[kSpringLeft] = springs.left_.size();
+    header.counts[kSpringRight] = springs.right_.size();
+    header.counts[kSpringRest] = springs.rest_.size();
+    header.counts[kColorOffsets] = springs.color_offsets_.size();
+    header.counts[kIncidenceOffsets] = springs.incidence_offsets_.size();
+    header.counts[kIncidence] = springs.incidence_.size();
+    uint64_t offset = AlignSection(sizeof(header));
+    for (unsigned int section = 0; section < kSectionCount; section++)
+    {
+        header.offsets[section] = offset;
+        offset = AlignSection(offset + header.counts[section] * kElementSize[section]);
+    }
+
+    // a reader never sees a half written cache
+    std::string temporary = cache_file + ".tmp";
+    std::ofstream file;
+    file.open(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    const char padding[CACHE_ALIGNMENT] = {};
+    file.write((const char*)&header, sizeof(header));
+    uint64_t written = sizeof(header);
+    for (unsigned int section = 0; section < kSectionCount; section++)
+    {
+        file.write(padding, header.offsets[section] - written);
+        file.write((const char*)data[section], header.counts[section] * kElementSize[section]);
+        written = header.offsets[section] + header.counts[section] * kElementSize[section];
+    }
+    file.close();
+    if (!file || rename(temporary.c_str(), cache_file.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ClothCache::Read(const std::string &cache_file, ClothObject &object)
+{
+    MappedFile file;
+    if (!file.Open(cache_file) || file.Size() < sizeof(CacheHeader))
+        return false;
+
+    // the header, and every section, must be where it says within the file
+    const CacheHeader &header = *(const CacheHeader*)file.Data();
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != CLOTH_CACHE_VERSION
+        || header.byte_order != CACHE_BYTE_ORDER || header.target_size != object.target_size_
+        || header.spring_options != (object.bend_springs_ ? CACHE_BEND_SPRINGS : 0u))
+        return false;
+    const char* data[kSectionCount];
+    for (unsigned int section = 0; section < kSectionCount; section++)
+    {
+        if (header.offsets[section] % CACHE_ALIGNMENT != 0 || header.offsets[section] > file.Size()
+            || header.counts[section] > (file.Size() - header.offsets[section]) / kElementSize[section])
+            return false;
+        data[section] = file.Data() + header.offsets[section];
+    }
+    uint64_t n_vertices = header.counts[kVertices];
+    uint64_t n_springs = header.counts[kSpringLeft];
+    if (n_vertices > UINT32_MAX || header.counts[kSpringRight] != n_springs || header.counts[kSpringRest] != n_springs
+        || header.counts[kIncidenceOffsets] != n_vertices + 1 || header.counts[kIncidence] != 2 * n_springs)
+        return false;
+
+    object.object_properties_ = header.properties;
+    object.object_size_ = header.object_size;
+    object.centre_of_gravity_ = glm::vec3(header.centre[0], header.centre[1], header.centre[2]);
+    const glm::vec3* vertices = (const glm::vec3*)data[kVertices];
+    const glm::vec3* normals = (const glm::vec3*)data[kNormals];
+    const glm::vec3* texture_coords = (const glm::vec3*)data[kTextureCoords];
+    const ObjTriangle* triangles = (const ObjTriangle*)data[kTriangles];
+    object.vertices_.assign(vertices, vertices + n_vertices);
+    object.normals_.assign(normals, normals + header.counts[kNormals]);
+    object.texture_coords_.assign(texture_coords, texture_coords + header.counts[kTextureCoords]);
+    object.triangles_.assign(triangles, triangles + header.counts[kTriangles]);
+
+    SpringTable &springs = object.springs_;
+    const unsigned int* left = (const unsigned int*)data[kSpringLeft];
+    const unsigned int* right = (const unsigned int*)data[kSpringRight];
+    const float* rest = (const float*)data[kSpringRest];
+    const unsigned int* color_offsets = (const unsigned int*)data[kColorOffsets];
+    const unsigned int* incidence_offsets = (const unsigned int*)data[kIncidenceOffsets];
+    const unsigned int* incidence = (const unsigned int*)data[kIncidence];
+    springs.left_.assign(left, left + n_springs);
+    springs.right_.assign(right, right + n_springs);
+    springs.rest_.assign(rest, rest + n_springs);
+    springs.color_offsets_.assign(color_offsets, color_offsets + header.counts[kColorOffsets]);
+    springs.incidence_offsets_.assign(incidence_offsets, incidence_offsets + n_vertices + 1);
+    springs.incidence_.assign(incidence, incidence + 2 * n_springs);
+    springs.k_.assign(n_springs, object.cloth_k_);
+    springs.d_.assign(n_springs, object.cloth_d_);
+    springs.force_x_.resize(n_springs);
+    springs.force_y_.resize(n_springs);
+    springs.force_z_.resize(n_springs);
+
+    // a stale or damaged cache must not send the simulation out of its arrays
+    for (uint64_t s = 0; s < n_springs; s++)
+        if (springs.left_[s] >= n_vertices || springs.right_[s] >= n_vertices)
+            return false;
+    // the texture and normal indices too, for the attributes the drawing and the normals read
+    bool has_textures = (object.object_properties_ & ClothObject::kHasTextures) != 0;
+    bool has_normals = (object.object_properties_ & ClothObject::kHasNormals) != 0;
+    for (uint64_t tri = 0; tri < object.triangles_.size(); tri++)
+        for (unsigned int v = 0; v < 3; v++)
+            if (object.triangles_[tri].positions[v] >= n_vertices
+                || (has_textures && object.triangles_[tri].textures[v] >= object.texture_coords_.size())
+                || (has_normals && object.triangles_[tri].normals[v] >= object.normals_.size()))
+                return false;
+    for (uint64_t c = 0; c < springs.color_offsets_.size(); c++)
+        if (springs.color_offsets_[c] > n_springs)
+            return false;
+    for (uint64_t i = 0; i < springs.incidence_.size(); i++)
+        if (springs.incidence_[i] / 2 >= n_springs)
+            return false;
+    for (uint64_t p = 0; p < n_vertices; p++)
+        if (springs.incidence_offsets_[p] > springs.incidence_offsets_[p + 1])
+            return false;
+    return springs.incidence_offsets_[0] == 0 && springs.incidence_offsets_[n_vertices] == 2 * n_springs;
+}
@@ -0,0 +1,32 @@
+#ifndef CLOTH_CACHE_H
+#define CLOTH_CACHE_H
+
+#include <string>
+
+class ClothObject;
+
+// format version, bumped whenever the layout of the file or the meaning of a section changes
+#define CLOTH_CACHE_VERSION 2
+
+// .clothbin files: a cloth read from an .obj file as ClothObject::ReadObject leaves it, the scaled vertices, normals,
+// texture coordinates, triangles and the sorted and colored spring table with its rest lengths and incidence lists.
+// A fixed header gives the offset and length of every section, each starting on a cache line so the arrays can be
+// used in place from a mapping of the file. Reading one back is a copy per array, nothing is parsed or rebuilt.
+// The particles' height, masses and the spring scalars are not stored, they come from the object's properties. A cache
+// made with or without bending springs is stale for an object that wants the other.
+class ClothCache
+{
+    public:
+    // the cache of an .obj file, cloth.obj caches to cloth.clothbin
+    static std::string CacheFile(const std::string &obj_file);
+    // true when the cache exists and was written after the last change to the .obj file
+    static bool IsFresh(const std::string &cache_file, const std::string &obj_file);
+
+    // writes the cloth out, through a temporary file renamed once complete, returns false on failure
+    static bool Write(const std::string &cache_file, const ClothObject &object);
+    // fills the geometry and springs of object, returns false when the file is missing, from another version,
+    // was made for another target size or spring options, or is inconsistent. object is left partly filled on failure
+    static bool Read(const std::string &cache_file, ClothObject &object);
+};
+
+#endif // CLOTH_CACHE_H
@@ -0,0 +1,8 @@
+# The simulation core: the cloth, its solvers, the collidables and the scenes, with no Qt or OpenGL when
+# CLOTH_HEADLESS is defined. Shared by the viewer (Dungeon3.pro) and the batch runner (ClothBatch.pro).
+
+# std::from_chars for floats in the .obj parser
+CONFIG += c++17
+
+HEADERS += AlignedAllocator.h BlockSparseMatrix.h Checkpoint.h ClothCache.h Collidable.h FrameRecorder.h ImplicitSolver.h MappedFile.h MeshEdges.h ObjParser.h ParticleSystem.h PointCache.h PointMass.h PpmImage.h Profiler.h ProjectiveSolver.h ClothObject.h SelfCollision.h Simulation.h SpatialHash.h Spring.h SpringKernels.h StepController.h ThreadPool.h Timeline.h XpbdSolver.h
+SOURCES += BlockSparseMatrix.cpp Checkpoint.cpp ClothCache.cpp Collidable.cpp FrameRecorder.cpp ImplicitSolver.cpp MappedFile.cpp MeshEdges.cpp ObjParser.cpp ParticleSystem.cpp PointCache.cpp PointMass.cpp PpmImage.cpp Profiler.cpp ProjectiveSolver.cpp ClothObject.cpp SelfCollision.cpp Simulation.cpp SpatialHash.cpp Spring.cpp SpringKernels.cpp StepController.cpp ThreadPool.cpp Timeline.cpp XpbdSolver.cpp
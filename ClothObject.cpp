@@ -6,6 +6,15 @@
 #include <iomanip>
 #include <fstream>
 #include <string>
+#include <cstring>
+
+// the fast .obj reader
+#include "MappedFile.h"
+#include "ObjParser.h"
+// binary caches of read objects
+#include "ClothCache.h"
+// the springs of read objects
+#include "MeshEdges.h"
 
 #define MAXIMUM_LINE_LENGTH 1024
 
@@ -21,12 +30,19 @@ ClothObject::ClothObject() : centre_of_gravity_(0.0,0.0,0.0)
     target_size_ = 2.0;
 
     // texture data
-    texture_ = NULL;
+    texture_.resize(0);
     width_ = height_ = 0;
+    texture_id_ = 0;
 
     // cloth data
-    mass_particles_.resize(0);
-    springs_.resize(0);
+    mass_particles_.Clear();
+    springs_.Clear();
+    particle_springs_.resize(0);
+    thread_pool_ = NULL;
+    force_mode_ = kColoredScatter;
+    obj_reader_ = kParallelReader;
+    use_cache_ = true;
+    bend_springs_ = false;
 
     // cloth properties
     cloth_mass_ = 1;
@@ -44,11 +60,11 @@ ClothObject::ClothObject() : centre_of_gravity_(0.0,0.0,0.0)
 // destructor
 ClothObject::~ClothObject()
 {
-    delete texture_;
+    // arrays release themselves
 }
 
 //
-// File I/O (.obj and .ppm (P3))
+// File I/O (.obj and .ppm (P6 and P3))
 //
 
 void ClothObject::ClearObject()
@@ -58,13 +74,59 @@ void ClothObject::ClearObject()
     normals_.resize(0);
     texture_coords_.resize(0);
     triangles_.resize(0);
-    mass_particles_.resize(0);
-    springs_.resize(0);
+    mass_particles_.Clear();
+    springs_.Clear();
+    implicit_solver_.Clear();
+    xpbd_solver_.Clear();
+    projective_solver_.Clear();
+    self_collision_.Clear();
+    particle_springs_.resize(0);
     centre_of_gravity_ = glm::vec3(0);
 }
 
 bool ClothObject::ReadObject(std::string &obj_file)
-{   
+{
+    // a cache written after the last change to the file skips the parse, the scaling and the spring building
+    std::string cache_file = ClothCache::CacheFile(obj_file);
+    if (use_cache_ && ClothCache::IsFresh(cache_file, obj_file))
+    {
+        ClearGeometry();
+        if (ClothCache::Read(cache_file, *this))
+        {
+            PlaceParticles();
+            // the cache holds the spring topology, not the solvers' structures built from it
+            BuildSolvers();
+            return true;
+        }
+    }
+
+    bool read = obj_reader_ == kStreamReader ? ParseObjectStream(obj_file) : ParseObjectMapped(obj_file);
+    if (!read)
+        return false;
+    ScaleGeometry();
+    PlaceParticles();
+    BuildSprings();
+    // the next read of the file will not have to do any of it
+    if (use_cache_)
+        ClothCache::Write(cache_file, *this);
+    return true;
+}
+
+void ClothObject::ClearGeometry()
+{
+    // resize our data
+    vertices_.resize(0);
+    normals_.resize(0);
+    texture_coords_.resize(0);
+    triangles_.resize(0);
+    mass_particles_.Clear();
+    springs_.Clear();
+    particle_springs_.resize(0);
+    object_properties_ = 0;
+}
+
+bool ClothObject::ParseObjectStream(std::string &obj_file)
+{
     // create a read buffer
     char read_buffer[MAXIMUM_LINE_LENGTH];
     // utility char* for tokenising
@@ -79,14 +141,7 @@ bool ClothObject::ReadObject(std::string &obj_file)
     if (!file.is_open())
         return false;
 
-    // resize our data
-    vertices_.resize(0);
-    normals_.resize(0);
-    texture_coords_.resize(0);
-    triangles_.resize(0);
-    mass_particles_.resize(0);
-    springs_.resize(0);
-    object_properties_ = 0;
+    ClearGeometry();
 
     // loop one line at a time until EOF
     while (!file.eof())
@@ -136,7 +191,7 @@ bool ClothObject::ReadObject(std::string &obj_file)
                 
                 // find out how many vertices there are in the face
                 int vertices = 0;
-                char buffer[line_string.length()];
+                char buffer[line_string.length() + 1];
 
                 strcpy(buffer, read_buffer);
                 token = strtok(buffer, " ");
@@ -196,7 +251,7 @@ bool ClothObject::ReadObject(std::string &obj_file)
                     remainder = remainder.substr(v1_pos, remainder.length());
 
                     // we now need to process the vertices we have and create a triangle
-                    Triangle* triangle = new Triangle();
+                    Triangle triangle;
 
                     // tokenise each vertex
                     // v1
@@ -220,28 +275,28 @@ bool ClothObject::ReadObject(std::string &obj_file)
                     // copy the values into the triangle one vertex at a time
                     for (int j = 0; j < 3; j++)
                     {
-                        triangle->positions[j] = triangle_data[j * 3] - 1;
+                        triangle.positions[j] = triangle_data[j * 3] - 1;
                         // we are missing either texture or normals when the last entry is 0
                         if (triangle_data[j * 3 + 2] == 0)
                         {
                             if (object_properties_ & kHasTextures)
                             {
-                                triangle->textures[j] = triangle_data[j * 3 + 1] - 1;
-                                triangle->normals[j] = triangle_data[j * 3 + 2];
+                                triangle.textures[j] = triangle_data[j * 3 + 1] - 1;
+                                triangle.normals[j] = triangle_data[j * 3 + 2];
                             }
                             else if (object_properties_ & kHasNormals)
                             {
-                                triangle->textures[j] = triangle_data[j * 3 + 2];
-                                triangle->normals[j] = triangle_data[j * 3 + 1] - 1;
+                                triangle.textures[j] = triangle_data[j * 3 + 2];
+                                triangle.normals[j] = triangle_data[j * 3 + 1] - 1;
                             }
                         }
                         else
                         {
-                            triangle->textures[j] = triangle_data[j * 3 + 1] - 1;
-                            triangle->normals[j] = triangle_data[j * 3 + 2] - 1;
+                            triangle.textures[j] = triangle_data[j * 3 + 1] - 1;
+                            triangle.normals[j] = triangle_data[j * 3 + 2] - 1;
                         }
                     }
-                    triangle->index = current_triangle++;
+                    triangle.index = current_triangle++;
                     // add current triangle to vector of triangles
                     triangles_.push_back(triangle);
                 }
@@ -249,7 +304,32 @@ bool ClothObject::ReadObject(std::string &obj_file)
             }
         }
     }
+    return true;
+}
+
+bool ClothObject::ParseObjectMapped(std::string &obj_file)
+{
+    MappedFile file;
+    // return false if we couldn't map the obj file
+    if (!file.Open(obj_file))
+        return false;
+
+    ClearGeometry();
+    ObjMesh mesh;
+    ObjParser::Parse(file.Data(), file.Size(), mesh, obj_reader_ == kParallelReader ? thread_pool_ : NULL);
+    vertices_.swap(mesh.positions);
+    normals_.swap(mesh.normals);
+    texture_coords_.swap(mesh.texture_coords);
+    triangles_.swap(mesh.triangles);
+    if (!normals_.empty())
+        object_properties_ |= kHasNormals;
+    if (!texture_coords_.empty())
+        object_properties_ |= kHasTextures;
+    return true;
+}
 
+void ClothObject::ScaleGeometry()
+{
     // compute centre of gravity and object size
     centre_of_gravity_ = glm::vec3(0.0, 0.0, 0.0);
     // if there are any vertices at all
@@ -279,98 +359,91 @@ bool ClothObject::ReadObject(std::string &obj_file)
 
     // update centre
     centre_of_gravity_ = (centre_of_gravity_ * target_size_) / object_size_;
+}
 
-
+void ClothObject::PlaceParticles()
+{
     // now create the mass points for each vertex
-    mass_particles_.resize(vertices_.size());
-    for (unsigned int part = 0; part < mass_particles_.size(); part++)
-    {
-        mass_particles_[part] = new PointMass(cloth_mass_, glm::vec3(0), vertices_[part] + glm::vec3(0, y_pos_, 0));
-        mass_particles_[part]->index = part;
-    }
-    
-    // use face triangles to uniquely link point masses together
-    unsigned int spring_index = 0;
-    // loop through triangle edges 
-    for (unsigned int tri = 0; tri < triangles_.size(); tri++)
-        for (unsigned int i = 0; i < 3; i++)
-            // if there are no springs already linking these points up
-            if (CheckPointSprings(mass_particles_[triangles_[tri]->positions[i]], (i + 1) % 3)
-                && CheckPointSprings(mass_particles_[triangles_[tri]->positions[(i + 1) % 3]], i))
-                {
-                    // add the spring to the springs vector
-                    springs_.push_back(new Spring(mass_particles_[triangles_[tri]->positions[i]], 
-                                                  mass_particles_[triangles_[tri]->positions[(i + 1) % 3]], 
-                                                  cloth_k_, cloth_d_));
-                    // also add the spring's index to the ball's vector
-                    mass_particles_[triangles_[tri]->positions[i]]->spring_indices_.push_back(spring_index++);
-                }
-    return true;
+    mass_particles_.Resize(vertices_.size());
+    for (unsigned int part = 0; part < mass_particles_.Size(); part++)
+        mass_particles_.SetPosition(part, vertices_[part] + glm::vec3(0, y_pos_, 0));
+    mass_particles_.SetMass(cloth_mass_);
+}
+
+void ClothObject::BuildSprings()
+{
+    // one spring per unique triangle edge, and across every edge shared by two triangles when asked
+    std::vector<MeshEdge> edges, bends;
+    MeshEdges::Build(triangles_, vertices_.size(), edges, bend_springs_ ? &bends : NULL, thread_pool_);
+    springs_.Clear();
+    for (unsigned int e = 0; e < edges.size(); e++)
+        springs_.Add(edges[e].a, edges[e].b,
+                     glm::distance(mass_particles_.Position(edges[e].a), mass_particles_.Position(edges[e].b)),
+                     cloth_k_, cloth_d_);
+    for (unsigned int b = 0; b < bends.size(); b++)
+        springs_.Add(bends[b].a, bends[b].b,
+                     glm::distance(mass_particles_.Position(bends[b].a), mass_particles_.Position(bends[b].b)),
+                     cloth_k_, cloth_d_);
+
+    BuildSpringTopology();
 }
 
-bool ClothObject::CheckPointSprings(PointMass* point_a, unsigned int index_b)
+bool ClothObject::CheckPointSprings(unsigned int index_a, unsigned int index_b)
 {
     // loop over the point's springs
-    for (unsigned int spring = 0; spring < point_a->spring_indices_.size(); spring++)
-        // if there is a spring from a to b
-        if (springs_[spring]->right_->index == index_b)
+    for (unsigned int s = 0; s < particle_springs_[index_a].size(); s++)
+    {
+        // if there is a spring between a and b, whichever way round
+        unsigned int spring = particle_springs_[index_a][s];
+        if (springs_.left_[spring] == index_b || springs_.right_[spring] == index_b)
             return false;
+    }
     return true;
 }
 
-bool ClothObject::ReadTexture(std::string &ppm_file)
+void ClothObject::AddSpring(unsigned int index_a, unsigned int index_b)
 {
-    // line reading buffer
-    char read_buffer[MAXIMUM_LINE_LENGTH];
-
-    // open a file stream
-    std::ifstream file;
-    file.open(ppm_file, std::ios::in);
+    float rest = glm::distance(mass_particles_.Position(index_a), mass_particles_.Position(index_b));
+    unsigned int spring = springs_.Add(index_a, index_b, rest, cloth_k_, cloth_d_);
+    particle_springs_[index_a].push_back(spring);
+    particle_springs_[index_b].push_back(spring);
+}
 
-    // return false if we couldn't open the obj file
-    if (!file.is_open())
-        return false;
+void ClothObject::BuildSpringTopology()
+{
+    // springs are streamed over every step, keep the ones sharing particles close together
+    springs_.SortForLocality();
+    // then split them in classes that can be evaluated in parallel without conflicting writes
+    springs_.BuildColors(mass_particles_.Size());
+    springs_.BuildIncidence(mass_particles_.Size());
+    BuildSolvers();
+    particle_springs_.resize(0);
+}
 
-    // first line
-    file.getline(read_buffer, MAXIMUM_LINE_LENGTH);
-    // should be P3
-    if (strcmp(read_buffer,"P3") != 0)
-        return false;
-    
-    // skip comments
-    while(file.good() && file.peek() == '#')
-        file.getline(read_buffer, MAXIMUM_LINE_LENGTH);
+void ClothObject::BuildSolvers()
+{
+    // the implicit system has a block for every pair of particles sharing a spring
+    implicit_solver_.Build(springs_, mass_particles_.Size());
+    xpbd_solver_.Build(springs_, mass_particles_.Size());
+    projective_solver_.Build(springs_, mass_particles_.Size());
+    // the vertices are the cloth at rest
+    self_collision_.Build(springs_, triangles_, vertices_, mass_particles_.Size());
+}
 
-    // read ppm characteristics
-    int new_width, new_height, max;
-    file >> new_width >> new_height >> max;
-    if (max != 255)
+bool ClothObject::ReadTexture(std::string &ppm_file)
+{
+    PpmImage image;
+    if (!image.Read(ppm_file))
         return false;
+    SetImage(image);
+    return true;
+}
 
-    // reset texture data
-    delete texture_;
-
-    // set new dimensions
-    height_ = new_height;
-    width_ = new_width;
-
-    // allocate space for texture
-    texture_ = new RGB[height_ * width_];
-
-    int temp;
-    for (int row = 0; row < height_; row++)
-        for (int col = 0; col < width_; col++)
-        {
-            // read rgb values as integers
-            file >> temp;
-            // which are then cast as unsigned char (bytes) when assigned to a RGB struct
-            texture_[row * height_ + col].red = temp;
-            file >> temp;
-            texture_[row * height_ + col].green = temp;
-            file >> temp;
-            texture_[row * height_ + col].blue = temp;
-        }
-    return true;        
+void ClothObject::SetImage(PpmImage &image)
+{
+    width_ = image.width_;
+    height_ = image.height_;
+    texture_.swap(image.pixels_);
 }
 
 void ClothObject::WriteObject(std::string &obj_file)
@@ -390,10 +463,10 @@ void ClothObject::WriteObject(std::string &obj_file)
     file << "# " << obj_file << '\n';
 
     // the positions stored in the mass points (NB we omit normals)
-    for (unsigned int mass = 0; mass < mass_particles_.size(); mass++)
-        file << "v " << mass_particles_[mass]->position_.x 
-             << ' ' << mass_particles_[mass]->position_.y 
-             << ' ' << mass_particles_[mass]->position_.z << '\n';
+    for (unsigned int mass = 0; mass < mass_particles_.Size(); mass++)
+        file << "v " << mass_particles_.pos_x_[mass] 
+             << ' ' << mass_particles_.pos_y_[mass] 
+             << ' ' << mass_particles_.pos_z_[mass] << '\n';
 
     if (object_properties_ & kHasTextures)
         for (unsigned int tex_coord = 0; tex_coord < texture_coords_.size(); tex_coord++)
@@ -407,9 +480,9 @@ void ClothObject::WriteObject(std::string &obj_file)
         file << "f ";
         for (unsigned int v = 0; v < 3; v++)
             {
-                file << triangles_[tri]->positions[v] + 1;
+                file << triangles_[tri].positions[v] + 1;
                 if (object_properties_ & kHasTextures)
-                    file << "//" << (int)triangles_[tri]->textures[v] + 1;
+                    file << "//" << (int)triangles_[tri].textures[v] + 1;
                 file << ' ';
             }
         file << '\n';
@@ -422,6 +495,8 @@ void ClothObject::WriteObject(std::string &obj_file)
 // OpenGL
 //
 
+#ifndef CLOTH_HEADLESS
+
 // sets the OpenGL texture parameters
 void ClothObject::SetTexture()
 {
@@ -431,7 +506,9 @@ void ClothObject::SetTexture()
     glBindTexture(GL_TEXTURE_2D, texture_id_);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, texture_);
+    // rows of RGB pixels are packed, not padded to 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, texture_.data());
     glDisable(GL_TEXTURE_2D);
 }
 
@@ -454,9 +531,10 @@ void ClothObject::Render()
     for (unsigned int t = 0; t < triangles_.size(); t++)
     {
         // compute the normal of the face
+        glm::vec3 p0 = mass_particles_.Position(triangles_[t].positions[0]);
         normal = glm::normalize(glm::cross(
-            mass_particles_[triangles_[t]->positions[1]]->position_ - mass_particles_[triangles_[t]->positions[0]]->position_,
-            mass_particles_[triangles_[t]->positions[2]]->position_ - mass_particles_[triangles_[t]->positions[0]]->position_));
+            mass_particles_.Position(triangles_[t].positions[1]) - p0,
+            mass_particles_.Position(triangles_[t].positions[2]) - p0));
         
         glNormal3f(normal.x, normal.y, normal.z);
 
@@ -464,12 +542,12 @@ void ClothObject::Render()
         {
             // texture uv
             if (object_properties_ & kHasTextures)
-                glTexCoord2f(texture_coords_[triangles_[t]->textures[v]].x, 
-                             texture_coords_[triangles_[t]->textures[v]].y);
+                glTexCoord2f(texture_coords_[triangles_[t].textures[v]].x, 
+                             texture_coords_[triangles_[t].textures[v]].y);
             // position
-            glVertex3f(mass_particles_[triangles_[t]->positions[v]]->position_.x, 
-                       mass_particles_[triangles_[t]->positions[v]]->position_.y, 
-                       mass_particles_[triangles_[t]->positions[v]]->position_.z);
+            glVertex3f(mass_particles_.pos_x_[triangles_[t].positions[v]], 
+                       mass_particles_.pos_y_[triangles_[t].positions[v]], 
+                       mass_particles_.pos_z_[triangles_[t].positions[v]]);
         }
     }
     glEnd();
@@ -478,22 +556,27 @@ void ClothObject::Render()
 
 void ClothObject::ShowPoints()
 {
-    for (unsigned int p = 0; p < mass_particles_.size(); p++)
-            mass_particles_[p]->DrawPoint();
+    for (unsigned int p = 0; p < mass_particles_.Size(); p++)
+            PointMass(&mass_particles_, p).DrawPoint();
 }
+#endif // CLOTH_HEADLESS
 
 // implements flat shading on cloth triangles
 void ClothObject::ComputeNormals()
 {
+    // a mesh read from a file without normals (as WriteObject writes them) has none to update
+    if (normals_.empty())
+        return;
     // loop through the triangles and compute the normals of each face
     for (unsigned int tri = 0; tri < triangles_.size(); tri++)
     {
+        glm::vec3 p0 = mass_particles_.Position(triangles_[tri].positions[0]);
         glm::vec3 normal = glm::normalize(glm::cross(
-            mass_particles_[triangles_[tri]->positions[1]]->position_ - mass_particles_[triangles_[tri]->positions[0]]->position_,
-            mass_particles_[triangles_[tri]->positions[0]]->position_ - mass_particles_[triangles_[tri]->positions[2]]->position_));
+            mass_particles_.Position(triangles_[tri].positions[1]) - p0,
+            p0 - mass_particles_.Position(triangles_[tri].positions[2])));
         // update the normals vector
         for (unsigned int i = 0; i < 3; i++)
-            normals_[triangles_[tri]->normals[i]] = normal;
+            normals_[triangles_[tri].normals[i]] = normal;
     }    
 }
 
@@ -504,12 +587,35 @@ void ClothObject::ComputeNormals()
 void ClothObject::ComputeForces(glm::vec3 gravity, glm::vec3 wind, float air_res)
 {
     // start by adding external forces (also takes care of resetting the force)
-    for (unsigned int p = 0; p < mass_particles_.size(); p++)
-        mass_particles_[p]->net_F_ = gravity + wind - (cloth_air_ * mass_particles_[p]->velocity_);
+    ComputeExternalForces(gravity, wind);
+
+    // update the force of the object's point masses by streaming over the spring table
+    if (force_mode_ == kParticleGather)
+        springs_.ComputeGatheredForces(mass_particles_, thread_pool_);
+    else
+        springs_.ComputeColoredForces(mass_particles_, thread_pool_);
+}
+
+void ClothObject::ComputeExternalForces(glm::vec3 gravity, glm::vec3 wind)
+{
+    glm::vec3 external = gravity + wind;
+    ForEachParticle([this, external] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            mass_particles_.force_x_[p] = external.x - cloth_air_ * mass_particles_.vel_x_[p];
+            mass_particles_.force_y_[p] = external.y - cloth_air_ * mass_particles_.vel_y_[p];
+            mass_particles_.force_z_[p] = external.z - cloth_air_ * mass_particles_.vel_z_[p];
+        }
+    });
+}
 
-    // update the force of the object's point masses by looping over springs and computing spring force
-    for (unsigned int s = 0; s < springs_.size(); s++)
-        springs_[s]->UpdateParticles(cloth_k_, cloth_d_);
+void ClothObject::ForEachParticle(const ThreadPool::RangeTask &task)
+{
+    if (thread_pool_ != NULL)
+        thread_pool_->ParallelFor(0, mass_particles_.Size(), task);
+    else
+        task(0, mass_particles_.Size());
 }
 
 // height and width give the desired cell number
@@ -544,40 +650,34 @@ void ClothObject::GenClothGrid(int height, int width, float size)
         for (int col = 0; col < width; col++)
         {
             // bottom left triangle
-            Triangle *triangle_1 = new Triangle();
-            triangle_1->positions[0] = triangle_1->normals[0] = triangle_1->textures[0] = row * rows + col;
-            triangle_1->positions[1] = triangle_1->normals[1] = triangle_1->textures[1] = row * rows + col + 1;
-            triangle_1->positions[2] = triangle_1->normals[2] = triangle_1->textures[2] = (row + 1) * rows + col;
-            triangle_1->index = current_triangle++;
+            Triangle &triangle_1 = triangles_[current_triangle];
+            triangle_1.positions[0] = triangle_1.normals[0] = triangle_1.textures[0] = row * rows + col;
+            triangle_1.positions[1] = triangle_1.normals[1] = triangle_1.textures[1] = row * rows + col + 1;
+            triangle_1.positions[2] = triangle_1.normals[2] = triangle_1.textures[2] = (row + 1) * rows + col;
+            triangle_1.index = current_triangle++;
             // top right triangle
-            Triangle *triangle_2 = new Triangle();
-            triangle_2->positions[0] = triangle_2->normals[0] = triangle_2->textures[0] = (row + 1) * rows + col;
-            triangle_2->positions[1] = triangle_2->normals[1] = triangle_2->textures[1] = row * rows + col + 1;
-            triangle_2->positions[2] = triangle_2->normals[2] = triangle_2->textures[2] = (row + 1) * rows + col + 1;
-            triangle_2->index = current_triangle++;
-            // put triangles in container
-            unsigned int tri = triangle_1->index;
-            triangles_[triangle_1->index] = triangle_1;
-            triangles_[triangle_2->index] = triangle_2;
+            Triangle &triangle_2 = triangles_[current_triangle];
+            triangle_2.positions[0] = triangle_2.normals[0] = triangle_2.textures[0] = (row + 1) * rows + col;
+            triangle_2.positions[1] = triangle_2.normals[1] = triangle_2.textures[1] = row * rows + col + 1;
+            triangle_2.positions[2] = triangle_2.normals[2] = triangle_2.textures[2] = (row + 1) * rows + col + 1;
+            triangle_2.index = current_triangle++;
         }
     
     // as many mass points as vertices
-    mass_particles_.resize(vertices_.size());
+    mass_particles_.Resize(vertices_.size());
+    particle_springs_.resize(0);
+    particle_springs_.resize(vertices_.size());
     // now create the mass points for each vertex
-    mass_particles_.resize(vertices_.size());
-    for (unsigned int part = 0; part < mass_particles_.size(); part++)
-    {
-        mass_particles_[part] = new PointMass(cloth_mass_, glm::vec3(0), vertices_[part]);
-        mass_particles_[part]->index = part;
-    }
+    for (unsigned int part = 0; part < mass_particles_.Size(); part++)
+        mass_particles_.SetPosition(part, vertices_[part]);
+    mass_particles_.SetMass(cloth_mass_);
 
     //for (int i = 0; i < vertices_.size(); i++)
         //std::cout << vertices_[i].x << " " << vertices_[i].y << " " << vertices_[i].z << std::endl;
     
     // 2 springs per cell and m(n+1) + m(n+1) springs for each unique edges for n x m cells cloth
-    unsigned int spring_index = 0;
     unsigned int left, right = 0;
-    springs_.resize(0);// 2 * height * width + width * (height + 1) + height * (width + 1));
+    springs_.Clear();
     for (unsigned int row = 0; row < height; row++)
         for (unsigned int col = 0; col < width; col++)
         {
@@ -594,45 +694,37 @@ void ClothObject::GenClothGrid(int height, int width, float size)
             // spring a-b
             left = row * rows + col;
             right = row * rows + col + 1;
-            if (CheckPointSprings(mass_particles_[left], right)
-                && CheckPointSprings(mass_particles_[right], left))
-                {
-                    springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-                    mass_particles_[left]->spring_indices_.push_back(spring_index++);
-                }
+            if (CheckPointSprings(left, right)
+                && CheckPointSprings(right, left))
+                    AddSpring(left, right);
 
             // spring a-c
             right = (row + 1) * rows + col;
-            if (CheckPointSprings(mass_particles_[left], right)
-                && CheckPointSprings(mass_particles_[right], left))
-                {
-                    springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-                    mass_particles_[left]->spring_indices_.push_back(spring_index++);
-                }
+            if (CheckPointSprings(left, right)
+                && CheckPointSprings(right, left))
+                    AddSpring(left, right);
 
             // spring a-d
             right = (row + 1) * rows + col + 1;
-            springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-            mass_particles_[left]->spring_indices_.push_back(spring_index++);
+            AddSpring(left, right);
 
             // spring b-d
             left = row * rows + col + 1;
             right = (row + 1) * rows + col + 1;
-            springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-            mass_particles_[left]->spring_indices_.push_back(spring_index++);
+            AddSpring(left, right);
 
             // spring c-b
             left = (row + 1) * rows + col;
             right = row * rows + col + 1;
-            springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-            mass_particles_[left]->spring_indices_.push_back(spring_index++);
+            AddSpring(left, right);
 
             // spring c-d
             left = (row + 1) * rows + col;
             right = (row + 1) * rows + col + 1;
-            springs_.push_back(new Spring(mass_particles_[left], mass_particles_[right], cloth_k_, cloth_d_));
-            mass_particles_[left]->spring_indices_.push_back(spring_index++);
+            AddSpring(left, right);
         }
+
+    BuildSpringTopology();
 }
 
 // 
@@ -5,37 +5,37 @@
 #include <vector>
 #include <iostream>
 
-// openGL
+// openGL, left out of the headless core
+#ifndef CLOTH_HEADLESS
 #include <GL/gl.h>
+#endif
 
 // glm maths
 #include <glm/glm.hpp>
 
 // classes for modelling a cloth 
+#include "ParticleSystem.h"
 #include "PointMass.h"
 #include "Spring.h"
+#include "ThreadPool.h"
+#include "ImplicitSolver.h"
+#include "XpbdSolver.h"
+#include "ProjectiveSolver.h"
+#include "SelfCollision.h"
+// the face struct
+#include "ObjParser.h"
+// the texture pixels
+#include "PpmImage.h"
 
 class ClothObject
 {
     // POD face struct, a triangle
-    struct Triangle
-    {
-        // triangle index
-        unsigned int index;
-        // arrays containing the face vertex indices
-        unsigned int positions[3];
-        unsigned int normals[3];
-        unsigned int textures[3];
-    };
+    typedef ObjTriangle Triangle;
 
     // just three integer values for RGB
-    struct RGB
-    {
-        unsigned char red;
-        unsigned char green;
-        unsigned char blue;
-    };
+    typedef RgbPixel RGB;
 
+    public:
     // bit flags for object file properties
     enum Properties : unsigned int
     {
@@ -43,6 +43,26 @@ class ClothObject
         kHasNormals = 2,
     };
 
+    // how spring forces are accumulated into the particles
+    enum ForceMode : unsigned int
+    {
+        // color classes of springs scatter their forces, classes one after the other
+        kColoredScatter = 0,
+        // springs store their forces then particles gather them
+        kParticleGather = 1
+    };
+
+    // how .obj files are read
+    enum ObjReader : unsigned int
+    {
+        // line by line through a stream, the original reader, kept for comparison
+        kStreamReader = 0,
+        // the whole file mapped and parsed in place
+        kMappedReader = 1,
+        // mapped and parsed in chunks on the thread pool
+        kParallelReader = 2
+    };
+
 
     public:
     // constructor
@@ -54,21 +74,35 @@ class ClothObject
     // read routine returns true on success, failure otherwise
     bool ReadObject(std::string &obj_file);
     bool ReadTexture(std::string &ppm_file);
+    // takes the pixels of an image read elsewhere (on another thread) as the texture, the image is left empty
+    void SetImage(PpmImage &image);
     // write routine
     void WriteObject(std::string &obj_file);
     void ClearObject();
     
+#ifndef CLOTH_HEADLESS
     // methods for openGL
     void SetTexture();
     void Render();
     void ShowPoints();
+#endif
     void ComputeNormals();
 
-    // checks whether a mass a is linked to another mass b
-    bool CheckPointSprings(PointMass* point_a, unsigned int index_b);
+    // checks whether a mass a is not linked to another mass b yet
+    bool CheckPointSprings(unsigned int index_a, unsigned int index_b);
+    // links mass a to mass b with a spring at rest
+    void AddSpring(unsigned int index_a, unsigned int index_b);
+    // orders, colors and indexes the springs once they have all been added
+    void BuildSpringTopology();
+    // sets the solvers up for the current spring topology
+    void BuildSolvers();
     // generate data for a rectangular piece of cloth
     void GenClothGrid(int height, int width, float size);
     void ComputeForces(glm::vec3 gravity, glm::vec3 wind, float air_res);
+    // only the forces that do not come from the springs (gravity, wind and air resistance)
+    void ComputeExternalForces(glm::vec3 gravity, glm::vec3 wind);
+    // runs task over chunks of the particles on the thread pool (or directly without one), returns when all are done
+    void ForEachParticle(const ThreadPool::RangeTask &task);
 
 
     // vertex vectors
@@ -76,19 +110,38 @@ class ClothObject
     std::vector<glm::vec3> normals_;
     std::vector<glm::vec3> texture_coords_;
 
-    // cloth vectors
-    std::vector<PointMass*> mass_particles_;
-    std::vector<Spring*> springs_;
-
-    // face vector 
-    std::vector<Triangle*> triangles_;
-
-    // RGB texture
-    RGB* texture_;
+    // cloth particles and springs (structures of arrays)
+    ParticleSystem mass_particles_;
+    SpringTable springs_;
+    // the ids of the springs each particle is connected to, only used when building springs
+    std::vector<std::vector<unsigned int> > particle_springs_;
+
+    // worker threads for the per spring and per particle loops (not owned, may be NULL)
+    ThreadPool* thread_pool_;
+    ForceMode force_mode_;
+    ObjReader obj_reader_;
+    // reads and writes a .clothbin cache next to every .obj file
+    bool use_cache_;
+    // .obj cloths also get a spring between the vertices facing each other across every edge, to resist bending
+    bool bend_springs_;
+    // backward Euler system over the springs, its pattern follows the spring topology
+    ImplicitSolver implicit_solver_;
+    // position based solver over the same springs
+    XpbdSolver xpbd_solver_;
+    // projective dynamics with the global matrix factored once per topology
+    ProjectiveSolver projective_solver_;
+    // keeps the cloth from going through itself, leaving the particles sharing a spring alone
+    SelfCollision self_collision_;
+
+    // face vector, flat
+    std::vector<Triangle> triangles_;
+
+    // RGB texture, packed rows
+    std::vector<RGB> texture_;
     // texture dimensions
     int width_, height_;
-    // a variable to store the texture's ID on the GPU
-    GLuint texture_id_;
+    // a variable to store the texture's ID on the GPU (a GLuint)
+    unsigned int texture_id_;
 
     // computed object characteristics
     glm::vec3 centre_of_gravity_;
@@ -106,6 +159,19 @@ class ClothObject
 
     // bit mask containing object properties
     unsigned int object_properties_;
+
+    private:
+    // empties the geometry, particles and springs before a read
+    void ClearGeometry();
+    // the two readers fill the geometry, return false when the file could not be opened
+    bool ParseObjectStream(std::string &obj_file);
+    bool ParseObjectMapped(std::string &obj_file);
+    // centres and scales the read geometry
+    void ScaleGeometry();
+    // a particle at every vertex, lifted to y_pos_
+    void PlaceParticles();
+    // a spring along every triangle edge, once, and the bending springs
+    void BuildSprings();
 };
 
 #endif  // CLOTH_OBJECT_H
\ No newline at end of file
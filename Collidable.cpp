@@ -2,8 +2,10 @@
 #include "Collidable.h"
 
 // opengGL functions
+#ifndef CLOTH_HEADLESS
 #include <GL/gl.h>
 #include <GL/glu.h>
+#endif
 
 //
 // Collidable Base Class
@@ -38,42 +40,48 @@ Floor::~Floor()
 }
 
 // checks whether a point mass has collided with the floor
-void Floor::ComputeCollision(PointMass* point, float gravity)
+void Floor::ComputeCollision(PointMass point, float gravity)
 {
+    glm::vec3 position = point.Position();
     // simple case is the floor on the xz plane
-    if (point->position_.y <= position_.y + 0.1)
+    if (position.y <= position_.y + 0.1)
     {
         // place point on the floor
-        point->position_.y = position_.y + 0.1;
+        position.y = position_.y + 0.1;
+        point.SetPosition(position);
         // get the normal force
-        float normal_force = point->mass_ * gravity;
+        float normal_force = point.Mass() * gravity;
         // which give us the maximum static friction
         float max_friction = static_friction_ * normal_force;
+        glm::vec3 net_F = point.Force();
         // force pointing downwards (into the floor) so project on the floor
-        if (point->net_F_.y < 0)
+        if (net_F.y < 0)
         {
-            // unit force direction in xz plane
-            glm::vec3 force_dir = glm::normalize(glm::vec3(point->net_F_.x, 0, point->net_F_.z));
+            // unit force direction in xz plane (none for a force straight down, a particle pushed by the cloth above it)
+            glm::vec3 tangent_F(net_F.x, 0, net_F.z);
+            glm::vec3 force_dir = glm::dot(tangent_F, tangent_F) > 0 ? glm::normalize(tangent_F) : glm::vec3(0);
             // project force onto floor plane along force's xz vector 
-            glm::vec3 projected_force = glm::dot(point->net_F_, force_dir) * force_dir;
+            glm::vec3 projected_force = glm::dot(net_F, force_dir) * force_dir;
             float delta = max_friction - projected_force.length();
             // if force is greater than max friction
             if (delta < 0)
             {
                 float friction = kinetic_friction_ * normal_force;
                 // friction is in the opposite direction of the force
-                point->net_F_ = projected_force - friction * force_dir;
+                point.SetForce(projected_force - friction * force_dir);
             }
             else 
             {
                 // force is smaller than friction so friction (oppose projected force) wins
-                point->velocity_ = glm::vec3(0);
-                point->net_F_ = glm::vec3(0);
+                point.SetVelocity(glm::vec3(0));
+                point.SetForce(glm::vec3(0));
+                point.SetContact();
             }
         }
     }
 }
 
+#ifndef CLOTH_HEADLESS
 void Floor::DrawCollidable()
 {
     // draw two triangles
@@ -89,6 +97,7 @@ void Floor::DrawCollidable()
     glVertex3f(-size_, 0, size_);
     glEnd();
 }
+#endif // CLOTH_HEADLESS
 
 //
 // Sphere Class
@@ -106,17 +115,19 @@ Sphere::~Sphere()
 }
 
 // checks whether a point mass has collided with sphere
-void Sphere::ComputeCollision(PointMass* point, float gravity)
+void Sphere::ComputeCollision(PointMass point, float gravity)
 {
+    glm::vec3 position = point.Position();
     // check if the distance from the point to the centre of the sphere is smaller than radius
-    if (glm::distance(point->position_, position_) < size_)
+    if (glm::distance(position, position_) < size_)
     {
         // place point on the sphere surface
-        glm::vec3 to_surface = glm::normalize(point->position_ - position_); 
-        point->position_ = position_ + to_surface * size_;
+        glm::vec3 to_surface = glm::normalize(position - position_); 
+        point.SetPosition(position_ + to_surface * size_);
         // for now, settle with having positions fixed on contact
-        point->net_F_ = glm::vec3(0);
-        point->velocity_= glm::vec3(0);
+        point.SetForce(glm::vec3(0));
+        point.SetVelocity(glm::vec3(0));
+        point.SetContact();
         // get the unit tangent to the sphere from cross product of normal with a xz vector
         //glm::vec3 tangent = glm::cross(to_surface, glm::vec3(0.5, 0, 0.5));
         // make sure tangent vector is pointing down
@@ -128,6 +139,7 @@ void Sphere::ComputeCollision(PointMass* point, float gravity)
 
 }
 
+#ifndef CLOTH_HEADLESS
 void Sphere::DrawCollidable()
 {
     // set up the quadric object for the sphere
@@ -143,6 +155,7 @@ void Sphere::DrawCollidable()
     gluSphere(quad_obj, size_, 10, 10);
     glPopMatrix();
 }
+#endif // CLOTH_HEADLESS
 
 
 
@@ -10,11 +10,13 @@ class Collidable
     // constructor
     Collidable(float friction_s, float friction_k, float size, glm::vec3 position);
     // destructor
-    ~Collidable();
+    virtual ~Collidable();
 
     // pure virtual functions
-    virtual void ComputeCollision(PointMass *point, float gravity) =0;
+    virtual void ComputeCollision(PointMass point, float gravity) =0;
+#ifndef CLOTH_HEADLESS
     virtual void DrawCollidable() =0;
+#endif
 
     // collidable in worls space
     glm::vec3 position_;
@@ -37,8 +39,10 @@ class Floor : public Collidable
     ~Floor();
 
     // overload methods for collision and render
-    void ComputeCollision(PointMass *point, float gravity);
+    void ComputeCollision(PointMass point, float gravity);
+#ifndef CLOTH_HEADLESS
     void DrawCollidable();
+#endif
 };
 
 // class for computing floor collision
@@ -52,8 +56,10 @@ class Sphere : public Collidable
     ~Sphere();
 
     // overload methods for collision and render
-    void ComputeCollision(PointMass *point, float gravity);
+    void ComputeCollision(PointMass point, float gravity);
+#ifndef CLOTH_HEADLESS
     void DrawCollidable();
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -20,5 +20,6 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 # Input
-HEADERS += Ball.h BallAux.h BallMath.h Collidable.h PointMass.h ClothObject.h Spring.h SimulationWidget.h Window.h
-SOURCES += Ball.cpp BallAux.cpp BallMath.cpp Collidable.cpp PointMass.cpp ClothObject.cpp Spring.cpp SimulationWidget.cpp Window.cpp main.cpp
+include(ClothCore.pri)
+HEADERS += Ball.h BallAux.h BallMath.h SimulationWidget.h Window.h
+SOURCES += Ball.cpp BallAux.cpp BallMath.cpp SimulationWidget.cpp Window.cpp main.cpp
@@ -0,0 +1,264 @@
+// class declaration
+#include "FrameRecorder.h"
+
+// the recorded object
+#include "ClothObject.h"
+
+// std::to_chars
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+// longest text of a vertex line: "v ", three floats of at most 15 characters (shortest round trip) and separators
+#define MAX_VERTEX_LINE 64
+
+// appends the shortest text that reads back as value
+static inline char* AppendFloat(char* out, float value)
+{
+    return std::to_chars(out, out + 16, value).ptr;
+}
+
+static inline char* AppendUnsigned(char* out, unsigned int value)
+{
+    return std::to_chars(out, out + 10, value).ptr;
+}
+
+// constructor
+FrameRecorder::FrameRecorder()
+{
+    recording_ = false;
+    every_ = 1;
+    frame_ = 0;
+    particle_count_ = 0;
+    first_ = count_ = 0;
+    stopping_ = false;
+    written_ = dropped_ = 0;
+}
+
+// destructor
+FrameRecorder::~FrameRecorder()
+{
+    Stop();
+}
+
+std::string FrameRecorder::FrameFile(const std::string &output, unsigned int frame)
+{
+    char number[16];
+    snprintf(number, sizeof(number), "_%04u", frame);
+    size_t dot = output.rfind('.');
+    size_t slash = output.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return output + number;
+    return output.substr(0, dot) + number + output.substr(dot);
+}
+
+bool FrameRecorder::IsPointCache(const std::string &output)
+{
+    return output.size() > 8 && output.compare(output.size() - 8, 8, ".clothpc") == 0;
+}
+
+bool FrameRecorder::Start(const std::string &output, const ClothObject &object, unsigned int every)
+{
+    if (recording_)
+        return false;
+    output_ = output;
+    every_ = every > 0 ? every : 1;
+    frame_ = 0;
+    first_ = count_ = 0;
+    stopping_ = false;
+    written_ = dropped_ = 0;
+    particle_count_ = object.mass_particles_.Size();
+
+    topology_.clear();
+    if (IsPointCache(output))
+    {
+        // the topology goes to the cache now, the frames on the writer thread
+        if (!cache_.Open(output, object))
+            return false;
+        recording_ = true;
+        writer_ = std::thread(&FrameRecorder::WriterLoop, this);
+        return true;
+    }
+
+    // what WriteObject writes after the positions, formatted once
+    bool textures = (object.object_properties_ & ClothObject::kHasTextures) && !object.texture_coords_.empty();
+    std::vector<char> line(3 * 16 + 3 * 24 + 8);
+    if (textures)
+        for (unsigned int tex_coord = 0; tex_coord < object.texture_coords_.size(); tex_coord++)
+        {
+            char* out = line.data();
+            memcpy(out, "vt ", 3);
+            out = AppendFloat(out + 3, object.texture_coords_[tex_coord].x);
+            *out++ = ' ';
+            out = AppendFloat(out, object.texture_coords_[tex_coord].y);
+            *out++ = ' ';
+            out = AppendFloat(out, object.texture_coords_[tex_coord].z);
+            *out++ = '\n';
+            topology_.append(line.data(), out);
+        }
+    for (unsigned int tri = 0; tri < object.triangles_.size(); tri++)
+    {
+        char* out = line.data();
+        *out++ = 'f';
+        for (unsigned int v = 0; v < 3; v++)
+        {
+            *out++ = ' ';
+            out = AppendUnsigned(out, object.triangles_[tri].positions[v] + 1);
+            if (textures)
+            {
+                memcpy(out, "//", 2);
+                out = AppendUnsigned(out + 2, object.triangles_[tri].textures[v] + 1);
+            }
+        }
+        *out++ = '\n';
+        topology_.append(line.data(), out);
+    }
+
+    recording_ = true;
+    writer_ = std::thread(&FrameRecorder::WriterLoop, this);
+    return true;
+}
+
+bool FrameRecorder::Capture(const ClothObject &object, bool wait)
+{
+    if (!recording_)
+        return false;
+    // the faces were formatted for another cloth
+    if (object.mass_particles_.Size() != particle_count_)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dropped_++;
+        return false;
+    }
+    frame_++;
+    if (frame_ % every_ != 0)
+        return true;
+
+    // the slot after the waiting snapshots is free while count_ is below the ring size, only the writer lowers it
+    unsigned int slot;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (count_ == RECORD_RING_SIZE && !wait)
+        {
+            dropped_++;
+            return false;
+        }
+        emptied_.wait(lock, [this] () { return count_ < RECORD_RING_SIZE; });
+        slot = (first_ + count_) % RECORD_RING_SIZE;
+    }
+
+    // three flat copies, the layout is the writer's business
+    const ParticleSystem &particles = object.mass_particles_;
+    Snapshot &snapshot = ring_[slot];
+    snapshot.frame = frame_;
+    snapshot.positions.resize(3 * particles.Size());
+    float* positions = snapshot.positions.data();
+    for (unsigned int p = 0; p < particles.Size(); p++)
+    {
+        positions[3 * p] = particles.pos_x_[p];
+        positions[3 * p + 1] = particles.pos_y_[p];
+        positions[3 * p + 2] = particles.pos_z_[p];
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count_++;
+    }
+    filled_.notify_one();
+    return true;
+}
+
+void FrameRecorder::Stop()
+{
+    if (!recording_)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    filled_.notify_one();
+    writer_.join();
+    cache_.Close();
+    recording_ = false;
+}
+
+bool FrameRecorder::Recording() const
+{
+    return recording_;
+}
+
+unsigned int FrameRecorder::Written()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+unsigned int FrameRecorder::Dropped()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void FrameRecorder::WriterLoop()
+{
+    while (true)
+    {
+        unsigned int slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            filled_.wait(lock, [this] () { return count_ > 0 || stopping_; });
+            // the ring is drained before stopping
+            if (count_ == 0)
+                return;
+            slot = first_;
+        }
+
+        bool written = WriteSnapshot(ring_[slot]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            first_ = (first_ + 1) % RECORD_RING_SIZE;
+            count_--;
+            if (written)
+                written_++;
+        }
+        emptied_.notify_one();
+    }
+}
+
+bool FrameRecorder::WriteSnapshot(const Snapshot &snapshot)
+{
+    if (cache_.IsOpen())
+        return cache_.Append(snapshot.positions.data(), snapshot.frame);
+
+    std::string file_name = FrameFile(output_, snapshot.frame);
+    unsigned int n_particles = snapshot.positions.size() / 3;
+    text_.resize(file_name.size() + 3 + (size_t)n_particles * MAX_VERTEX_LINE);
+
+    // start with file name as a comment, then the positions
+    char* out = text_.data();
+    *out++ = '#';
+    *out++ = ' ';
+    memcpy(out, file_name.data(), file_name.size());
+    out += file_name.size();
+    *out++ = '\n';
+    const float* positions = snapshot.positions.data();
+    for (unsigned int p = 0; p < n_particles; p++)
+    {
+        *out++ = 'v';
+        *out++ = ' ';
+        out = AppendFloat(out, positions[3 * p]);
+        *out++ = ' ';
+        out = AppendFloat(out, positions[3 * p + 1]);
+        *out++ = ' ';
+        out = AppendFloat(out, positions[3 * p + 2]);
+        *out++ = '\n';
+    }
+
+    FILE* file = fopen(file_name.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(text_.data(), 1, out - text_.data(), file) == (size_t)(out - text_.data())
+                   && fwrite(topology_.data(), 1, topology_.size(), file) == topology_.size();
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,97 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+// the writer thread and its hand over
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the other output format
+#include "PointCache.h"
+
+// snapshots waiting for the writer, the simulation runs this many frames ahead of the disk at most
+#define RECORD_RING_SIZE 8
+
+class ClothObject;
+
+// records a cloth as a numbered sequence of .obj files (out.obj becomes out_0001.obj, out_0002.obj, ... numbered by
+// frame, frames every, 2 * every, ... are kept), or as one point cache when the output is a .clothpc file, without the
+// simulation ever waiting on the disk: Capture copies the particle positions into a slot of a ring of snapshots and a
+// writer thread formats (std::to_chars) or codes and writes them. The faces and texture coordinates do not change while
+// recording, they are formatted (or stored in the cache) once at Start. The .obj files read back like the ones
+// ClothObject::WriteObject writes.
+class FrameRecorder
+{
+    public:
+    // constructor
+    FrameRecorder();
+    // destructor stops recording, the snapshots already taken are written
+    ~FrameRecorder();
+
+    // starts a recording of object into files named after output, keeping one frame out of every, returns false
+    // when a recording is already running
+    bool Start(const std::string &output, const ClothObject &object, unsigned int every);
+    // counts a frame and takes a snapshot of it when it is one to keep. With the ring full the frame is dropped,
+    // unless wait is set, then it waits for the writer. A cloth other than the one recording started with (another
+    // particle count) is dropped too. Returns false when the frame was dropped
+    bool Capture(const ClothObject &object, bool wait);
+    // writes the snapshots still in the ring and ends the recording
+    void Stop();
+
+    bool Recording() const;
+    // files written and frames dropped by the current or last recording
+    unsigned int Written();
+    unsigned int Dropped();
+
+    // the name of frame number frame of output, out.obj becomes out_0042.obj
+    static std::string FrameFile(const std::string &output, unsigned int frame);
+    // true for the names recorded as a point cache
+    static bool IsPointCache(const std::string &output);
+
+    private:
+    // positions of the particles at one frame, interleaved xyz
+    struct Snapshot
+    {
+        unsigned int frame;
+        std::vector<float> positions;
+    };
+
+    // writer thread body
+    void WriterLoop();
+    // formats a snapshot and writes it to its file
+    bool WriteSnapshot(const Snapshot &snapshot);
+
+    // not copyable, the thread belongs to one object
+    FrameRecorder(const FrameRecorder &);
+    FrameRecorder &operator = (const FrameRecorder &);
+
+    std::thread writer_;
+    bool recording_;
+    std::string output_;
+    unsigned int every_;
+    unsigned int frame_;
+    unsigned int particle_count_;
+
+    // the ring: count_ snapshots from first_ are waiting for the writer, the slot after them is Capture's
+    Snapshot ring_[RECORD_RING_SIZE];
+    unsigned int first_;
+    unsigned int count_;
+    bool stopping_;
+    std::mutex mutex_;
+    std::condition_variable filled_;
+    std::condition_variable emptied_;
+
+    // the faces (and texture coordinates) of every file
+    std::string topology_;
+    // reused by the writer for every file
+    std::vector<char> text_;
+    // the frames of a .clothpc recording, opened by Start, appended to by the writer
+    PointCacheWriter cache_;
+
+    unsigned int written_;
+    unsigned int dropped_;
+};
+
+#endif // FRAME_RECORDER_H
@@ -0,0 +1,228 @@
+// class declaration
+#include "ImplicitSolver.h"
+
+// the pool the loops run on
+#include "ThreadPool.h"
+
+// std::min, std::max
+#include <algorithm>
+#include <cmath>
+
+// number of rows handed to a thread at a time, also the size of the chunks the dot products are summed over
+#define SOLVER_GRAIN 512
+
+// particles whose velocity is not solved for
+#define HELD (ParticleSystem::kPinned | ParticleSystem::kContact)
+
+static const float IDENTITY[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+// constructor
+ImplicitSolver::ImplicitSolver()
+{
+    max_iterations_ = SOLVER_MAX_ITERATIONS;
+    tolerance_ = SOLVER_TOLERANCE;
+    iterations_ = 0;
+    rows_ = 0;
+}
+
+// destructor
+ImplicitSolver::~ImplicitSolver()
+{
+    // arrays release themselves
+}
+
+void ImplicitSolver::Clear()
+{
+    rows_ = 0;
+    matrix_.Clear();
+}
+
+void ImplicitSolver::Build(const SpringTable &springs, unsigned int particle_count)
+{
+    rows_ = particle_count;
+    matrix_.Build(springs, rows_);
+
+    preconditioner_.assign(BLOCK_SIZE * rows_, 0.0f);
+    rhs_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    delta_v_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    residual_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    search_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    product_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    preconditioned_.assign(BLOCK_STRIDE * rows_, 0.0f);
+    partial_.assign((rows_ + SOLVER_GRAIN - 1) / SOLVER_GRAIN, 0.0);
+    partial_norm_.assign(partial_.size(), 0.0);
+}
+
+void ImplicitSolver::Solve(const ParticleSystem &particles, const SpringTable &springs, float h, float air, ThreadPool* pool)
+{
+    iterations_ = 0;
+    if (rows_ == 0)
+        return;
+    Assemble(particles, springs, h, air, pool);
+    ConjugateGradient(pool);
+}
+
+// every row is filled by the thread owning its particle, a spring is visited once from each end
+void ImplicitSolver::Assemble(const ParticleSystem &particles, const SpringTable &springs, float h, float air, ThreadPool* pool)
+{
+    const float* pos_x = particles.pos_x_.data();
+    const float* pos_y = particles.pos_y_.data();
+    const float* pos_z = particles.pos_z_.data();
+    const float* vel_x = particles.vel_x_.data();
+    const float* vel_y = particles.vel_y_.data();
+    const float* vel_z = particles.vel_z_.data();
+
+    ThreadPool::RunRange(pool, 0, rows_, SOLVER_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            matrix_.ZeroRow(p);
+            float* rhs = &rhs_[BLOCK_STRIDE * p];
+
+            // a pinned particle, or one held by a collidable, keeps its velocity: identity row, no right hand side
+            if (particles.flags_[p] & HELD)
+            {
+                matrix_.AddToBlock(matrix_.Diagonal(p), IDENTITY, 1.0f);
+                rhs[0] = rhs[1] = rhs[2] = 0.0f;
+                continue;
+            }
+
+            // mass and the drag of the air
+            matrix_.AddToBlock(matrix_.Diagonal(p), IDENTITY, 1.0f / particles.inv_mass_[p] + h * air);
+            rhs[0] = h * particles.force_x_[p];
+            rhs[1] = h * particles.force_y_[p];
+            rhs[2] = h * particles.force_z_[p];
+
+            for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+            {
+                unsigned int s = springs.incidence_[i] >> 1;
+                unsigned int other = (springs.incidence_[i] & 1) ? springs.right_[s] : springs.left_[s];
+
+                // unit vector from p to the other end
+                float ux = pos_x[other] - pos_x[p];
+                float uy = pos_y[other] - pos_y[p];
+                float uz = pos_z[other] - pos_z[p];
+                float length = std::sqrt(ux * ux + uy * uy + uz * uz);
+                ux /= length;
+                uy /= length;
+                uz /= length;
+
+                // df/dx = k (u u^T + stretch (I - u u^T)), the transverse term is dropped under compression
+                // where it would make the system indefinite, df/dv = d u u^T
+                float stretch = std::max(0.0f, 1.0f - springs.rest_[s] / length);
+                float k = springs.k_[s];
+                // h df/dv + h^2 df/dx = along u u^T + across I
+                float along = h * springs.d_[s] + h * h * k * (1.0f - stretch);
+                float across = h * h * k * stretch;
+                float block[9] = { along * ux * ux + across, along * ux * uy, along * ux * uz,
+                                   along * uy * ux, along * uy * uy + across, along * uy * uz,
+                                   along * uz * ux, along * uz * uy, along * uz * uz + across };
+                matrix_.AddToBlock(matrix_.Diagonal(p), block, 1.0f);
+                // the column of a held particle is filtered out too, its velocity change is known to be zero
+                if (!(particles.flags_[other] & HELD))
+                    matrix_.AddToBlock(matrix_.SpringBlock(i), block, -1.0f);
+
+                // h^2 df/dx v, from the velocity of the other end relative to p
+                float wx = vel_x[other] - vel_x[p];
+                float wy = vel_y[other] - vel_y[p];
+                float wz = vel_z[other] - vel_z[p];
+                float projected = (1.0f - stretch) * (ux * wx + uy * wy + uz * wz);
+                float scale = h * h * k;
+                rhs[0] += scale * (projected * ux + stretch * wx);
+                rhs[1] += scale * (projected * uy + stretch * wy);
+                rhs[2] += scale * (projected * uz + stretch * wz);
+            }
+
+        }
+    });
+}
+
+void ImplicitSolver::ConjugateGradient(ThreadPool* pool)
+{
+    // block Jacobi preconditioner
+    matrix_.ExtractInverseDiagonal(preconditioner_, pool);
+
+    // start from dv = 0, so r = b, z = P^-1 r, d = z
+    double rz = 0.0, bb = 0.0;
+    ThreadPool::RunRange(pool, 0, rows_, SOLVER_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        double sum = 0.0, norm = 0.0;
+        for (unsigned int p = first; p < last; p++)
+        {
+            const float* r = &rhs_[BLOCK_STRIDE * p];
+            float* z = &preconditioned_[BLOCK_STRIDE * p];
+            MultiplyBlock(&preconditioner_[BLOCK_SIZE * p], r, z);
+            for (unsigned int c = 0; c < BLOCK_STRIDE; c++)
+            {
+                delta_v_[BLOCK_STRIDE * p + c] = 0.0f;
+                residual_[BLOCK_STRIDE * p + c] = r[c];
+                search_[BLOCK_STRIDE * p + c] = z[c];
+                sum += r[c] * z[c];
+                norm += r[c] * r[c];
+            }
+        }
+        partial_[first / SOLVER_GRAIN] = sum;
+        partial_norm_[first / SOLVER_GRAIN] = norm;
+    });
+    for (unsigned int c = 0; c < partial_.size(); c++)
+    {
+        rz += partial_[c];
+        bb += partial_norm_[c];
+    }
+
+    double threshold = (double)tolerance_ * tolerance_ * bb;
+    if (bb == 0.0)
+        return;
+
+    while (iterations_ < max_iterations_)
+    {
+        // step length along the search direction
+        double dq = matrix_.MultiplyDot(search_, product_, pool);
+        if (dq <= 0.0)
+            break;
+        float alpha = rz / dq;
+
+        // move the solution and the residual, then precondition the new residual
+        ThreadPool::RunRange(pool, 0, rows_, SOLVER_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            double sum = 0.0, norm = 0.0;
+            for (unsigned int p = first; p < last; p++)
+            {
+                float* r = &residual_[BLOCK_STRIDE * p];
+                float* z = &preconditioned_[BLOCK_STRIDE * p];
+                for (unsigned int c = 0; c < BLOCK_STRIDE; c++)
+                {
+                    delta_v_[BLOCK_STRIDE * p + c] += alpha * search_[BLOCK_STRIDE * p + c];
+                    r[c] -= alpha * product_[BLOCK_STRIDE * p + c];
+                }
+                MultiplyBlock(&preconditioner_[BLOCK_SIZE * p], r, z);
+                for (unsigned int c = 0; c < BLOCK_STRIDE; c++)
+                {
+                    sum += r[c] * z[c];
+                    norm += r[c] * r[c];
+                }
+            }
+            partial_[first / SOLVER_GRAIN] = sum;
+            partial_norm_[first / SOLVER_GRAIN] = norm;
+        });
+        iterations_++;
+
+        double rz_next = 0.0, rr = 0.0;
+        for (unsigned int c = 0; c < partial_.size(); c++)
+        {
+            rz_next += partial_[c];
+            rr += partial_norm_[c];
+        }
+        if (rr <= threshold)
+            break;
+
+        // next direction, conjugate to the previous ones
+        float beta = rz_next / rz;
+        rz = rz_next;
+        ThreadPool::RunRange(pool, 0, rows_, SOLVER_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int i = BLOCK_STRIDE * first; i < BLOCK_STRIDE * last; i++)
+                search_[i] = preconditioned_[i] + beta * search_[i];
+        });
+    }
+}
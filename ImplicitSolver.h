@@ -0,0 +1,83 @@
+#ifndef IMPLICIT_SOLVER_H
+#define IMPLICIT_SOLVER_H
+
+// the particles and springs of the cloth
+#include "ParticleSystem.h"
+#include "Spring.h"
+// the system matrix
+#include "BlockSparseMatrix.h"
+
+#include <vector>
+
+// default solver settings
+#define SOLVER_MAX_ITERATIONS 100
+#define SOLVER_TOLERANCE 1e-3f
+
+// pool the assembly and the solver loops are spread over
+class ThreadPool;
+
+// backward Euler step for a mass spring system (Baraff & Witkin, Large Steps in Cloth Simulation).
+// The velocity change dv solves
+//      (M - h df/dv - h^2 df/dx) dv = h (f + h df/dx v)
+// where the Jacobians of the spring forces are 3x3 blocks following the spring graph. The system is a
+// BlockSparseMatrix whose pattern is built once from the topology, only the values are refilled every step,
+// and it is solved with conjugate gradient preconditioned by the inverse diagonal blocks.
+// Pinned particles and particles in contact with a collidable are filtered out of the system (their rows and columns
+// are the identity) so the solve leaves their velocity to the pins and the collision response.
+class ImplicitSolver
+{
+    public:
+    // constructor
+    ImplicitSolver();
+    // destructor
+    ~ImplicitSolver();
+
+    // builds the block pattern from the spring incidence lists, needed again whenever the springs change
+    void Build(const SpringTable &springs, unsigned int particle_count);
+    void Clear();
+
+    // computes the velocity change of a step of h seconds from the forces currently in the particles,
+    // air is the linear drag coefficient included in those forces
+    void Solve(const ParticleSystem &particles, const SpringTable &springs, float h, float air, ThreadPool* pool);
+
+    // velocity change of a particle after Solve
+    glm::vec3 VelocityChange(unsigned int particle) const;
+
+    // convergence control: the solve stops once |r| < tolerance |b| or after max iterations
+    unsigned int max_iterations_;
+    float tolerance_;
+    // iterations taken by the last solve
+    unsigned int iterations_;
+
+    private:
+    // fills the blocks and the right hand side from the current state
+    void Assemble(const ParticleSystem &particles, const SpringTable &springs, float h, float air, ThreadPool* pool);
+    // preconditioned conjugate gradient on the assembled system
+    void ConjugateGradient(ThreadPool* pool);
+
+    // number of particles
+    unsigned int rows_;
+
+    // system matrix and its inverse diagonal blocks
+    BlockSparseMatrix matrix_;
+    AlignedVector<float> preconditioner_;
+
+    // vectors of the solver, BLOCK_STRIDE floats per particle
+    AlignedVector<float> rhs_;
+    AlignedVector<float> delta_v_;
+    AlignedVector<float> residual_;
+    AlignedVector<float> search_;
+    AlignedVector<float> product_;
+    AlignedVector<float> preconditioned_;
+    // per chunk partial sums of the dot products
+    std::vector<double> partial_;
+    std::vector<double> partial_norm_;
+};
+
+inline glm::vec3 ImplicitSolver::VelocityChange(unsigned int particle) const
+{
+    const float* delta_v = &delta_v_[BLOCK_STRIDE * particle];
+    return glm::vec3(delta_v[0], delta_v[1], delta_v[2]);
+}
+
+#endif // IMPLICIT_SOLVER_H
@@ -0,0 +1,61 @@
+// class declaration
+#include "MappedFile.h"
+
+// mmap and the file descriptor calls
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// constructor
+MappedFile::MappedFile()
+{
+    data_ = NULL;
+    size_ = 0;
+}
+
+// destructor
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string &file)
+{
+    Close();
+    int descriptor = open(file.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        return false;
+    }
+    size_ = status.st_size;
+    if (size_ > 0)
+    {
+        data_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data_ == MAP_FAILED)
+        {
+            data_ = NULL;
+            size_ = 0;
+            close(descriptor);
+            return false;
+        }
+        // every caller reads the whole file, start reading it in now
+        madvise(data_, size_, MADV_WILLNEED);
+    }
+    // the mapping stays valid once the descriptor is closed
+    close(descriptor);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data_ != NULL)
+        munmap(data_, size_);
+    data_ = NULL;
+    size_ = 0;
+}
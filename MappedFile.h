@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// a whole file mapped read only into memory, the pages are read in by the kernel as they are touched
+class MappedFile
+{
+    public:
+    // constructor
+    MappedFile();
+    // destructor unmaps the file
+    ~MappedFile();
+
+    // maps the file, returns false when it cannot be opened or mapped (an empty file maps to no data)
+    bool Open(const std::string &file);
+    void Close();
+
+    const char* Data() const;
+    size_t Size() const;
+
+    private:
+    // not copyable, the mapping belongs to one object
+    MappedFile(const MappedFile &);
+    MappedFile &operator = (const MappedFile &);
+
+    void* data_;
+    size_t size_;
+};
+
+inline const char* MappedFile::Data() const
+{
+    return (const char*)data_;
+}
+
+inline size_t MappedFile::Size() const
+{
+    return size_;
+}
+
+#endif // MAPPED_FILE_H
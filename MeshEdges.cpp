@@ -0,0 +1,181 @@
+// class declaration
+#include "MeshEdges.h"
+
+// the buckets are processed on the worker threads
+#include "ThreadPool.h"
+
+// std::sort, std::swap, std::lower_bound
+#include <algorithm>
+
+// vertices handed to a thread at a time, buckets hold a handful of half edges each
+#define EDGE_GRAIN 4096
+
+// a half edge in the bucket of its lowest vertex: its highest vertex and the vertex facing it in its triangle
+struct HalfEdge
+{
+    unsigned int other;
+    unsigned int opposite;
+
+    bool operator < (const HalfEdge &edge) const
+    {
+        return other < edge.other || (other == edge.other && opposite < edge.opposite);
+    }
+};
+
+// counting sort of pairs (a, b, opposite) by a, offsets[v] .. offsets[v + 1] is then the bucket of vertex v
+static void BucketPairs(const std::vector<MeshEdge> &pairs, const std::vector<unsigned int> &opposites,
+                        unsigned int vertex_count, std::vector<unsigned int> &offsets, std::vector<HalfEdge> &buckets)
+{
+    offsets.assign(vertex_count + 1, 0);
+    for (size_t p = 0; p < pairs.size(); p++)
+        offsets[pairs[p].a + 1]++;
+    for (unsigned int v = 0; v < vertex_count; v++)
+        offsets[v + 1] += offsets[v];
+    buckets.resize(pairs.size());
+    std::vector<unsigned int> slot(offsets.begin(), offsets.end() - 1);
+    for (size_t p = 0; p < pairs.size(); p++)
+    {
+        HalfEdge &edge = buckets[slot[pairs[p].a]++];
+        edge.other = pairs[p].b;
+        edge.opposite = opposites.empty() ? 0 : opposites[p];
+    }
+}
+
+// the unique pairs of every sorted bucket, counted in the first pass and written from first[v] in the second
+static unsigned int UniqueInBucket(const HalfEdge* begin, const HalfEdge* end, unsigned int vertex, MeshEdge* out)
+{
+    unsigned int count = 0;
+    for (const HalfEdge* edge = begin; edge < end; edge++)
+        if (edge == begin || edge->other != (edge - 1)->other)
+        {
+            if (out)
+            {
+                out[count].a = vertex;
+                out[count].b = edge->other;
+            }
+            count++;
+        }
+    return count;
+}
+
+// the pairs of vertices facing each other across the shared edges of a sorted bucket
+static unsigned int BendsInBucket(const HalfEdge* begin, const HalfEdge* end, MeshEdge* out)
+{
+    unsigned int count = 0;
+    for (const HalfEdge* run = begin; run < end; )
+    {
+        const HalfEdge* run_end = run + 1;
+        while (run_end < end && run_end->other == run->other)
+            run_end++;
+        for (const HalfEdge* first = run; first < run_end; first++)
+            for (const HalfEdge* second = first + 1; second < run_end; second++)
+                if (first->opposite != second->opposite)
+                {
+                    if (out)
+                    {
+                        out[count].a = std::min(first->opposite, second->opposite);
+                        out[count].b = std::max(first->opposite, second->opposite);
+                    }
+                    count++;
+                }
+        run = run_end;
+    }
+    return count;
+}
+
+// sorts every bucket, then writes its unique pairs (and bends) one after the other in vertex order
+static void CollectBuckets(std::vector<HalfEdge> &buckets, const std::vector<unsigned int> &offsets,
+                           unsigned int vertex_count, std::vector<MeshEdge> &edges, std::vector<MeshEdge>* bends,
+                           ThreadPool* thread_pool)
+{
+    std::vector<unsigned int> edge_first(vertex_count + 1, 0);
+    std::vector<unsigned int> bend_first(bends ? vertex_count + 1 : 0, 0);
+    ThreadPool::RunRange(thread_pool, 0, vertex_count, EDGE_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int v = first; v < last; v++)
+        {
+            HalfEdge* begin = buckets.data() + offsets[v];
+            HalfEdge* end = buckets.data() + offsets[v + 1];
+            std::sort(begin, end);
+            edge_first[v + 1] = UniqueInBucket(begin, end, v, NULL);
+            if (bends)
+                bend_first[v + 1] = BendsInBucket(begin, end, NULL);
+        }
+    });
+
+    for (unsigned int v = 0; v < vertex_count; v++)
+        edge_first[v + 1] += edge_first[v];
+    edges.resize(edge_first[vertex_count]);
+    if (bends)
+    {
+        for (unsigned int v = 0; v < vertex_count; v++)
+            bend_first[v + 1] += bend_first[v];
+        bends->resize(bend_first[vertex_count]);
+    }
+
+    ThreadPool::RunRange(thread_pool, 0, vertex_count, EDGE_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int v = first; v < last; v++)
+        {
+            const HalfEdge* begin = buckets.data() + offsets[v];
+            const HalfEdge* end = buckets.data() + offsets[v + 1];
+            UniqueInBucket(begin, end, v, edges.data() + edge_first[v]);
+            if (bends)
+                BendsInBucket(begin, end, bends->data() + bend_first[v]);
+        }
+    });
+}
+
+// orders edges by their first then second vertex
+static inline bool EdgeLess(const MeshEdge &left, const MeshEdge &right)
+{
+    return left.a < right.a || (left.a == right.a && left.b < right.b);
+}
+
+void MeshEdges::Build(const std::vector<ObjTriangle> &triangles, unsigned int vertex_count,
+                      std::vector<MeshEdge> &edges, std::vector<MeshEdge>* bends, ThreadPool* thread_pool)
+{
+    // every side of every triangle with the vertex facing it
+    std::vector<MeshEdge> pairs;
+    std::vector<unsigned int> opposites;
+    pairs.reserve(3 * triangles.size());
+    opposites.reserve(bends ? 3 * triangles.size() : 0);
+    for (size_t tri = 0; tri < triangles.size(); tri++)
+    {
+        // a triangle with a corner out of range has no sides, nor a vertex facing them
+        const unsigned int* v = triangles[tri].positions;
+        if (v[0] >= vertex_count || v[1] >= vertex_count || v[2] >= vertex_count)
+            continue;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            MeshEdge pair;
+            pair.a = v[i];
+            pair.b = v[(i + 1) % 3];
+            if (pair.a == pair.b)
+                continue;
+            if (pair.a > pair.b)
+                std::swap(pair.a, pair.b);
+            pairs.push_back(pair);
+            if (bends)
+                opposites.push_back(v[(i + 2) % 3]);
+        }
+    }
+
+    std::vector<unsigned int> offsets;
+    std::vector<HalfEdge> buckets;
+    BucketPairs(pairs, opposites, vertex_count, offsets, buckets);
+    std::vector<MeshEdge> candidates;
+    CollectBuckets(buckets, offsets, vertex_count, edges, bends ? &candidates : NULL, thread_pool);
+    if (!bends)
+        return;
+
+    // the same pair of vertices can face each other across several edges, and can be an edge itself
+    BucketPairs(candidates, std::vector<unsigned int>(), vertex_count, offsets, buckets);
+    std::vector<MeshEdge> unique;
+    CollectBuckets(buckets, offsets, vertex_count, unique, NULL, thread_pool);
+    bends->clear();
+    bends->reserve(unique.size());
+    for (size_t b = 0; b < unique.size(); b++)
+        if (!std::binary_search(edges.begin(), edges.end(), unique[b], EdgeLess))
+            bends->push_back(unique[b]);
+}
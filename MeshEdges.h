@@ -0,0 +1,33 @@
+#ifndef MESH_EDGES_H
+#define MESH_EDGES_H
+
+// the triangles the edges come from
+#include "ObjParser.h"
+
+#include <vector>
+
+// the triangles are bucketed on the worker threads
+class ThreadPool;
+
+// a pair of vertices, the lowest first
+struct MeshEdge
+{
+    unsigned int a;
+    unsigned int b;
+};
+
+// unique edges of a triangle mesh without any per vertex search: the half edges of every triangle are counting sorted
+// by their lowest vertex, then every vertex's (short) bucket is sorted and deduplicated on its own, in parallel.
+// The same pass pairs the vertices facing each other across every edge shared by two triangles, for bending springs.
+class MeshEdges
+{
+    public:
+    // the unique edges of triangles over vertex_count vertices, ordered by lowest then highest vertex. When bends is
+    // given it receives, in the same order, the unique pairs of vertices opposite an edge shared by two triangles
+    // (every two of them around a non manifold edge) that are not edges themselves. Degenerate edges are skipped, and
+    // triangles with a corner of vertex_count or more
+    static void Build(const std::vector<ObjTriangle> &triangles, unsigned int vertex_count,
+                      std::vector<MeshEdge> &edges, std::vector<MeshEdge>* bends, ThreadPool* thread_pool);
+};
+
+#endif // MESH_EDGES_H
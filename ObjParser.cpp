@@ -0,0 +1,306 @@
+// class declaration
+#include "ObjParser.h"
+
+// the chunks are parsed on the worker threads
+#include "ThreadPool.h"
+
+// std::min, std::max, std::copy
+#include <algorithm>
+// std::from_chars
+#include <charconv>
+#include <cstring>
+
+// smallest run of text handed to a thread, smaller files are parsed by the caller alone
+#define MIN_CHUNK_SIZE (1 << 20)
+// chunks per thread, some lines are much longer than others (faces with normals and textures, comments)
+#define CHUNKS_PER_THREAD 4
+
+// the records of a run of whole lines, with the indices of its faces resolved as if the run started the file
+struct ObjChunk
+{
+    ObjMesh mesh;
+    // corners whose index was negative (relative to the records before it): triangle * 9 + attribute * 3 + corner,
+    // the attributes being position, texture and normal. They move with the records of the chunks before this one
+    std::vector<size_t> relative;
+    // v//n corners, whose index is a texture when the file turns out to have textures and no normals, it is resolved
+    // as both until then: triangle * 3 + corner
+    std::vector<size_t> slashed;
+};
+
+// skips blanks, not line ends
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+// first character of the next line
+static inline const char* NextLine(const char* p, const char* end)
+{
+    const char* line_end = (const char*)memchr(p, '\n', end - p);
+    return line_end ? line_end + 1 : end;
+}
+
+// reads a float after optional blanks, 0 when there is none
+static inline const char* ReadFloat(const char* p, const char* end, float &value)
+{
+    p = SkipBlanks(p, end);
+    // from_chars does not take a leading plus
+    if (p < end && *p == '+')
+        p++;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        value = 0.0f;
+        return p;
+    }
+    return result.ptr;
+}
+
+// reads an integer, 0 when there is none
+static inline const char* ReadIndex(const char* p, const char* end, int &value)
+{
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        value = 0;
+        return p;
+    }
+    return result.ptr;
+}
+
+// one based index to zero based (0 when missing), a negative one counts back from the records read so far and
+// sets bit in relative
+static inline unsigned int ResolveIndex(int index, size_t count, unsigned int bit, unsigned int &relative)
+{
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+    {
+        relative |= bit;
+        return count + index;
+    }
+    return 0;
+}
+
+// reads the v, v/t, v//n or v/t/n corner starting at p into slot of triangle, returns past it. The bits of the slot
+// are set in relative (per attribute) and slashed, the index of a v//n corner goes into both the texture and the
+// normal slot, each resolved against the records of its own attribute
+static inline const char* ReadCorner(const char* p, const char* end, const ObjMesh &mesh, ObjTriangle &triangle,
+                                     unsigned int slot, unsigned int &relative, unsigned int &slashed)
+{
+    int v = 0, t = 0, n = 0;
+    p = ReadIndex(p, end, v);
+    if (p < end && *p == '/')
+    {
+        if (p + 1 < end && p[1] == '/')
+            slashed |= 1 << slot;
+        p = ReadIndex(p + 1, end, t);
+        if (p < end && *p == '/')
+            p = ReadIndex(p + 1, end, n);
+    }
+    if (n == 0)
+        slashed &= ~(1 << slot);
+    triangle.positions[slot] = ResolveIndex(v, mesh.positions.size(), 1 << slot, relative);
+    triangle.textures[slot] = ResolveIndex(t, mesh.texture_coords.size(), 1 << (3 + slot), relative);
+    triangle.normals[slot] = ResolveIndex(n, mesh.normals.size(), 1 << (6 + slot), relative);
+    if (slashed & (1 << slot))
+        triangle.textures[slot] = ResolveIndex(n, mesh.texture_coords.size(), 1 << (3 + slot), relative);
+    // skip whatever is left of a malformed corner
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        p++;
+    return p;
+}
+
+// moves the corner in slot from to slot to, with its bits
+static inline void MoveCorner(ObjTriangle &triangle, unsigned int from, unsigned int to,
+                              unsigned int &relative, unsigned int &slashed)
+{
+    triangle.positions[to] = triangle.positions[from];
+    triangle.textures[to] = triangle.textures[from];
+    triangle.normals[to] = triangle.normals[from];
+    for (unsigned int attribute = 0; attribute < 3; attribute++)
+    {
+        unsigned int bit = (relative >> (attribute * 3 + from)) & 1;
+        relative = (relative & ~(1 << (attribute * 3 + to))) | (bit << (attribute * 3 + to));
+    }
+    slashed = (slashed & ~(1 << to)) | (((slashed >> from) & 1) << to);
+}
+
+// parses the lines in [begin, end) into chunk
+static void ParseChunk(const char* begin, const char* end, ObjChunk &chunk)
+{
+    ObjMesh &mesh = chunk.mesh;
+    for (const char* line = begin; line < end; line = NextLine(line, end))
+    {
+        const char* p = SkipBlanks(line, end);
+        if (end - p < 2)
+            continue;
+
+        if (p[0] == 'v')
+        {
+            std::vector<glm::vec3>* target;
+            if (p[1] == ' ' || p[1] == '\t')
+                target = &mesh.positions;
+            else if (p[1] == 't')
+                target = &mesh.texture_coords;
+            else if (p[1] == 'n')
+                target = &mesh.normals;
+            else
+                continue;
+            p += target == &mesh.positions ? 1 : 2;
+            glm::vec3 vec;
+            p = ReadFloat(p, end, vec.x);
+            p = ReadFloat(p, end, vec.y);
+            ReadFloat(p, end, vec.z);
+            target->push_back(vec);
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            // the first corner, the previous one and the current one make the next triangle of the fan
+            ObjTriangle triangle;
+            unsigned int corners = 0;
+            unsigned int relative = 0, slashed = 0;
+            p += 1;
+            while (true)
+            {
+                p = SkipBlanks(p, end);
+                if (p >= end || *p == '\r' || *p == '\n' || *p == '#')
+                    break;
+                unsigned int slot = corners < 2 ? corners : 2;
+                p = ReadCorner(p, end, mesh, triangle, slot, relative, slashed);
+                corners++;
+                if (corners >= 3)
+                {
+                    size_t id = mesh.triangles.size();
+                    triangle.index = id;
+                    mesh.triangles.push_back(triangle);
+                    for (unsigned int bit = 0; bit < 9; bit++)
+                        if (relative & (1 << bit))
+                            chunk.relative.push_back(id * 9 + bit);
+                    for (unsigned int corner = 0; corner < 3; corner++)
+                        if (slashed & (1 << corner))
+                            chunk.slashed.push_back(id * 3 + corner);
+                    // the corner just read becomes the previous one
+                    MoveCorner(triangle, 2, 1, relative, slashed);
+                }
+            }
+        }
+    }
+}
+
+// the corner bit of a triangle's attribute
+static inline unsigned int &CornerIndex(ObjTriangle &triangle, size_t bit)
+{
+    unsigned int corner = bit % 3;
+    switch (bit / 3)
+    {
+        case 0:
+            return triangle.positions[corner];
+        case 1:
+            return triangle.textures[corner];
+        default:
+            return triangle.normals[corner];
+    }
+}
+
+// WriteObject writes v//t: with textures and no normals in the file the index after // is a texture, as the stream
+// reader has it, otherwise a normal. Clears the other slot of the v//n corners of chunk, whose triangles are placed
+// from first in mesh
+static void FixSlashedCorners(const ObjChunk &chunk, size_t first, bool textures, ObjMesh &mesh)
+{
+    for (size_t s = 0; s < chunk.slashed.size(); s++)
+    {
+        ObjTriangle &triangle = mesh.triangles[first + chunk.slashed[s] / 3];
+        unsigned int corner = chunk.slashed[s] % 3;
+        if (textures)
+            triangle.normals[corner] = 0;
+        else
+            triangle.textures[corner] = 0;
+    }
+}
+
+// copies chunk into mesh after the records of the chunks before it, whose counts are in offsets (positions,
+// texture coordinates, normals and triangles), and moves its relative indices along with them
+static void PlaceChunk(ObjChunk &chunk, const size_t offsets[4], ObjMesh &mesh)
+{
+    std::copy(chunk.mesh.positions.begin(), chunk.mesh.positions.end(), mesh.positions.begin() + offsets[0]);
+    std::copy(chunk.mesh.texture_coords.begin(), chunk.mesh.texture_coords.end(), mesh.texture_coords.begin() + offsets[1]);
+    std::copy(chunk.mesh.normals.begin(), chunk.mesh.normals.end(), mesh.normals.begin() + offsets[2]);
+
+    // a relative index was resolved against the records of its own chunk only
+    for (size_t r = 0; r < chunk.relative.size(); r++)
+    {
+        size_t bit = chunk.relative[r] % 9;
+        CornerIndex(chunk.mesh.triangles[chunk.relative[r] / 9], bit) += offsets[bit / 3];
+    }
+    ObjTriangle* triangles = mesh.triangles.data() + offsets[3];
+    for (size_t tri = 0; tri < chunk.mesh.triangles.size(); tri++)
+    {
+        triangles[tri] = chunk.mesh.triangles[tri];
+        triangles[tri].index += offsets[3];
+    }
+}
+
+void ObjParser::Parse(const char* data, size_t size, ObjMesh &mesh, ThreadPool* thread_pool)
+{
+    // split the text at line ends, a few chunks per thread
+    unsigned int n_chunks = 1;
+    if (thread_pool && thread_pool->Size() > 1)
+        n_chunks = std::max<size_t>(1, std::min<size_t>(thread_pool->Size() * CHUNKS_PER_THREAD, size / MIN_CHUNK_SIZE));
+    std::vector<const char*> bounds(n_chunks + 1);
+    const char* end = data + size;
+    bounds[0] = data;
+    bounds[n_chunks] = end;
+    for (unsigned int c = 1; c < n_chunks; c++)
+        bounds[c] = std::max(bounds[c - 1], NextLine(data + size / n_chunks * c, end));
+
+    std::vector<ObjChunk> chunks(n_chunks);
+    if (n_chunks == 1)
+        ParseChunk(data, end, chunks[0]);
+    else
+        thread_pool->ParallelFor(0, n_chunks, 1, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int c = first; c < last; c++)
+                ParseChunk(bounds[c], bounds[c + 1], chunks[c]);
+        });
+
+    // prefix sums of the record counts place every chunk
+    std::vector<size_t> offsets(4 * (n_chunks + 1), 0);
+    for (unsigned int c = 0; c < n_chunks; c++)
+    {
+        const ObjMesh &part = chunks[c].mesh;
+        offsets[4 * (c + 1) + 0] = offsets[4 * c + 0] + part.positions.size();
+        offsets[4 * (c + 1) + 1] = offsets[4 * c + 1] + part.texture_coords.size();
+        offsets[4 * (c + 1) + 2] = offsets[4 * c + 2] + part.normals.size();
+        offsets[4 * (c + 1) + 3] = offsets[4 * c + 3] + part.triangles.size();
+    }
+    bool slashed_textures = offsets[4 * n_chunks + 2] == 0 && offsets[4 * n_chunks + 1] != 0;
+
+    if (n_chunks == 1)
+    {
+        // nothing comes before the only chunk, its indices are final
+        mesh.positions.swap(chunks[0].mesh.positions);
+        mesh.normals.swap(chunks[0].mesh.normals);
+        mesh.texture_coords.swap(chunks[0].mesh.texture_coords);
+        mesh.triangles.swap(chunks[0].mesh.triangles);
+        FixSlashedCorners(chunks[0], 0, slashed_textures, mesh);
+        return;
+    }
+
+    mesh.positions.resize(offsets[4 * n_chunks + 0]);
+    mesh.texture_coords.resize(offsets[4 * n_chunks + 1]);
+    mesh.normals.resize(offsets[4 * n_chunks + 2]);
+    mesh.triangles.resize(offsets[4 * n_chunks + 3]);
+    thread_pool->ParallelFor(0, n_chunks, 1, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int c = first; c < last; c++)
+        {
+            PlaceChunk(chunks[c], &offsets[4 * c], mesh);
+            FixSlashedCorners(chunks[c], offsets[4 * c + 3], slashed_textures, mesh);
+            // the chunk's memory is freed by the thread that used it
+            chunks[c] = ObjChunk();
+        }
+    });
+}
@@ -0,0 +1,48 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+// glm vec3 vectors
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// POD face struct, a triangle, with zero based indices (0 also stands for a missing texture or normal)
+struct ObjTriangle
+{
+    // triangle index
+    unsigned int index;
+    // arrays containing the face vertex indices
+    unsigned int positions[3];
+    unsigned int normals[3];
+    unsigned int textures[3];
+};
+
+// the records of an .obj file that make a cloth
+struct ObjMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> texture_coords;
+    // faces fanned out into triangles
+    std::vector<ObjTriangle> triangles;
+};
+
+// parser for .obj text held in memory (a mapped file). Numbers are read in place with std::from_chars, faces go
+// straight into the triangle array, and nothing is allocated per line. Handles v, vt, vn and f records with
+// v, v/t, v//n and v/t/n corners, negative (relative) indices and polygons, which are fanned out from their first
+// corner. Other records (comments, groups, materials, ...) are skipped.
+// Large files are split at line ends into chunks parsed on the threads of a pool, each into its own arrays with its
+// indices resolved as if it started the file. The chunks are then copied into place after the record counts of the
+// chunks before them, moving their negative (relative) indices along.
+class ObjParser
+{
+    public:
+    // parses the text [data, data + size) into mesh, whose arrays are replaced, on the threads of thread_pool
+    // when one is given
+    static void Parse(const char* data, size_t size, ObjMesh &mesh, ThreadPool* thread_pool = NULL);
+};
+
+#endif // OBJ_PARSER_H
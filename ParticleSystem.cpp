@@ -0,0 +1,59 @@
+// class declaration
+#include "ParticleSystem.h"
+
+// constructor
+ParticleSystem::ParticleSystem()
+{
+    count_ = 0;
+}
+
+// destructor
+ParticleSystem::~ParticleSystem()
+{
+    // arrays release themselves
+}
+
+void ParticleSystem::Resize(unsigned int count)
+{
+    // round up the array length so that the last vector register is full
+    unsigned int padded = (count + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING;
+    count_ = count;
+
+    // start from a clean state, the padding must stay at zero
+    pos_x_.assign(padded, 0.0f);
+    pos_y_.assign(padded, 0.0f);
+    pos_z_.assign(padded, 0.0f);
+    vel_x_.assign(padded, 0.0f);
+    vel_y_.assign(padded, 0.0f);
+    vel_z_.assign(padded, 0.0f);
+    force_x_.assign(padded, 0.0f);
+    force_y_.assign(padded, 0.0f);
+    force_z_.assign(padded, 0.0f);
+    inv_mass_.assign(padded, 0.0f);
+    flags_.assign(padded, 0);
+}
+
+void ParticleSystem::Clear()
+{
+    Resize(0);
+}
+
+void ParticleSystem::SetMass(float mass)
+{
+    float inv_mass = 1.0f / mass;
+    for (unsigned int particle = 0; particle < count_; particle++)
+        inv_mass_[particle] = (flags_[particle] & kPinned) ? 0.0f : inv_mass;
+}
+
+void ParticleSystem::Pin(unsigned int particle)
+{
+    flags_[particle] |= kPinned;
+    inv_mass_[particle] = 0.0f;
+    SetVelocity(particle, glm::vec3(0));
+}
+
+void ParticleSystem::Unpin(unsigned int particle, float mass)
+{
+    flags_[particle] &= ~kPinned;
+    inv_mass_[particle] = 1.0f / mass;
+}
@@ -0,0 +1,130 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+// cache line aligned arrays
+#include "AlignedAllocator.h"
+
+// glm vec3 vectors for the accessors
+#include <glm/glm.hpp>
+
+// arrays are padded to a multiple of this many particles so vector loops can run over whole registers
+#define PARTICLE_PADDING 16
+
+// structure of arrays storage for the mass particles of a cloth, one cache aligned array per component
+class ParticleSystem
+{
+    public:
+    // per particle bit flags
+    enum Flags : unsigned int
+    {
+        kPinned = 1,
+        // a collidable has set the particle's velocity this step, implicit solvers hold it
+        kContact = 2,
+    };
+
+    // constructor
+    ParticleSystem();
+    // destructor
+    ~ParticleSystem();
+
+    // sets the number of particles, new particles are at rest at the origin with a zero inverse mass (they do not move)
+    // until SetMass gives them one
+    void Resize(unsigned int count);
+    void Clear();
+    unsigned int Size() const;
+
+    // sets the mass of every particle that is not pinned
+    void SetMass(float mass);
+    // a pinned particle has an infinite mass and never moves
+    void Pin(unsigned int particle);
+    void Unpin(unsigned int particle, float mass);
+
+    // vec3 accessors for scalar code
+    glm::vec3 Position(unsigned int particle) const;
+    glm::vec3 Velocity(unsigned int particle) const;
+    glm::vec3 Force(unsigned int particle) const;
+    float Mass(unsigned int particle) const;
+    void SetPosition(unsigned int particle, const glm::vec3 &position);
+    void SetVelocity(unsigned int particle, const glm::vec3 &velocity);
+    void SetForce(unsigned int particle, const glm::vec3 &force);
+    void AddForce(unsigned int particle, const glm::vec3 &force);
+
+    // number of particles in use (the arrays may be longer because of padding)
+    unsigned int count_;
+
+    // positions
+    AlignedVector<float> pos_x_;
+    AlignedVector<float> pos_y_;
+    AlignedVector<float> pos_z_;
+    // velocities
+    AlignedVector<float> vel_x_;
+    AlignedVector<float> vel_y_;
+    AlignedVector<float> vel_z_;
+    // sum of all the forces applied to the particles
+    AlignedVector<float> force_x_;
+    AlignedVector<float> force_y_;
+    AlignedVector<float> force_z_;
+    // inverse masses, zero for pinned particles
+    AlignedVector<float> inv_mass_;
+    // bit mask of Flags
+    AlignedVector<unsigned int> flags_;
+};
+
+//
+// Accessors (inlined, they are used in every per particle loop)
+//
+
+inline unsigned int ParticleSystem::Size() const
+{
+    return count_;
+}
+
+inline glm::vec3 ParticleSystem::Position(unsigned int particle) const
+{
+    return glm::vec3(pos_x_[particle], pos_y_[particle], pos_z_[particle]);
+}
+
+inline glm::vec3 ParticleSystem::Velocity(unsigned int particle) const
+{
+    return glm::vec3(vel_x_[particle], vel_y_[particle], vel_z_[particle]);
+}
+
+inline glm::vec3 ParticleSystem::Force(unsigned int particle) const
+{
+    return glm::vec3(force_x_[particle], force_y_[particle], force_z_[particle]);
+}
+
+inline float ParticleSystem::Mass(unsigned int particle) const
+{
+    return inv_mass_[particle] == 0.0f ? 0.0f : 1.0f / inv_mass_[particle];
+}
+
+inline void ParticleSystem::SetPosition(unsigned int particle, const glm::vec3 &position)
+{
+    pos_x_[particle] = position.x;
+    pos_y_[particle] = position.y;
+    pos_z_[particle] = position.z;
+}
+
+inline void ParticleSystem::SetVelocity(unsigned int particle, const glm::vec3 &velocity)
+{
+    vel_x_[particle] = velocity.x;
+    vel_y_[particle] = velocity.y;
+    vel_z_[particle] = velocity.z;
+}
+
+inline void ParticleSystem::SetForce(unsigned int particle, const glm::vec3 &force)
+{
+    force_x_[particle] = force.x;
+    force_y_[particle] = force.y;
+    force_z_[particle] = force.z;
+}
+
+inline void ParticleSystem::AddForce(unsigned int particle, const glm::vec3 &force)
+{
+    force_x_[particle] += force.x;
+    force_y_[particle] += force.y;
+    force_z_[particle] += force.z;
+}
+
+#endif // PARTICLE_SYSTEM_H
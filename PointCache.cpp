@@ -0,0 +1,458 @@
+// class declarations
+#include "PointCache.h"
+
+// the topology of the recorded object
+#include "ClothObject.h"
+
+#include <algorithm>
+#include <cstring>
+
+// the first bytes of every point cache
+#define POINT_CACHE_MAGIC "CLOTHPC"
+// written as is, reads back as something else on a machine of the other byte order
+#define POINT_CACHE_BYTE_ORDER 0x01020304u
+// the largest quantized value
+#define QUANTIZED_MAX 65535.0f
+// frame record flags
+#define FRAME_KEY 1
+
+// the start of every file, the topology follows
+struct PointCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t particle_count;
+    uint32_t key_interval;
+    uint32_t texture_count;
+    uint32_t triangle_count;
+    // 0 while the writer has not closed the file
+    uint32_t frame_count;
+    uint32_t reserved;
+    uint64_t texture_offset;
+    uint64_t triangle_offset;
+    // the first frame record
+    uint64_t frames_offset;
+    // frame_count record offsets then frame_count frame numbers, 0 while the writer has not closed the file
+    uint64_t index_offset;
+};
+
+// the start of every frame, its coded values follow
+struct FrameRecord
+{
+    uint32_t number;
+    uint32_t flags;
+    // the length of the coded values
+    uint32_t bytes;
+    uint32_t reserved;
+    float min[3];
+    float max[3];
+};
+
+// -1, 1, -2, 2 ... to 1, 2, 3, 4 ..., small differences of either sign become small numbers
+static inline uint16_t ZigZag(uint16_t difference)
+{
+    int16_t value = (int16_t)difference;
+    return (uint16_t)((value << 1) ^ (value >> 15));
+}
+
+static inline uint16_t UnZigZag(uint16_t value)
+{
+    return (uint16_t)((value >> 1) ^ -(value & 1));
+}
+
+// seven bits a byte, the high bit set on every byte but the last
+static inline uint8_t* PutVarint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// returns NULL when the varint runs past end or is too long
+static inline const uint8_t* GetVarint(const uint8_t* in, const uint8_t* end, uint32_t &value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 35 && in < end; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return in;
+    }
+    return NULL;
+}
+
+// the quantized value of coordinate x across [min, min + extent], scale being QUANTIZED_MAX / extent
+static inline uint16_t Quantize(float x, float min, float scale)
+{
+    float q = (x - min) * scale + 0.5f;
+    // NaN goes to the bottom of the box
+    if (!(q >= 0.0f))
+        return 0;
+    return q >= QUANTIZED_MAX ? (uint16_t)QUANTIZED_MAX : (uint16_t)q;
+}
+
+// constructor
+PointCacheWriter::PointCacheWriter()
+{
+    file_ = NULL;
+    failed_ = false;
+    particle_count_ = 0;
+    key_interval_ = POINT_CACHE_KEY_INTERVAL;
+    size_ = 0;
+}
+
+// destructor
+PointCacheWriter::~PointCacheWriter()
+{
+    Close();
+}
+
+bool PointCacheWriter::Open(const std::string &cache_file, const ClothObject &object, unsigned int key_interval)
+{
+    Close();
+    // read back by Close for the header
+    file_ = fopen(cache_file.c_str(), "w+b");
+    if (!file_)
+        return false;
+    failed_ = false;
+    particle_count_ = object.mass_particles_.Size();
+    key_interval_ = key_interval > 0 ? key_interval : 1;
+    index_.clear();
+    numbers_.clear();
+    previous_.assign(3 * (size_t)particle_count_, 0);
+    current_.assign(3 * (size_t)particle_count_, 0);
+    // at most three bytes a value, a zero run costs no more than the values it stands for
+    bytes_.resize(9 * (size_t)particle_count_ + 16);
+
+    // the faces as WriteObject writes them, texture indices only with texture coordinates
+    bool textures = (object.object_properties_ & ClothObject::kHasTextures) && !object.texture_coords_.empty();
+    std::vector<uint32_t> triangles(6 * object.triangles_.size());
+    for (size_t tri = 0; tri < object.triangles_.size(); tri++)
+        for (unsigned int v = 0; v < 3; v++)
+        {
+            triangles[6 * tri + v] = object.triangles_[tri].positions[v];
+            triangles[6 * tri + 3 + v] = textures ? object.triangles_[tri].textures[v] : 0;
+        }
+
+    PointCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, POINT_CACHE_MAGIC, sizeof(POINT_CACHE_MAGIC));
+    header.version = POINT_CACHE_VERSION;
+    header.byte_order = POINT_CACHE_BYTE_ORDER;
+    header.particle_count = particle_count_;
+    header.key_interval = key_interval_;
+    header.texture_count = textures ? object.texture_coords_.size() : 0;
+    header.triangle_count = object.triangles_.size();
+    header.texture_offset = sizeof(header);
+    header.triangle_offset = header.texture_offset + header.texture_count * sizeof(glm::vec3);
+    header.frames_offset = header.triangle_offset + triangles.size() * sizeof(uint32_t);
+
+    failed_ = fwrite(&header, sizeof(header), 1, file_) != 1
+              || fwrite(object.texture_coords_.data(), sizeof(glm::vec3), header.texture_count, file_) != header.texture_count
+              || fwrite(triangles.data(), sizeof(uint32_t), triangles.size(), file_) != triangles.size();
+    size_ = header.frames_offset;
+    return !failed_;
+}
+
+bool PointCacheWriter::Append(const float* positions, unsigned int frame)
+{
+    if (!file_ || failed_)
+        return false;
+    unsigned int n = particle_count_;
+    bool key = index_.size() % key_interval_ == 0;
+
+    FrameRecord record;
+    memset(&record, 0, sizeof(record));
+    record.number = frame;
+    record.flags = key ? FRAME_KEY : 0;
+
+    // quantized across the frame's own box, into three planes
+    for (unsigned int axis = 0; axis < 3; axis++)
+    {
+        float min = n > 0 ? positions[axis] : 0.0f;
+        float max = min;
+        for (unsigned int p = 1; p < n; p++)
+        {
+            min = std::min(min, positions[3 * p + axis]);
+            max = std::max(max, positions[3 * p + axis]);
+        }
+        record.min[axis] = min;
+        record.max[axis] = max;
+        float scale = max > min ? QUANTIZED_MAX / (max - min) : 0.0f;
+        uint16_t* plane = current_.data() + (size_t)axis * n;
+        for (unsigned int p = 0; p < n; p++)
+            plane[p] = Quantize(positions[3 * p + axis], min, scale);
+    }
+
+    // differences to the prediction, zeros run length coded
+    uint8_t* out = bytes_.data();
+    uint32_t run = 0;
+    for (size_t i = 0; i < current_.size(); i++)
+    {
+        uint16_t predicted = key ? (i % n == 0 ? 0 : current_[i - 1]) : previous_[i];
+        uint16_t value = ZigZag((uint16_t)(current_[i] - predicted));
+        if (value == 0)
+        {
+            run++;
+            continue;
+        }
+        // a varint other than 0 never starts with a zero byte
+        if (run > 0)
+        {
+            *out++ = 0;
+            out = PutVarint(out, run - 1);
+            run = 0;
+        }
+        out = PutVarint(out, value);
+    }
+    if (run > 0)
+    {
+        *out++ = 0;
+        out = PutVarint(out, run - 1);
+    }
+    record.bytes = out - bytes_.data();
+
+    index_.push_back(size_);
+    numbers_.push_back(frame);
+    previous_.swap(current_);
+    failed_ = fwrite(&record, sizeof(record), 1, file_) != 1
+              || fwrite(bytes_.data(), 1, record.bytes, file_) != record.bytes;
+    size_ += sizeof(record) + record.bytes;
+    return !failed_;
+}
+
+bool PointCacheWriter::Close()
+{
+    if (!file_)
+        return false;
+
+    // the index after the frames, then the header again with its count and offset
+    PointCacheHeader header;
+    uint64_t index_offset = size_;
+    uint32_t frame_count = index_.size();
+    failed_ = failed_
+              || fwrite(index_.data(), sizeof(uint64_t), index_.size(), file_) != index_.size()
+              || fwrite(numbers_.data(), sizeof(uint32_t), numbers_.size(), file_) != numbers_.size()
+              || fseek(file_, 0, SEEK_SET) != 0
+              || fread(&header, sizeof(header), 1, file_) != 1;
+    if (failed_)
+    {
+        fclose(file_);
+        file_ = NULL;
+        return false;
+    }
+    header.frame_count = frame_count;
+    header.index_offset = index_offset;
+    failed_ = fseek(file_, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file_) != 1;
+    failed_ = fclose(file_) != 0 || failed_;
+    file_ = NULL;
+    size_ += index_.size() * (sizeof(uint64_t) + sizeof(uint32_t));
+    return !failed_;
+}
+
+// constructor
+PointCacheReader::PointCacheReader()
+{
+    particle_count_ = 0;
+    texture_offset_ = triangle_offset_ = 0;
+    texture_count_ = triangle_count_ = 0;
+    decoded_ = -1;
+}
+
+bool PointCacheReader::Open(const std::string &cache_file)
+{
+    Close();
+    if (!file_.Open(cache_file) || file_.Size() < sizeof(PointCacheHeader))
+        return false;
+    const char* data = file_.Data();
+    uint64_t size = file_.Size();
+    PointCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, POINT_CACHE_MAGIC, sizeof(POINT_CACHE_MAGIC)) != 0
+        || header.version != POINT_CACHE_VERSION || header.byte_order != POINT_CACHE_BYTE_ORDER)
+        return false;
+
+    // the topology inside the file, the frames after it
+    if (header.texture_offset != sizeof(header)
+        || header.triangle_offset != header.texture_offset + (uint64_t)header.texture_count * sizeof(glm::vec3)
+        || header.frames_offset != header.triangle_offset + (uint64_t)header.triangle_count * 6 * sizeof(uint32_t)
+        || header.frames_offset > size)
+        return false;
+    const uint32_t* triangles = (const uint32_t*)(data + header.triangle_offset);
+    for (uint64_t i = 0; i < 6 * (uint64_t)header.triangle_count; i++)
+        if (triangles[i] >= (i % 6 < 3 ? header.particle_count : std::max(header.texture_count, 1u)))
+            return false;
+
+    if (header.index_offset != 0)
+    {
+        uint64_t count = header.frame_count;
+        if (header.index_offset < header.frames_offset
+            || header.index_offset + count * (sizeof(uint64_t) + sizeof(uint32_t)) > size)
+            return false;
+        index_.resize(count);
+        numbers_.resize(count);
+        memcpy(index_.data(), data + header.index_offset, count * sizeof(uint64_t));
+        memcpy(numbers_.data(), data + header.index_offset + count * sizeof(uint64_t), count * sizeof(uint32_t));
+        for (uint64_t f = 0; f < count; f++)
+        {
+            FrameRecord record;
+            if (index_[f] < header.frames_offset || index_[f] + sizeof(record) > header.index_offset)
+                return false;
+            memcpy(&record, data + index_[f], sizeof(record));
+            if (index_[f] + sizeof(record) + record.bytes > header.index_offset)
+                return false;
+        }
+    }
+    else
+    {
+        // never closed, the whole records written are kept
+        uint64_t offset = header.frames_offset;
+        FrameRecord record;
+        while (offset + sizeof(record) <= size)
+        {
+            memcpy(&record, data + offset, sizeof(record));
+            if (offset + sizeof(record) + record.bytes > size)
+                break;
+            index_.push_back(offset);
+            numbers_.push_back(record.number);
+            offset += sizeof(record) + record.bytes;
+        }
+    }
+    // the first frame is a key frame, there is nothing to decode against
+    if (!index_.empty())
+    {
+        FrameRecord record;
+        memcpy(&record, data + index_[0], sizeof(record));
+        if (!(record.flags & FRAME_KEY))
+            return false;
+    }
+
+    particle_count_ = header.particle_count;
+    texture_offset_ = header.texture_offset;
+    texture_count_ = header.texture_count;
+    triangle_offset_ = header.triangle_offset;
+    triangle_count_ = header.triangle_count;
+    quantized_.assign(3 * (size_t)particle_count_, 0);
+    decoded_ = -1;
+    return true;
+}
+
+void PointCacheReader::Close()
+{
+    file_.Close();
+    particle_count_ = 0;
+    texture_count_ = triangle_count_ = 0;
+    index_.clear();
+    numbers_.clear();
+    quantized_.clear();
+    decoded_ = -1;
+}
+
+const float* PointCacheReader::TextureCoords() const
+{
+    return (const float*)(file_.Data() + texture_offset_);
+}
+
+const uint32_t* PointCacheReader::Triangles() const
+{
+    return (const uint32_t*)(file_.Data() + triangle_offset_);
+}
+
+bool PointCacheReader::DecodeFrame(unsigned int index)
+{
+    FrameRecord record;
+    memcpy(&record, file_.Data() + index_[index], sizeof(record));
+    const uint8_t* in = (const uint8_t*)file_.Data() + index_[index] + sizeof(record);
+    const uint8_t* end = in + record.bytes;
+    bool key = record.flags & FRAME_KEY;
+    size_t n = particle_count_;
+    size_t count = quantized_.size();
+
+    size_t i = 0;
+    while (i < count)
+    {
+        if (in >= end)
+            return false;
+        uint32_t value;
+        uint32_t run = 1;
+        if (*in == 0)
+        {
+            in = GetVarint(in + 1, end, run);
+            if (!in || run >= count - i)
+                return false;
+            run++;
+            value = 0;
+        }
+        else if (!(in = GetVarint(in, end, value)) || value > 0xffff)
+            return false;
+        for (uint32_t r = 0; r < run; r++, i++)
+        {
+            uint16_t predicted = key ? (i % n == 0 ? 0 : quantized_[i - 1]) : quantized_[i];
+            quantized_[i] = (uint16_t)(predicted + UnZigZag((uint16_t)value));
+        }
+    }
+    return in == end;
+}
+
+bool PointCacheReader::ReadFrame(unsigned int index, float* positions)
+{
+    if (index >= index_.size())
+        return false;
+    const char* data = file_.Data();
+
+    // the key frame this one is coded from, or the one just decoded when it comes before
+    if (decoded_ != (long)index)
+    {
+        long first = index;
+        FrameRecord record;
+        while (true)
+        {
+            memcpy(&record, data + index_[first], sizeof(record));
+            if ((record.flags & FRAME_KEY) || first == decoded_ + 1)
+                break;
+            first--;
+        }
+        for (long f = first; f <= (long)index; f++)
+            if (!DecodeFrame(f))
+            {
+                decoded_ = -1;
+                return false;
+            }
+        decoded_ = index;
+    }
+
+    FrameRecord record;
+    memcpy(&record, data + index_[index], sizeof(record));
+    size_t n = particle_count_;
+    for (unsigned int axis = 0; axis < 3; axis++)
+    {
+        float min = record.min[axis];
+        float step = (record.max[axis] - min) / QUANTIZED_MAX;
+        const uint16_t* plane = quantized_.data() + axis * n;
+        for (size_t p = 0; p < n; p++)
+            positions[3 * p + axis] = min + plane[p] * step;
+    }
+    return true;
+}
+
+bool PointCacheReader::ReadFrame(unsigned int index, ParticleSystem &particles)
+{
+    if (particles.Size() != particle_count_)
+        return false;
+    scratch_.resize(3 * (size_t)particle_count_);
+    if (!ReadFrame(index, scratch_.data()))
+        return false;
+    for (unsigned int p = 0; p < particle_count_; p++)
+    {
+        particles.pos_x_[p] = scratch_[3 * p];
+        particles.pos_y_[p] = scratch_[3 * p + 1];
+        particles.pos_z_[p] = scratch_[3 * p + 2];
+    }
+    return true;
+}
@@ -0,0 +1,160 @@
+#ifndef POINT_CACHE_H
+#define POINT_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the read frames and topology
+#include "MappedFile.h"
+
+class ClothObject;
+class ParticleSystem;
+
+// format version, bumped whenever the layout of the file or the coding of the frames changes
+#define POINT_CACHE_VERSION 1
+// a frame coded on its own every this many frames, the others are coded against the frame before them
+#define POINT_CACHE_KEY_INTERVAL 30
+
+// .clothpc files: an animation of a cloth whose topology does not change. The texture coordinates and faces are stored
+// once after the header, then every frame is a record of its own: the bounding box of the particles, each coordinate
+// quantized to 16 bits across the box, then the quantized values coded as differences and packed into bytes. Key
+// frames take the difference to the previous particle along each axis, the frames after them the difference to the
+// same particle in the frame before. Differences are zigzag varints, runs of zeros (pinned or resting particles) a
+// zero byte and the run length. The file ends with the offset of every frame, so any frame is found without a scan
+// and decoded from the key frame before it at most. A file whose writer never closed it has no index, its frames are
+// found by walking the records.
+class PointCacheWriter
+{
+    public:
+    // constructor
+    PointCacheWriter();
+    // destructor closes the file
+    ~PointCacheWriter();
+
+    // creates the file with the topology of object, returns false when it cannot be written
+    bool Open(const std::string &cache_file, const ClothObject &object, unsigned int key_interval = POINT_CACHE_KEY_INTERVAL);
+    // codes and appends a frame of Particles() interleaved xyz positions, numbered frame
+    bool Append(const float* positions, unsigned int frame);
+    // writes the frame index and the final header, returns false when any write failed
+    bool Close();
+
+    bool IsOpen() const;
+    unsigned int Particles() const;
+    unsigned int Frames() const;
+    // bytes written so far
+    uint64_t Size() const;
+
+    private:
+    // not copyable, the file belongs to one object
+    PointCacheWriter(const PointCacheWriter &);
+    PointCacheWriter &operator = (const PointCacheWriter &);
+
+    FILE* file_;
+    bool failed_;
+    unsigned int particle_count_;
+    unsigned int key_interval_;
+    uint64_t size_;
+    // the offset of every frame record
+    std::vector<uint64_t> index_;
+    std::vector<uint32_t> numbers_;
+    // the quantized frame before, three planes of particle_count_ values
+    std::vector<uint16_t> previous_;
+    std::vector<uint16_t> current_;
+    // the coded frame
+    std::vector<uint8_t> bytes_;
+};
+
+// reads frames of a .clothpc file in any order, from a mapping of the file
+class PointCacheReader
+{
+    public:
+    // constructor
+    PointCacheReader();
+
+    // maps the file and finds its frames, returns false when it is missing, from another version or inconsistent
+    bool Open(const std::string &cache_file);
+    void Close();
+
+    unsigned int Particles() const;
+    unsigned int Frames() const;
+    // the number the frame at index was appended with
+    unsigned int FrameNumber(unsigned int index) const;
+
+    // the topology, texture coordinates as xyz triples and triangles as three position then three texture indices
+    const float* TextureCoords() const;
+    unsigned int TextureCoordCount() const;
+    const uint32_t* Triangles() const;
+    unsigned int TriangleCount() const;
+
+    // decodes the frame at index into Particles() interleaved xyz positions, returns false when it is corrupt.
+    // Reading the frames in order decodes each once, a jump decodes from the key frame before it
+    bool ReadFrame(unsigned int index, float* positions);
+    // the same into the positions of particles, which must be Particles() many
+    bool ReadFrame(unsigned int index, ParticleSystem &particles);
+
+    private:
+    // undoes the coding of the record at index on top of quantized_, which holds the frame before it
+    bool DecodeFrame(unsigned int index);
+
+    MappedFile file_;
+    unsigned int particle_count_;
+    uint64_t texture_offset_;
+    unsigned int texture_count_;
+    uint64_t triangle_offset_;
+    unsigned int triangle_count_;
+    std::vector<uint64_t> index_;
+    std::vector<uint32_t> numbers_;
+    // the last decoded frame (decoded_ is its index, or -1), quantized
+    std::vector<uint16_t> quantized_;
+    long decoded_;
+    std::vector<float> scratch_;
+};
+
+inline bool PointCacheWriter::IsOpen() const
+{
+    return file_ != NULL;
+}
+
+inline unsigned int PointCacheWriter::Particles() const
+{
+    return particle_count_;
+}
+
+inline unsigned int PointCacheWriter::Frames() const
+{
+    return index_.size();
+}
+
+inline uint64_t PointCacheWriter::Size() const
+{
+    return size_;
+}
+
+inline unsigned int PointCacheReader::Particles() const
+{
+    return particle_count_;
+}
+
+inline unsigned int PointCacheReader::Frames() const
+{
+    return index_.size();
+}
+
+inline unsigned int PointCacheReader::FrameNumber(unsigned int index) const
+{
+    return numbers_[index];
+}
+
+inline unsigned int PointCacheReader::TextureCoordCount() const
+{
+    return texture_count_;
+}
+
+inline unsigned int PointCacheReader::TriangleCount() const
+{
+    return triangle_count_;
+}
+
+#endif // POINT_CACHE_H
@@ -2,19 +2,18 @@
 #include "PointMass.h"
 
 // glut sphere 
+#ifndef CLOTH_HEADLESS
 #include <GL/freeglut.h>
+#endif
 
 //
 #include <iostream>
 
-// constructor sets the initial conditions of the particle
-PointMass::PointMass(float mass, glm::vec3 velocity, glm::vec3 position)
+// constructor points the view at a particle in the arrays
+PointMass::PointMass(ParticleSystem* particles, unsigned int particle)
 {
-    mass_ = mass;
-    velocity_ = velocity;
-    position_ = position;
-    net_F_ = glm::vec3(0);
-    index = 0;
+    particles_ = particles;
+    index = particle;
 }
 
 PointMass::~PointMass()
@@ -22,6 +21,7 @@ PointMass::~PointMass()
     // do something
 }
 
+#ifndef CLOTH_HEADLESS
 void PointMass::DrawPoint()
 {
     // set up the quadric object for the sphere
@@ -33,10 +33,12 @@ void PointMass::DrawPoint()
 
     // draw a low resolution sphere
     glPushMatrix();
-    glTranslatef(position_.x, position_.y, position_.z);
+    glm::vec3 position = Position();
+    glTranslatef(position.x, position.y, position.z);
     gluSphere(quad_obj, 0.1, 10, 10);
     glPopMatrix();
 }
+#endif // CLOTH_HEADLESS
 
 std::ostream & operator << (std::ostream &outStream, const PointMass &point_mass)
 {
@@ -1,46 +1,97 @@
 #ifndef POINT_MASS_H
 #define POINT_MASS_H
 
-// glm vec3 vectors 
+// glm vec3 vectors
 #include <glm/glm.hpp>
 
-// container for the springs linked to this particle
-#include <vector>
+// the arrays the particle lives in
+#include "ParticleSystem.h"
 
 #include <iostream>
 
-// POD Class for a mass particle used in the cloth simulation
+// lightweight view of a single mass particle stored in a ParticleSystem
 class PointMass
 {
     public:
 
-    // constructor for a mass particle
-    PointMass(float mass, glm::vec3 velocity, glm::vec3 position);
+    // constructor for a view on a particle
+    PointMass(ParticleSystem* particles, unsigned int particle);
     // destructor
     ~PointMass();
 
+#ifndef CLOTH_HEADLESS
     // draw a sphere at the point's location
     void DrawPoint();
+#endif
+
+    // accessors forwarding to the particle arrays
+    glm::vec3 Position() const;
+    glm::vec3 Velocity() const;
+    glm::vec3 Force() const;
+    float Mass() const;
+    void SetPosition(const glm::vec3 &position);
+    void SetVelocity(const glm::vec3 &velocity);
+    void SetForce(const glm::vec3 &force);
+    void AddForce(const glm::vec3 &force);
+    // marks the particle as held by a collidable for the current step
+    void SetContact();
+
+    // the particle arrays being viewed
+    ParticleSystem* particles_;
 
     // particle index for comparison
     unsigned int index;
+};
 
-    // the particle's mass
-    float mass_;
+//
+// Accessors
+//
 
-    // sum of all the forces applied to the particle
-    glm::vec3 net_F_;
+inline glm::vec3 PointMass::Position() const
+{
+    return particles_->Position(index);
+}
 
-    // particle's velocity
-    glm::vec3 velocity_;
+inline glm::vec3 PointMass::Velocity() const
+{
+    return particles_->Velocity(index);
+}
 
-    // a pointer to a vertex position
-    glm::vec3 position_;
+inline glm::vec3 PointMass::Force() const
+{
+    return particles_->Force(index);
+}
 
-    // a vector containing the ids of the the springs this particle is connected to 
-    std::vector<unsigned int> spring_indices_;
-};
+inline float PointMass::Mass() const
+{
+    return particles_->Mass(index);
+}
+
+inline void PointMass::SetPosition(const glm::vec3 &position)
+{
+    particles_->SetPosition(index, position);
+}
+
+inline void PointMass::SetVelocity(const glm::vec3 &velocity)
+{
+    particles_->SetVelocity(index, velocity);
+}
+
+inline void PointMass::SetForce(const glm::vec3 &force)
+{
+    particles_->SetForce(index, force);
+}
+
+inline void PointMass::AddForce(const glm::vec3 &force)
+{
+    particles_->AddForce(index, force);
+}
+
+inline void PointMass::SetContact()
+{
+    particles_->flags_[index] |= ParticleSystem::kContact;
+}
 
 std::ostream & operator << (std::ostream &outStream, const PointMass &p_mass);
 
-#endif
\ No newline at end of file
+#endif
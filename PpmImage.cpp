@@ -0,0 +1,120 @@
+// class declaration
+#include "PpmImage.h"
+
+// the file is read from a mapping
+#include "MappedFile.h"
+
+// std::from_chars
+#include <charconv>
+#include <cstring>
+
+static_assert(sizeof(RgbPixel) == 3, "pixels are packed RGB triplets");
+
+// whitespace of the header
+static inline bool IsWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// skips whitespace and # comments (up to the end of their line), never past end
+static const char* SkipSeparators(const char* p, const char* end)
+{
+    while (p < end)
+    {
+        if (*p == '#')
+        {
+            while (p < end && *p != '\n')
+                p++;
+        }
+        else if (IsWhitespace(*p))
+            p++;
+        else
+            break;
+    }
+    return p;
+}
+
+// reads a positive number after the separators, NULL when there is none
+static const char* ReadNumber(const char* p, const char* end, unsigned int &value)
+{
+    p = SkipSeparators(p, end);
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return NULL;
+    return result.ptr;
+}
+
+// a value out of max scaled to a byte
+static inline unsigned char ScaleValue(unsigned int value, unsigned int max)
+{
+    if (value >= max)
+        return 255;
+    return (value * 255 + max / 2) / max;
+}
+
+// constructor
+PpmImage::PpmImage()
+{
+    width_ = height_ = 0;
+}
+
+bool PpmImage::Read(const std::string &ppm_file)
+{
+    MappedFile file;
+    if (!file.Open(ppm_file) || file.Size() < 2)
+        return false;
+    const char* p = file.Data();
+    const char* end = p + file.Size();
+
+    // magic number, then width, height and maximum value
+    if (p[0] != 'P' || (p[1] != '6' && p[1] != '3'))
+        return false;
+    bool binary = p[1] == '6';
+    unsigned int width, height, max;
+    p = ReadNumber(p + 2, end, width);
+    p = p ? ReadNumber(p, end, height) : NULL;
+    p = p ? ReadNumber(p, end, max) : NULL;
+    if (!p || width == 0 || height == 0 || width > PPM_MAX_DIMENSION || height > PPM_MAX_DIMENSION
+        || max == 0 || max > 65535)
+        return false;
+
+    size_t count = (size_t)width * height;
+    std::vector<RgbPixel> pixels(count);
+    unsigned char* bytes = (unsigned char*)pixels.data();
+    if (binary)
+    {
+        // a single whitespace character separates the header from the samples, two bytes each above 255, a file
+        // that ends with the header is truncated
+        if (p >= end || !IsWhitespace(*p))
+            return false;
+        p++;
+        size_t sample_size = max < 256 ? 1 : 2;
+        if ((size_t)(end - p) < 3 * count * sample_size)
+            return false;
+        const unsigned char* samples = (const unsigned char*)p;
+        if (max == 255)
+            memcpy(bytes, samples, 3 * count);
+        else if (sample_size == 1)
+            for (size_t i = 0; i < 3 * count; i++)
+                bytes[i] = ScaleValue(samples[i], max);
+        else
+            for (size_t i = 0; i < 3 * count; i++)
+                bytes[i] = ScaleValue(samples[2 * i] << 8 | samples[2 * i + 1], max);
+    }
+    else
+    {
+        for (size_t i = 0; i < 3 * count; i++)
+        {
+            unsigned int value;
+            p = ReadNumber(p, end, value);
+            if (!p)
+                return false;
+            bytes[i] = max == 255 ? (value > 255 ? 255 : value) : ScaleValue(value, max);
+        }
+    }
+
+    width_ = width;
+    height_ = height;
+    pixels_.swap(pixels);
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef PPM_IMAGE_H
+#define PPM_IMAGE_H
+
+#include <string>
+#include <vector>
+
+// largest width or height accepted, beyond any texture size OpenGL implementations support
+#define PPM_MAX_DIMENSION 16384
+
+// just three integer values for RGB
+struct RgbPixel
+{
+    unsigned char red;
+    unsigned char green;
+    unsigned char blue;
+};
+
+// an RGB image read from a .ppm file, binary (P6) or ASCII (P3), with any maximum value. The pixels are packed rows,
+// top row first, ready to be uploaded as they are. A binary file at 8 bits per channel, the usual kind, is copied out
+// of a mapping of the file in one go; the others are converted value by value.
+// Reading does not touch OpenGL, it can run on any thread.
+class PpmImage
+{
+    public:
+    // constructor
+    PpmImage();
+
+    // returns false, leaving the image as it was, when the file cannot be read, is not a P6 or P3 file, has a
+    // dimension of 0 or over PPM_MAX_DIMENSION, or is shorter than its dimensions say
+    bool Read(const std::string &ppm_file);
+
+    int width_;
+    int height_;
+    std::vector<RgbPixel> pixels_;
+};
+
+#endif // PPM_IMAGE_H
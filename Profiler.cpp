@@ -0,0 +1,101 @@
+// class declaration
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+// profiler state
+std::atomic<bool> Profiler::enabled_(false);
+std::mutex Profiler::mutex_;
+std::vector<ProfileBuffer*> Profiler::buffers_;
+
+// time origin of the events
+static const std::chrono::steady_clock::time_point profile_epoch = std::chrono::steady_clock::now();
+
+// constructor
+ProfileBuffer::ProfileBuffer(unsigned int thread) : events_(PROFILE_BUFFER_SIZE), written_(0)
+{
+    thread_ = thread;
+}
+
+void ProfileBuffer::Push(const char* name, int64_t start, int64_t duration)
+{
+    uint64_t index = written_.load(std::memory_order_relaxed);
+    ProfileEvent &event = events_[index % PROFILE_BUFFER_SIZE];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    // publishes the event to a reader
+    written_.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::Enabled()
+{
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profile_epoch).count();
+}
+
+ProfileBuffer* Profiler::ThreadBuffer()
+{
+    thread_local ProfileBuffer* buffer = NULL;
+    if (buffer == NULL)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer = new ProfileBuffer(buffers_.size());
+        buffers_.push_back(buffer);
+    }
+    return buffer;
+}
+
+void Profiler::Record(const char* name, int64_t start, int64_t end)
+{
+    ThreadBuffer()->Push(name, start, end - start);
+}
+
+void Profiler::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (unsigned int b = 0; b < buffers_.size(); b++)
+        buffers_[b]->written_.store(0, std::memory_order_relaxed);
+}
+
+bool Profiler::WriteChromeTrace(const std::string &file)
+{
+    std::ofstream trace(file, std::ios::out);
+    if (!trace.is_open())
+        return false;
+
+    // complete ("X") events, times in microseconds
+    trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (unsigned int b = 0; b < buffers_.size(); b++)
+    {
+        const ProfileBuffer &buffer = *buffers_[b];
+        uint64_t written = buffer.written_.load(std::memory_order_acquire);
+        uint64_t count = std::min<uint64_t>(written, PROFILE_BUFFER_SIZE);
+        trace << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.thread_
+              << ",\"args\":{\"name\":\"thread " << buffer.thread_ << "\"}}";
+        first = false;
+        // oldest first
+        for (uint64_t e = written - count; e < written; e++)
+        {
+            const ProfileEvent &event = buffer.events_[e % PROFILE_BUFFER_SIZE];
+            trace << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.thread_
+                  << ",\"ts\":" << event.start / 1000 << '.' << (event.start % 1000) / 100
+                  << ",\"dur\":" << event.duration / 1000 << '.' << (event.duration % 1000) / 100 << '}';
+        }
+    }
+    trace << "\n]}\n";
+    return trace.good();
+}
@@ -0,0 +1,109 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// events and their per thread buffers
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// events kept per thread, the oldest are overwritten first
+#define PROFILE_BUFFER_SIZE 65536
+
+// a timed scope, times in nanoseconds since the profiler started
+struct ProfileEvent
+{
+    const char* name;
+    int64_t start;
+    int64_t duration;
+};
+
+// ring buffer of the events of one thread, only that thread writes to it
+class ProfileBuffer
+{
+    public:
+    // constructor
+    ProfileBuffer(unsigned int thread);
+
+    void Push(const char* name, int64_t start, int64_t duration);
+
+    std::vector<ProfileEvent> events_;
+    // events pushed so far, event i lives at i % PROFILE_BUFFER_SIZE
+    std::atomic<uint64_t> written_;
+    // small id for the trace
+    unsigned int thread_;
+};
+
+// records the scopes timed with PROFILE_SCOPE while enabled, and writes them out in the Chrome trace_event
+// format (chrome://tracing or ui.perfetto.dev). Every thread gets its own buffer on its first event, so recording
+// takes no lock; reading and clearing the buffers must happen while no scope is being timed, between steps.
+class Profiler
+{
+    public:
+    // recording is off until enabled, a disabled scope costs one relaxed load
+    static bool Enabled();
+    static void SetEnabled(bool enabled);
+
+    // nanoseconds since the profiler started
+    static int64_t Now();
+    // adds an event to the calling thread's buffer
+    static void Record(const char* name, int64_t start, int64_t end);
+
+    // drops every recorded event
+    static void Clear();
+    // writes the recorded events as a trace_event JSON file, returns false when the file could not be opened
+    static bool WriteChromeTrace(const std::string &file);
+
+    private:
+    static ProfileBuffer* ThreadBuffer();
+
+    static std::atomic<bool> enabled_;
+    // every thread's buffer, they live as long as the program
+    static std::mutex mutex_;
+    static std::vector<ProfileBuffer*> buffers_;
+};
+
+// times the enclosing scope
+class ScopedTimer
+{
+    public:
+    // constructor, starts timing when the profiler is enabled or when there is a total to add the time to
+    ScopedTimer(const char* name, int64_t* total = NULL)
+    {
+        name_ = Profiler::Enabled() ? name : NULL;
+        total_ = total;
+        start_ = (name_ != NULL || total_ != NULL) ? Profiler::Now() : 0;
+    }
+    // destructor records the event and adds to the total
+    ~ScopedTimer()
+    {
+        if (name_ == NULL && total_ == NULL)
+            return;
+        int64_t end = Profiler::Now();
+        if (name_ != NULL)
+            Profiler::Record(name_, start_, end);
+        if (total_ != NULL)
+            *total_ += end - start_;
+    }
+
+    private:
+    const char* name_;
+    int64_t* total_;
+    int64_t start_;
+};
+
+// PROFILE_SCOPE("name") times the rest of the enclosing block, the name must be a string literal.
+// PROFILE_PHASE("name", total) also adds the nanoseconds to the int64_t total, whether recording or not.
+// Building with CLOTH_NO_PROFILE removes the timers altogether.
+#ifndef CLOTH_NO_PROFILE
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_JOIN(a, b)
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_NAME(profile_scope_, __LINE__)(name)
+#define PROFILE_PHASE(name, total) ScopedTimer PROFILE_NAME(profile_scope_, __LINE__)(name, &(total))
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_PHASE(name, total)
+#endif
+
+#endif // PROFILER_H
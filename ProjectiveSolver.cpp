@@ -0,0 +1,495 @@
+// class declaration
+#include "ProjectiveSolver.h"
+
+// the pool the local steps run on
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// number of springs or particles handed to a thread at a time
+#define PROJECTIVE_GRAIN 2048
+// parts of the spring graph no larger than this are not split any further by the nested dissection
+#define PROJECTIVE_LEAF 64
+
+// the particle at the other end of incidence entry i
+static unsigned int OtherEnd(const SpringTable &springs, unsigned int i)
+{
+    unsigned int s = springs.incidence_[i] >> 1;
+    return (springs.incidence_[i] & 1) ? springs.right_[s] : springs.left_[s];
+}
+
+// constructor
+ProjectiveSolver::ProjectiveSolver()
+{
+    iterations_ = PROJECTIVE_ITERATIONS;
+    factorisations_ = 0;
+    rows_ = 0;
+    factored_ = false;
+    factor_h_ = 0.0f;
+}
+
+// destructor
+ProjectiveSolver::~ProjectiveSolver()
+{
+    // arrays release themselves
+}
+
+void ProjectiveSolver::Clear()
+{
+    Build(SpringTable(), 0);
+}
+
+void ProjectiveSolver::Invalidate()
+{
+    factored_ = false;
+}
+
+void ProjectiveSolver::Build(const SpringTable &springs, unsigned int particle_count)
+{
+    rows_ = particle_count;
+    factored_ = false;
+    Order(springs);
+
+    // the springs by column of the upper triangle, a counting sort on the end numbered higher
+    column_offsets_.assign(rows_ + 1, 0);
+    for (unsigned int s = 0; s < springs.Size(); s++)
+        if (springs.left_[s] != springs.right_[s])
+            column_offsets_[std::max(rank_[springs.left_[s]], rank_[springs.right_[s]]) + 1]++;
+    for (unsigned int j = 0; j < rows_; j++)
+        column_offsets_[j + 1] += column_offsets_[j];
+    column_springs_.resize(column_offsets_[rows_]);
+    next_.assign(column_offsets_.begin(), column_offsets_.end() - (rows_ > 0 ? 1 : 0));
+    for (unsigned int s = 0; s < springs.Size(); s++)
+        if (springs.left_[s] != springs.right_[s])
+            column_springs_[next_[std::max(rank_[springs.left_[s]], rank_[springs.right_[s]])]++] = s;
+
+    // elimination tree, the parent of column i is the first row below it the factor has an entry in, found by
+    // walking up from every entry of the matrix with path compression
+    parent_.assign(rows_, rows_);
+    std::vector<unsigned int> ancestor(rows_, rows_);
+    for (unsigned int k = 0; k < rows_; k++)
+        for (unsigned int e = column_offsets_[k]; e < column_offsets_[k + 1]; e++)
+        {
+            unsigned int s = column_springs_[e];
+            unsigned int i = std::min(rank_[springs.left_[s]], rank_[springs.right_[s]]);
+            while (i != rows_ && i < k)
+            {
+                unsigned int up = ancestor[i];
+                ancestor[i] = k;
+                if (up == rows_)
+                    parent_[i] = k;
+                i = up;
+            }
+        }
+
+    // the entries of every column of the factor, counted from the pattern of every row
+    work_.assign(rows_, 0.0);
+    pattern_.resize(rows_);
+    marks_.assign(rows_, rows_);
+    std::vector<unsigned int> counts(rows_, 1);
+    for (unsigned int k = 0; k < rows_; k++)
+        for (unsigned int t = RowPattern(springs, k); t < rows_; t++)
+            counts[pattern_[t]]++;
+    factor_offsets_.resize(rows_ + 1);
+    factor_offsets_[0] = 0;
+    for (unsigned int j = 0; j < rows_; j++)
+        factor_offsets_[j + 1] = factor_offsets_[j] + counts[j];
+    factor_rows_.assign(factor_offsets_[rows_], 0);
+    factor_.assign(factor_offsets_[rows_], 0.0);
+    pinned_.assign(rows_, 0);
+
+    prev_x_.assign(rows_, 0.0f);
+    prev_y_.assign(rows_, 0.0f);
+    prev_z_.assign(rows_, 0.0f);
+    inertia_x_.assign(rows_, 0.0f);
+    inertia_y_.assign(rows_, 0.0f);
+    inertia_z_.assign(rows_, 0.0f);
+    target_x_.assign(springs.Size(), 0.0f);
+    target_y_.assign(springs.Size(), 0.0f);
+    target_z_.assign(springs.Size(), 0.0f);
+    rhs_.assign(3 * rows_, 0.0);
+}
+
+void ProjectiveSolver::Order(const SpringTable &springs)
+{
+    // every part of the graph owns the same slots of members and of the new numbering. A part is split by the middle
+    // level of a breadth first search from a far away particle: the levels before it and after it never share a
+    // spring, so they are ordered on their own and the separating level takes the last numbers of the part
+    order_.resize(rows_);
+    rank_.resize(rows_);
+    std::vector<unsigned int> members(rows_);
+    std::vector<unsigned int> part(rows_, 0);
+    std::vector<unsigned int> level(rows_, 0);
+    std::vector<unsigned int> queue(rows_);
+    std::vector<unsigned int> buffer(rows_);
+    std::vector<unsigned char> side(rows_, 0);
+    std::vector<unsigned int> widths;
+    for (unsigned int p = 0; p < rows_; p++)
+        members[p] = p;
+
+    // the slots [first, second) are a part still to be ordered
+    std::vector<std::pair<unsigned int, unsigned int> > parts;
+    if (rows_ > 0)
+        parts.push_back(std::make_pair(0u, rows_));
+    unsigned int part_count = 1;
+    // a separator belongs to no part any more
+    const unsigned int kNumbered = ~0u;
+
+    while (!parts.empty())
+    {
+        unsigned int begin = parts.back().first;
+        unsigned int end = parts.back().second;
+        parts.pop_back();
+        unsigned int size = end - begin;
+        if (size <= PROJECTIVE_LEAF)
+        {
+            for (unsigned int r = begin; r < end; r++)
+                order_[r] = members[r];
+            continue;
+        }
+        unsigned int id = part[members[begin]];
+
+        // breadth first searches within the part, from its first particle then twice from the last one reached,
+        // which ends up far from everything
+        unsigned int reached = 0;
+        unsigned int start = members[begin];
+        for (unsigned int pass = 0; pass < 3; pass++)
+        {
+            queue[0] = start;
+            level[start] = 0;
+            reached = 1;
+            part[start] = kNumbered;
+            for (unsigned int head = 0; head < reached; head++)
+            {
+                unsigned int p = queue[head];
+                for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+                {
+                    unsigned int other = OtherEnd(springs, i);
+                    if (part[other] == id)
+                    {
+                        part[other] = kNumbered;
+                        level[other] = level[p] + 1;
+                        queue[reached++] = other;
+                    }
+                }
+            }
+            for (unsigned int q = 0; q < reached; q++)
+                part[queue[q]] = id;
+            if (reached < size)
+                break;
+            start = queue[reached - 1];
+        }
+
+        // side 0 and 1 are the two halves, 2 the separator. A part in several pieces is split between the piece
+        // reached and the rest, nothing separates them
+        for (unsigned int r = begin; r < end; r++)
+            side[members[r]] = 1;
+        if (reached < size)
+        {
+            for (unsigned int q = 0; q < reached; q++)
+                side[queue[q]] = 0;
+        }
+        else
+        {
+            // the level holding the middle particle of the search
+            unsigned int levels = level[queue[reached - 1]] + 1;
+            widths.assign(levels, 0);
+            for (unsigned int q = 0; q < reached; q++)
+                widths[level[queue[q]]]++;
+            unsigned int separator = 0;
+            for (unsigned int below = widths[0]; below <= size / 2 && separator + 1 < levels; below += widths[separator])
+                separator++;
+            for (unsigned int q = 0; q < reached; q++)
+                side[queue[q]] = level[queue[q]] < separator ? 0 : (level[queue[q]] == separator ? 2 : 1);
+            // a part too tightly knit to be split keeps its order
+            if (separator == 0 || separator + 1 == levels)
+            {
+                for (unsigned int r = begin; r < end; r++)
+                    order_[r] = members[r];
+                continue;
+            }
+        }
+
+        // the two halves then the separator, keeping their order
+        unsigned int slot = begin;
+        for (unsigned char which = 0; which < 3; which++)
+            for (unsigned int r = begin; r < end; r++)
+                if (side[members[r]] == which)
+                    buffer[slot++] = members[r];
+        std::copy(buffer.begin() + begin, buffer.begin() + end, members.begin() + begin);
+        unsigned int middle = begin, separator = begin;
+        unsigned int first_id = part_count++, second_id = part_count++;
+        for (unsigned int r = begin; r < end; r++)
+        {
+            unsigned int p = members[r];
+            if (side[p] == 0)
+            {
+                part[p] = first_id;
+                middle++;
+                separator++;
+            }
+            else if (side[p] == 1)
+            {
+                part[p] = second_id;
+                separator++;
+            }
+            else
+            {
+                part[p] = kNumbered;
+                order_[r] = p;
+            }
+        }
+        parts.push_back(std::make_pair(middle, separator));
+        parts.push_back(std::make_pair(begin, middle));
+    }
+
+    for (unsigned int i = 0; i < rows_; i++)
+        rank_[order_[i]] = i;
+}
+unsigned int ProjectiveSolver::RowPattern(const SpringTable &springs, unsigned int k)
+{
+    // every entry (i, k) of the matrix above the diagonal fills row k of the factor at i and at the ancestors of i in
+    // the elimination tree up to k, a path is stopped by the first particle already on the row. The paths are
+    // stacked from the end so every column comes after the ones it depends on
+    unsigned int top = rows_;
+    marks_[k] = k;
+    for (unsigned int e = column_offsets_[k]; e < column_offsets_[k + 1]; e++)
+    {
+        unsigned int s = column_springs_[e];
+        unsigned int i = std::min(rank_[springs.left_[s]], rank_[springs.right_[s]]);
+        unsigned int length = 0;
+        for (; marks_[i] != k; i = parent_[i])
+        {
+            pattern_[length++] = i;
+            marks_[i] = k;
+        }
+        while (length > 0)
+            pattern_[--top] = pattern_[--length];
+    }
+    return top;
+}
+
+bool ProjectiveSolver::PinsChanged(const ParticleSystem &particles) const
+{
+    for (unsigned int p = 0; p < rows_; p++)
+        if (pinned_[p] != ((particles.flags_[p] & ParticleSystem::kPinned) != 0))
+            return true;
+    return false;
+}
+
+void ProjectiveSolver::Factor(const ParticleSystem &particles, const SpringTable &springs, float h)
+{
+    // the diagonal of M / h^2 + L + D / h in the new numbering, a pinned particle is a row and column of the identity
+    double inv_h2 = 1.0 / ((double)h * h);
+    double inv_h = 1.0 / h;
+    for (unsigned int p = 0; p < rows_; p++)
+    {
+        pinned_[p] = (particles.flags_[p] & ParticleSystem::kPinned) != 0;
+        work_[rank_[p]] = pinned_[p] ? 1.0 : particles.Mass(p) * inv_h2;
+    }
+    for (unsigned int s = 0; s < springs.Size(); s++)
+    {
+        double weight = springs.k_[s] + springs.d_[s] * inv_h;
+        if (!pinned_[springs.left_[s]])
+            work_[rank_[springs.left_[s]]] += weight;
+        if (!pinned_[springs.right_[s]])
+            work_[rank_[springs.right_[s]]] += weight;
+    }
+    std::vector<double> diagonal(work_);
+    std::fill(work_.begin(), work_.end(), 0.0);
+    std::fill(marks_.begin(), marks_.end(), rows_);
+
+    // up looking Cholesky, row k of L solves L(0:k, 0:k) l = A(0:k, k) over the columns of its pattern only:
+    // L_kj = (A_jk - sum_i L_ji L_ki) / L_jj, then L_kk = sqrt(A_kk - sum_j L_kj^2)
+    for (unsigned int k = 0; k < rows_; k++)
+    {
+        // scatter column k of the upper triangle
+        for (unsigned int e = column_offsets_[k]; e < column_offsets_[k + 1]; e++)
+        {
+            unsigned int s = column_springs_[e];
+            unsigned int left = springs.left_[s];
+            unsigned int right = springs.right_[s];
+            if (!pinned_[left] && !pinned_[right])
+                work_[std::min(rank_[left], rank_[right])] -= springs.k_[s] + springs.d_[s] * inv_h;
+        }
+        double d = diagonal[k];
+        for (unsigned int t = RowPattern(springs, k); t < rows_; t++)
+        {
+            unsigned int j = pattern_[t];
+            double l = work_[j] / factor_[factor_offsets_[j]];
+            work_[j] = 0.0;
+            for (unsigned int e = factor_offsets_[j] + 1; e < next_[j]; e++)
+                work_[factor_rows_[e]] -= factor_[e] * l;
+            d -= l * l;
+            unsigned int e = next_[j]++;
+            factor_rows_[e] = k;
+            factor_[e] = l;
+        }
+        factor_rows_[factor_offsets_[k]] = k;
+        factor_[factor_offsets_[k]] = std::sqrt(d);
+        next_[k] = factor_offsets_[k] + 1;
+    }
+
+    factored_ = true;
+    factor_h_ = h;
+    factorisations_++;
+}
+
+void ProjectiveSolver::Substitute()
+{
+    // forward, L z = b, column by column
+    for (unsigned int j = 0; j < rows_; j++)
+    {
+        double diagonal = factor_[factor_offsets_[j]];
+        double x = rhs_[3 * j] / diagonal, y = rhs_[3 * j + 1] / diagonal, z = rhs_[3 * j + 2] / diagonal;
+        rhs_[3 * j] = x;
+        rhs_[3 * j + 1] = y;
+        rhs_[3 * j + 2] = z;
+        for (unsigned int e = factor_offsets_[j] + 1; e < factor_offsets_[j + 1]; e++)
+        {
+            double* pending = &rhs_[3 * factor_rows_[e]];
+            pending[0] -= factor_[e] * x;
+            pending[1] -= factor_[e] * y;
+            pending[2] -= factor_[e] * z;
+        }
+    }
+
+    // backward, L^T x = z, a row of L^T is a column of L
+    for (unsigned int j = rows_; j-- > 0; )
+    {
+        double x = rhs_[3 * j], y = rhs_[3 * j + 1], z = rhs_[3 * j + 2];
+        for (unsigned int e = factor_offsets_[j] + 1; e < factor_offsets_[j + 1]; e++)
+        {
+            const double* solved = &rhs_[3 * factor_rows_[e]];
+            x -= factor_[e] * solved[0];
+            y -= factor_[e] * solved[1];
+            z -= factor_[e] * solved[2];
+        }
+        double diagonal = factor_[factor_offsets_[j]];
+        rhs_[3 * j] = x / diagonal;
+        rhs_[3 * j + 1] = y / diagonal;
+        rhs_[3 * j + 2] = z / diagonal;
+    }
+}
+
+void ProjectiveSolver::Step(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool)
+{
+    if (rows_ == 0)
+        return;
+    if (!factored_ || factor_h_ != h || PinsChanged(particles))
+        Factor(particles, springs, h);
+
+    // inertial positions y = x + h v + h^2 f / m, also the first guess
+    ThreadPool::RunRange(pool, 0, rows_, PROJECTIVE_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            float step = particles.inv_mass_[p] * h * h;
+            prev_x_[p] = particles.pos_x_[p];
+            prev_y_[p] = particles.pos_y_[p];
+            prev_z_[p] = particles.pos_z_[p];
+            inertia_x_[p] = particles.pos_x_[p] + h * particles.vel_x_[p] + step * particles.force_x_[p];
+            inertia_y_[p] = particles.pos_y_[p] + h * particles.vel_y_[p] + step * particles.force_y_[p];
+            inertia_z_[p] = particles.pos_z_[p] + h * particles.vel_z_[p] + step * particles.force_z_[p];
+            if (!pinned_[p])
+            {
+                particles.pos_x_[p] = inertia_x_[p];
+                particles.pos_y_[p] = inertia_y_[p];
+                particles.pos_z_[p] = inertia_z_[p];
+            }
+        }
+    });
+
+    float inv_h2 = 1.0f / (h * h);
+    float inv_h = 1.0f / h;
+    for (unsigned int iteration = 0; iteration < iterations_; iteration++)
+    {
+        // local step, every spring on its own
+        ThreadPool::RunRange(pool, 0, springs.Size(), PROJECTIVE_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int s = first; s < last; s++)
+            {
+                unsigned int left = springs.left_[s];
+                unsigned int right = springs.right_[s];
+                float dx = particles.pos_x_[right] - particles.pos_x_[left];
+                float dy = particles.pos_y_[right] - particles.pos_y_[left];
+                float dz = particles.pos_z_[right] - particles.pos_z_[left];
+                float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+                float scale = length > 0.0f ? springs.rest_[s] / length : 0.0f;
+                target_x_[s] = dx * scale;
+                target_y_[s] = dy * scale;
+                target_z_[s] = dz * scale;
+            }
+        });
+
+        // right hand side, gathered per particle through the incidence lists
+        ThreadPool::RunRange(pool, 0, rows_, PROJECTIVE_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int p = first; p < last; p++)
+            {
+                double* rhs = &rhs_[3 * rank_[p]];
+                if (pinned_[p])
+                {
+                    rhs[0] = particles.pos_x_[p];
+                    rhs[1] = particles.pos_y_[p];
+                    rhs[2] = particles.pos_z_[p];
+                    continue;
+                }
+                float mass = particles.Mass(p) * inv_h2;
+                double x = mass * inertia_x_[p], y = mass * inertia_y_[p], z = mass * inertia_z_[p];
+                for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+                {
+                    unsigned int s = springs.incidence_[i] >> 1;
+                    float k = springs.k_[s];
+                    float damping = springs.d_[s] * inv_h;
+                    // the right end is pushed along d, the left end against it
+                    float sign = (springs.incidence_[i] & 1) ? -k : k;
+                    x += sign * target_x_[s];
+                    y += sign * target_y_[s];
+                    z += sign * target_z_[s];
+                    // the damping holds the ends where they were relative to each other at the start of the step
+                    unsigned int other = OtherEnd(springs, i);
+                    x += damping * (prev_x_[p] - prev_x_[other]);
+                    y += damping * (prev_y_[p] - prev_y_[other]);
+                    z += damping * (prev_z_[p] - prev_z_[other]);
+                    // a pinned neighbour is known, its column moves to the right hand side
+                    if (pinned_[other])
+                    {
+                        x += (k + damping) * particles.pos_x_[other];
+                        y += (k + damping) * particles.pos_y_[other];
+                        z += (k + damping) * particles.pos_z_[other];
+                    }
+                }
+                rhs[0] = x;
+                rhs[1] = y;
+                rhs[2] = z;
+            }
+        });
+
+        // global step
+        Substitute();
+
+        ThreadPool::RunRange(pool, 0, rows_, PROJECTIVE_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int p = first; p < last; p++)
+            {
+                const double* solution = &rhs_[3 * rank_[p]];
+                particles.pos_x_[p] = solution[0];
+                particles.pos_y_[p] = solution[1];
+                particles.pos_z_[p] = solution[2];
+            }
+        });
+    }
+
+    // velocities from the distance travelled
+    ThreadPool::RunRange(pool, 0, rows_, PROJECTIVE_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            particles.vel_x_[p] = (particles.pos_x_[p] - prev_x_[p]) * inv_h;
+            particles.vel_y_[p] = (particles.pos_y_[p] - prev_y_[p]) * inv_h;
+            particles.vel_z_[p] = (particles.pos_z_[p] - prev_z_[p]) * inv_h;
+        }
+    });
+}
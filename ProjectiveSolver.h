@@ -0,0 +1,108 @@
+#ifndef PROJECTIVE_SOLVER_H
+#define PROJECTIVE_SOLVER_H
+
+// the particles and springs of the cloth
+#include "ParticleSystem.h"
+#include "Spring.h"
+
+#include <vector>
+
+// default number of local/global iterations per step
+#define PROJECTIVE_ITERATIONS 10
+
+// pool the local steps are spread over
+class ThreadPool;
+
+// projective dynamics for a mass spring system (Liu et al., Fast Simulation of Mass-Spring Systems, and
+// Bouaziz et al., Projective Dynamics). Every step alternates
+//      local:  each spring picks the closest vector of its rest length, d = rest (x_r - x_l) / |x_r - x_l|
+//      global: (M / h^2 + L + D / h) x = M / h^2 y + J d + D / h x0, where y is the inertial position, x0 the
+//              position at the start of the step, L the stiffness weighted and D the damping weighted graph
+//              Laplacian of the springs
+// The damping term is implicit damping of the relative velocity of the spring ends, in every direction rather than
+// only along the spring as the force based integrators do. The global matrix does not depend on the state, and is
+// the same for x, y and z, so it is an n x n scalar matrix factored once with a sparse Cholesky decomposition. The
+// particles are renumbered by nested dissection (level set separators of the spring graph numbered after the two
+// halves they split) to keep the fill of the factor low, which on a grid of n particles is about n log n entries.
+// Every global step is then a forward and back substitution. The factor only has to be redone when the springs, the
+// pins, the masses, the stiffness, the damping or the step change; a change of pins is detected, the others call
+// Invalidate.
+class ProjectiveSolver
+{
+    public:
+    // constructor
+    ProjectiveSolver();
+    // destructor
+    ~ProjectiveSolver();
+
+    // orders the particles and lays out the factor from the spring incidence lists, needed again whenever the
+    // springs change
+    void Build(const SpringTable &springs, unsigned int particle_count);
+    void Clear();
+
+    // assembles and factors the global matrix for steps of h seconds
+    void Factor(const ParticleSystem &particles, const SpringTable &springs, float h);
+    // marks the factor as out of date, the next step refactors
+    void Invalidate();
+
+    // one step of h seconds from the external forces in the particles, updates positions and velocities
+    void Step(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool);
+
+    // local/global iterations per step
+    unsigned int iterations_;
+    // number of factorisations so far
+    unsigned int factorisations_;
+
+    private:
+    // solves L L^T x = b in place on rhs_ (new numbering, three right hand sides)
+    void Substitute();
+    // true when the pins differ from the ones the factor was built with
+    bool PinsChanged(const ParticleSystem &particles) const;
+    // nested dissection order of the particles from the spring incidence lists
+    void Order(const SpringTable &springs);
+    // the columns j < k of the factor's row k, in pattern_[top .. rows_), returns top
+    unsigned int RowPattern(const SpringTable &springs, unsigned int k);
+
+    unsigned int rows_;
+    // nested dissection order, order_[new] = old and rank_[old] = new
+    std::vector<unsigned int> order_;
+    std::vector<unsigned int> rank_;
+
+    // the springs off the diagonal of the global matrix by column of its upper triangle (the end numbered higher),
+    // column j holds column_springs_[column_offsets_[j] .. [j + 1])
+    std::vector<unsigned int> column_offsets_;
+    std::vector<unsigned int> column_springs_;
+    // elimination tree of the factor, rows_ for a root
+    std::vector<unsigned int> parent_;
+    // lower triangular factor by columns, column j holds rows factor_rows_ and values factor_ from factor_offsets_[j]
+    // to [j + 1], the diagonal first
+    std::vector<unsigned int> factor_offsets_;
+    std::vector<unsigned int> factor_rows_;
+    std::vector<double> factor_;
+    bool factored_;
+    float factor_h_;
+    // work space of the factorisation: a row of the matrix, the next free entry of every column, row patterns and
+    // the marks of the current row
+    std::vector<double> work_;
+    std::vector<unsigned int> next_;
+    std::vector<unsigned int> pattern_;
+    std::vector<unsigned int> marks_;
+    // pinned particles the factor was built with
+    std::vector<unsigned char> pinned_;
+
+    // positions at the start of the step and inertial positions y
+    AlignedVector<float> prev_x_;
+    AlignedVector<float> prev_y_;
+    AlignedVector<float> prev_z_;
+    AlignedVector<float> inertia_x_;
+    AlignedVector<float> inertia_y_;
+    AlignedVector<float> inertia_z_;
+    // projected spring vectors d from the local step
+    AlignedVector<float> target_x_;
+    AlignedVector<float> target_y_;
+    AlignedVector<float> target_z_;
+    // right hand sides then solutions of the global step, xyz per row in the new numbering
+    std::vector<double> rhs_;
+};
+
+#endif // PROJECTIVE_SOLVER_H
@@ -0,0 +1,350 @@
+// class declaration
+#include "SelfCollision.h"
+
+// the passes run on the worker threads
+#include "ThreadPool.h"
+
+// std::sort, std::binary_search, std::max
+#include <algorithm>
+// std::sqrt, std::fabs
+#include <cmath>
+
+// particles handed to a thread at a time, every one of them searches 16 buckets
+#define COLLISION_GRAIN 512
+// closer than this a pair has no direction to be pushed along, and a triangle no normal
+#define COLLISION_EPSILON 1e-12f
+
+// constructor
+SelfCollision::SelfCollision()
+{
+    // off unless asked for, it costs more than the rest of an explicit step on a large cloth
+    enabled_ = false;
+    triangles_enabled_ = false;
+    thickness_scale_ = SELF_COLLISION_THICKNESS;
+    lookahead_ = SELF_COLLISION_LOOKAHEAD;
+    cell_limit_ = SELF_COLLISION_CELL_LIMIT;
+    particle_count_ = 0;
+    rest_edge_ = 0.0f;
+    step_ = 0.0f;
+    reach_ = 0.0f;
+}
+
+// destructor
+SelfCollision::~SelfCollision()
+{
+
+}
+
+float SelfCollision::Thickness() const
+{
+    return thickness_scale_ * rest_edge_;
+}
+
+void SelfCollision::Clear()
+{
+    Build(SpringTable(), std::vector<ObjTriangle>(), std::vector<glm::vec3>(), 0);
+}
+
+void SelfCollision::Build(const SpringTable &springs, const std::vector<ObjTriangle> &triangles,
+                          const std::vector<glm::vec3> &rest_positions, unsigned int particle_count)
+{
+    particle_count_ = std::min(particle_count, (unsigned int)rest_positions.size());
+    rest_x_.resize(particle_count_);
+    rest_y_.resize(particle_count_);
+    rest_z_.resize(particle_count_);
+    for (unsigned int p = 0; p < particle_count_; p++)
+    {
+        rest_x_[p] = rest_positions[p].x;
+        rest_y_[p] = rest_positions[p].y;
+        rest_z_[p] = rest_positions[p].z;
+    }
+
+    // both ends of every spring, counting sorted by particle then every particle's list sorted
+    neighbour_offsets_.assign(particle_count_ + 1, 0);
+    unsigned int spring_count = 0;
+    for (unsigned int s = 0; s < springs.Size(); s++)
+        if (springs.left_[s] < particle_count_ && springs.right_[s] < particle_count_)
+        {
+            neighbour_offsets_[springs.left_[s] + 1]++;
+            neighbour_offsets_[springs.right_[s] + 1]++;
+            spring_count++;
+        }
+    for (unsigned int p = 0; p < particle_count_; p++)
+        neighbour_offsets_[p + 1] += neighbour_offsets_[p];
+    neighbours_.resize(2 * spring_count);
+    std::vector<unsigned int> slot(neighbour_offsets_.begin(), neighbour_offsets_.end() - 1);
+    for (unsigned int s = 0; s < springs.Size(); s++)
+        if (springs.left_[s] < particle_count_ && springs.right_[s] < particle_count_)
+        {
+            neighbours_[slot[springs.left_[s]]++] = springs.right_[s];
+            neighbours_[slot[springs.right_[s]]++] = springs.left_[s];
+        }
+    for (unsigned int p = 0; p < particle_count_; p++)
+        std::sort(neighbours_.begin() + neighbour_offsets_[p], neighbours_.begin() + neighbour_offsets_[p + 1]);
+
+    // the thickness follows the size of the triangles, or of the springs for a cloth without any
+    triangles_.clear();
+    triangles_.reserve(3 * triangles.size());
+    double edges = 0.0;
+    unsigned int edge_count = 0;
+    for (size_t t = 0; t < triangles.size(); t++)
+    {
+        const unsigned int* v = triangles[t].positions;
+        if (v[0] >= particle_count_ || v[1] >= particle_count_ || v[2] >= particle_count_
+            || v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+            continue;
+        triangles_.insert(triangles_.end(), v, v + 3);
+        for (unsigned int i = 0; i < 3; i++)
+            edges += glm::distance(rest_positions[v[i]], rest_positions[v[(i + 1) % 3]]);
+        edge_count += 3;
+    }
+    if (edge_count == 0)
+        for (unsigned int s = 0; s < springs.Size(); s++)
+        {
+            edges += springs.rest_[s];
+            edge_count++;
+        }
+    rest_edge_ = edge_count > 0 ? (float)(edges / edge_count) : 0.0f;
+
+    unsigned int triangle_count = triangles_.size() / 3;
+    centre_x_.resize(triangle_count);
+    centre_y_.resize(triangle_count);
+    centre_z_.resize(triangle_count);
+    radius_.resize(triangle_count);
+    correction_x_.resize(particle_count_);
+    correction_y_.resize(particle_count_);
+    correction_z_.resize(particle_count_);
+    velocity_x_.resize(particle_count_);
+    velocity_y_.resize(particle_count_);
+    velocity_z_.resize(particle_count_);
+    if (particle_count_ == 0)
+    {
+        particle_hash_.Clear();
+        triangle_hash_.Clear();
+    }
+}
+
+// a particle held by a collidable would be put back where it is (and held there by the implicit integrators), it does
+// not give way
+static inline float Weight(const ParticleSystem &particles, unsigned int p)
+{
+    return particles.flags_[p] & ParticleSystem::kContact ? 0.0f : particles.inv_mass_[p];
+}
+
+bool SelfCollision::Separate(unsigned int a, unsigned int b) const
+{
+    if (a == b)
+        return false;
+    float dx = rest_x_[a] - rest_x_[b], dy = rest_y_[a] - rest_y_[b], dz = rest_z_[a] - rest_z_[b];
+    float thickness = Thickness();
+    if (dx * dx + dy * dy + dz * dz < thickness * thickness)
+        return false;
+    return !std::binary_search(neighbours_.begin() + neighbour_offsets_[a],
+                               neighbours_.begin() + neighbour_offsets_[a + 1], b);
+}
+
+bool SelfCollision::Respond(float distance, const glm::vec3 &normal, const glm::vec3 &relative_velocity, float share,
+                            glm::vec3 &correction, glm::vec3 &velocity_change) const
+{
+    float thickness = Thickness();
+    float approach = glm::dot(relative_velocity, normal);
+    // too close: back out to the thickness, and no closer
+    if (distance < thickness)
+    {
+        correction += (thickness - distance) * share * normal;
+        if (approach < 0.0f)
+            velocity_change -= approach * share * normal;
+        return true;
+    }
+    // closing in too fast: just reaching the thickness by the end of the step
+    if (distance + approach * step_ < thickness)
+    {
+        velocity_change += ((thickness - distance) / step_ - approach) * share * normal;
+        return true;
+    }
+    return false;
+}
+
+unsigned int SelfCollision::CollideParticle(const ParticleSystem &particles, unsigned int p, glm::vec3 &correction,
+                                            glm::vec3 &velocity_change) const
+{
+    glm::vec3 position = particles.Position(p);
+    glm::vec3 velocity = particles.Velocity(p);
+    float weight = particles.inv_mass_[p];
+
+    unsigned int buckets[8];
+    unsigned int bucket_count = particle_hash_.Around(position.x, position.y, position.z, buckets);
+    unsigned int contacts = 0;
+    for (unsigned int b = 0; b < bucket_count; b++)
+    {
+        unsigned int first = particle_hash_.offsets_[buckets[b]];
+        unsigned int last = std::min(particle_hash_.offsets_[buckets[b] + 1], first + cell_limit_);
+        for (unsigned int e = first; e < last; e++)
+        {
+            unsigned int other = particle_hash_.entries_[e];
+            glm::vec3 offset = position - particles.Position(other);
+            float distance2 = glm::dot(offset, offset);
+            if (distance2 >= reach_ * reach_ || distance2 < COLLISION_EPSILON || !Separate(p, other))
+                continue;
+            // the particles share the response by their inverse masses, each moves itself
+            float distance = std::sqrt(distance2);
+            float share = weight / (weight + Weight(particles, other));
+            if (Respond(distance, offset / distance, velocity - particles.Velocity(other), share, correction,
+                        velocity_change))
+                contacts++;
+        }
+    }
+    return contacts;
+}
+
+unsigned int SelfCollision::CollideTriangles(const ParticleSystem &particles, unsigned int p, glm::vec3 &correction,
+                                             glm::vec3 &velocity_change) const
+{
+    glm::vec3 position = particles.Position(p);
+    glm::vec3 velocity = particles.Velocity(p);
+    float weight = particles.inv_mass_[p];
+
+    unsigned int buckets[8];
+    unsigned int bucket_count = triangle_hash_.Around(position.x, position.y, position.z, buckets);
+    unsigned int contacts = 0;
+    for (unsigned int b = 0; b < bucket_count; b++)
+    {
+        unsigned int first = triangle_hash_.offsets_[buckets[b]];
+        unsigned int last = std::min(triangle_hash_.offsets_[buckets[b] + 1], first + cell_limit_);
+        for (unsigned int e = first; e < last; e++)
+        {
+            unsigned int t = triangle_hash_.entries_[e];
+            glm::vec3 centre(centre_x_[t], centre_y_[t], centre_z_[t]);
+            float reach = radius_[t] + reach_;
+            if (glm::dot(position - centre, position - centre) >= reach * reach)
+                continue;
+            const unsigned int* v = &triangles_[3 * t];
+            if (!Separate(p, v[0]) || !Separate(p, v[1]) || !Separate(p, v[2]))
+                continue;
+
+            // distance to the plane of the triangle
+            glm::vec3 a = particles.Position(v[0]);
+            glm::vec3 edge_1 = particles.Position(v[1]) - a;
+            glm::vec3 edge_2 = particles.Position(v[2]) - a;
+            glm::vec3 normal = glm::cross(edge_1, edge_2);
+            float area2 = glm::dot(normal, normal);
+            if (area2 < COLLISION_EPSILON)
+                continue;
+            normal /= std::sqrt(area2);
+            glm::vec3 offset = position - a;
+            float height = glm::dot(offset, normal);
+            if (std::fabs(height) >= reach_)
+                continue;
+            // only over the inside of the triangle, its edges and corners are left to the particles
+            float d11 = glm::dot(edge_1, edge_1), d12 = glm::dot(edge_1, edge_2), d22 = glm::dot(edge_2, edge_2);
+            float o1 = glm::dot(offset, edge_1), o2 = glm::dot(offset, edge_2);
+            float denominator = d11 * d22 - d12 * d12;
+            float u = (d22 * o1 - d12 * o2) / denominator;
+            float w = (d11 * o2 - d12 * o1) / denominator;
+            if (u < 0.0f || w < 0.0f || u + w > 1.0f)
+                continue;
+
+            // the triangle as a particle at the projected point, the particle goes back out on its side
+            float bary[3] = { 1.0f - u - w, u, w };
+            float triangle_weight = 0.0f;
+            glm::vec3 triangle_velocity(0.0f);
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                triangle_weight += bary[i] * Weight(particles, v[i]);
+                triangle_velocity += bary[i] * particles.Velocity(v[i]);
+            }
+            if (height < 0.0f)
+            {
+                normal = -normal;
+                height = -height;
+            }
+            float share = weight / (weight + triangle_weight);
+            if (Respond(height, normal, velocity - triangle_velocity, share, correction, velocity_change))
+                contacts++;
+        }
+    }
+    return contacts;
+}
+
+void SelfCollision::Resolve(ParticleSystem &particles, float h, ThreadPool* pool, bool triangles)
+{
+    unsigned int n = particles.Size();
+    if (!enabled_ || n == 0 || n != particle_count_ || Thickness() <= 0.0f || h <= 0.0f)
+        return;
+
+    // step 1 how far the particles can get to each other within the step, two of them at the top speed head on
+    float speed2 = 0.0f;
+    for (unsigned int p = 0; p < n; p++)
+        speed2 = std::max(speed2, particles.vel_x_[p] * particles.vel_x_[p] + particles.vel_y_[p] * particles.vel_y_[p]
+                                  + particles.vel_z_[p] * particles.vel_z_[p]);
+    step_ = h;
+    reach_ = Thickness() + std::min(2.0f * std::sqrt(speed2) * h, lookahead_ * Thickness());
+
+    // step 2 the particles in cells twice that wide, so all the particles within reach are in the 8 cells around a
+    // particle
+    particle_hash_.Build(particles.pos_x_.data(), particles.pos_y_.data(), particles.pos_z_.data(), n,
+                         2.0f * reach_, pool);
+
+    // step 3 the triangle centres in cells wide enough for a particle within reach of a triangle to find its centre
+    unsigned int triangle_count = triangles_enabled_ || triangles ? centre_x_.size() : 0;
+    if (triangle_count > 0)
+    {
+        ThreadPool::RunRange(pool, 0, triangle_count, COLLISION_GRAIN,
+                             [this, &particles] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int t = first; t < last; t++)
+            {
+                const unsigned int* v = &triangles_[3 * t];
+                glm::vec3 corners[3] = { particles.Position(v[0]), particles.Position(v[1]), particles.Position(v[2]) };
+                glm::vec3 centre = (corners[0] + corners[1] + corners[2]) / 3.0f;
+                centre_x_[t] = centre.x;
+                centre_y_[t] = centre.y;
+                centre_z_[t] = centre.z;
+                radius_[t] = std::max(glm::distance(centre, corners[0]),
+                                      std::max(glm::distance(centre, corners[1]), glm::distance(centre, corners[2])));
+            }
+        });
+        float radius = *std::max_element(radius_.begin(), radius_.end());
+        triangle_hash_.Build(centre_x_.data(), centre_y_.data(), centre_z_.data(), triangle_count,
+                             2.0f * (radius + reach_), pool);
+    }
+
+    // step 4 the corrections of every particle from the positions as they are
+    ThreadPool::RunRange(pool, 0, n, COLLISION_GRAIN,
+                         [this, &particles, triangle_count] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            glm::vec3 correction(0.0f), velocity_change(0.0f);
+            unsigned int contacts = 0;
+            // pinned and held particles stay put
+            if (Weight(particles, p) > 0.0f)
+            {
+                contacts = CollideParticle(particles, p, correction, velocity_change);
+                if (triangle_count > 0)
+                    contacts += CollideTriangles(particles, p, correction, velocity_change);
+            }
+            float scale = contacts > 0 ? 1.0f / contacts : 0.0f;
+            correction_x_[p] = correction.x * scale;
+            correction_y_[p] = correction.y * scale;
+            correction_z_[p] = correction.z * scale;
+            velocity_x_[p] = velocity_change.x * scale;
+            velocity_y_[p] = velocity_change.y * scale;
+            velocity_z_[p] = velocity_change.z * scale;
+        }
+    });
+
+    // step 5 applied
+    ThreadPool::RunRange(pool, 0, n, COLLISION_GRAIN, [this, &particles] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            particles.pos_x_[p] += correction_x_[p];
+            particles.pos_y_[p] += correction_y_[p];
+            particles.pos_z_[p] += correction_z_[p];
+            particles.vel_x_[p] += velocity_x_[p];
+            particles.vel_y_[p] += velocity_y_[p];
+            particles.vel_z_[p] += velocity_z_[p];
+        }
+    });
+}
@@ -0,0 +1,112 @@
+#ifndef SELF_COLLISION_H
+#define SELF_COLLISION_H
+
+// the particles and springs of the cloth
+#include "ParticleSystem.h"
+#include "Spring.h"
+// the triangles tested against
+#include "ObjParser.h"
+// the grids the particles and triangles are found through
+#include "SpatialHash.h"
+
+#include <vector>
+
+// default settings: the distance kept between two layers of cloth, as a fraction of the mean edge of the cloth at
+// rest (above half the diagonal of a grid cell, so a particle cannot slip between the corners of a triangle), and the
+// most points of a bucket a particle is tested against
+#define SELF_COLLISION_THICKNESS 0.75f
+#define SELF_COLLISION_CELL_LIMIT 32
+// how much further than the thickness a particle looks for what it could meet within the step, at most, as a fraction
+// of the thickness
+#define SELF_COLLISION_LOOKAHEAD 1.0f
+
+// pool the passes are spread over
+class ThreadPool;
+
+// keeps the cloth from going through itself. Every call hashes the particles, and the centres of the triangles, in
+// cells wide enough for a particle to find all the particles and triangles it can reach in the 8 cells around it. A
+// particle closer than the thickness to another one, or above or below a triangle, is moved back out on its side and
+// the approaching part of its velocity is taken out. One further away, but within the distance the fastest particle
+// covers in the coming step (up to lookahead_ thicknesses), has its approach slowed to stop at the thickness, so the
+// layers cannot pass each other within a step. Particles sharing a spring, or closer than the thickness when the cloth
+// is at rest, never collide, nor does a particle with a triangle holding it or one of those particles. The particles
+// share the response by their inverse masses, a particle a collidable held in the last step counts as pinned, in its
+// own test too. A particle only ever moves itself (the particle or triangle it meets is moved by its own test, or not
+// at all for a triangle), by the mean of its corrections computed from the positions before the call, so the passes
+// need no synchronisation and give the same result whatever the threads. A particle looks at no more than cell_limit_
+// points of a bucket, however crowded the cloth gets.
+class SelfCollision
+{
+    public:
+    // constructor
+    SelfCollision();
+    // destructor
+    ~SelfCollision();
+
+    // the pairs to leave alone and the thickness, from the springs and the rest positions of the particles, needed
+    // again whenever the springs change
+    void Build(const SpringTable &springs, const std::vector<ObjTriangle> &triangles,
+               const std::vector<glm::vec3> &rest_positions, unsigned int particle_count);
+    void Clear();
+
+    // pushes the particles apart before they move by a step of h seconds, does nothing when disabled (the default) or
+    // built for another cloth. triangles tests the particles against the triangles even when triangles_enabled_ is
+    // off, for steps long enough to carry a particle between the particles of another layer
+    void Resolve(ParticleSystem &particles, float h, ThreadPool* pool, bool triangles = false);
+
+    // distance kept between two layers
+    float Thickness() const;
+
+    // settings
+    bool enabled_;
+    bool triangles_enabled_;
+    float thickness_scale_;
+    float lookahead_;
+    unsigned int cell_limit_;
+
+    private:
+    // whether particle a (whose neighbours are sorted) may collide with particle b
+    bool Separate(unsigned int a, unsigned int b) const;
+    // the response of a particle to a contact along normal at distance, share being its part of it, returns false when
+    // there is none
+    bool Respond(float distance, const glm::vec3 &normal, const glm::vec3 &relative_velocity, float share,
+                 glm::vec3 &correction, glm::vec3 &velocity_change) const;
+    // the correction and velocity change of one particle, returns the number of contacts
+    unsigned int CollideParticle(const ParticleSystem &particles, unsigned int p, glm::vec3 &correction,
+                                 glm::vec3 &velocity_change) const;
+    unsigned int CollideTriangles(const ParticleSystem &particles, unsigned int p, glm::vec3 &correction,
+                                  glm::vec3 &velocity_change) const;
+
+    unsigned int particle_count_;
+    // mean length of the edges at rest
+    float rest_edge_;
+    // the step of the current call and how far a particle looks
+    float step_;
+    float reach_;
+    // the particles sharing a spring with particle p are neighbours_[neighbour_offsets_[p] .. [p + 1]), sorted
+    std::vector<unsigned int> neighbour_offsets_;
+    std::vector<unsigned int> neighbours_;
+    // rest positions, to leave out the pairs that start closer than the thickness
+    AlignedVector<float> rest_x_;
+    AlignedVector<float> rest_y_;
+    AlignedVector<float> rest_z_;
+    // the three particles of every triangle, degenerate ones left out
+    std::vector<unsigned int> triangles_;
+
+    // the particles, and the centres of the triangles with the cell size of their grid
+    SpatialHash particle_hash_;
+    SpatialHash triangle_hash_;
+    AlignedVector<float> centre_x_;
+    AlignedVector<float> centre_y_;
+    AlignedVector<float> centre_z_;
+    std::vector<float> radius_;
+    // corrections of every particle, applied once all are computed
+    AlignedVector<float> correction_x_;
+    AlignedVector<float> correction_y_;
+    AlignedVector<float> correction_z_;
+    AlignedVector<float> velocity_x_;
+    AlignedVector<float> velocity_y_;
+    AlignedVector<float> velocity_z_;
+};
+
+#endif // SELF_COLLISION_H
@@ -0,0 +1,481 @@
+// class declaration
+#include "Simulation.h"
+
+// getenv, atoi
+#include <cstdlib>
+// strcmp
+#include <cstring>
+// std::max
+#include <algorithm>
+
+// scoped timers
+#include "Profiler.h"
+
+// relative rounding allowed on the time owed by Advance
+#define STEP_SLACK 1e-4
+
+// constructor
+Simulation::Simulation()
+{
+    // initialise the pointer to the cloth object
+    object_ = new ClothObject();
+    // worker threads, by default one per hardware thread
+    ConfigureThreads();
+    // and to the collidables
+    collidables_ = NULL;
+    n_collidables_ = 0;
+    // simulation parameters
+    delta_time_ = 0.0016;
+    adaptive_step_ = true;
+    frame_delta_time_ = 1.0 / 60.0;
+    pending_time_ = 0.0;
+    time_ = 0.0;
+    for (unsigned int phase = 0; phase < kPhaseCount; phase++)
+        phase_time_[phase] = 0;
+    ConfigureSolvers();
+
+    // scene parameters, the same as the defaults of the window's sliders
+    size_ = 2.0;
+    gravity_ = 9.8;
+    air_resistance_ = 0;
+    wind_ = 0;
+    wind_dir_ = glm::vec3(0, 1, 0);
+    static_ = 3.0;
+    kinetic_ = 1.0;
+
+    // init state
+    current_scene_ = kDefault;
+    method_ = kExplicitEuler;
+    SetDefaultScene();
+}
+
+// destructor
+Simulation::~Simulation()
+{
+    ClearCollidables();
+    // join the worker threads
+    object_->thread_pool_ = NULL;
+    delete thread_pool_;
+    delete object_;
+}
+
+// the pool is set up from the environment: CLOTH_THREADS (count), CLOTH_GRAIN (particles per chunk)
+// and CLOTH_PIN_THREADS (bind workers to cores)
+void Simulation::ConfigureThreads()
+{
+    const char* threads = getenv("CLOTH_THREADS");
+    const char* grain = getenv("CLOTH_GRAIN");
+    const char* pin = getenv("CLOTH_PIN_THREADS");
+
+    thread_pool_ = new ThreadPool(threads ? atoi(threads) : 0);
+    if (grain)
+        thread_pool_->SetGrain(atoi(grain));
+    if (pin && atoi(pin))
+        thread_pool_->PinToCores();
+    object_->thread_pool_ = thread_pool_;
+}
+
+// XPBD settings from the environment: CLOTH_XPBD_ITERATIONS, CLOTH_XPBD_SUBSTEPS and CLOTH_XPBD_JACOBI
+// (Jacobi passes instead of colored Gauss-Seidel ones, with CLOTH_XPBD_RELAXATION), the number of
+// projective dynamics iterations, CLOTH_PD_ITERATIONS, the explicit step, CLOTH_ADAPTIVE_STEP and
+// CLOTH_MAX_STEP_MS, the spring forces, CLOTH_FORCE_MODE (gather sums them per particle in a fixed order, the same
+// whatever the threads, scatter by color classes otherwise), the .obj reader, CLOTH_OBJ_READER (stream, mapped or
+// parallel), CLOTH_OBJ_CACHE (0 neither reads nor writes .clothbin caches), CLOTH_BEND_SPRINGS (1 adds bending
+// springs to .obj cloths) and the
+// self collisions, CLOTH_SELF_COLLISION (off by default, 1 turns them on, 2 tests the particles against the triangles
+// as well, which implicit Euler always does), CLOTH_SELF_THICKNESS (fraction of the mean edge), CLOTH_SELF_LOOKAHEAD
+// (furthest a particle looks ahead, in thicknesses) and CLOTH_SELF_CELL_LIMIT (particles or triangles tested per
+// bucket)
+void Simulation::ConfigureSolvers()
+{
+    XpbdSolver &xpbd = object_->xpbd_solver_;
+    const char* iterations = getenv("CLOTH_XPBD_ITERATIONS");
+    const char* substeps = getenv("CLOTH_XPBD_SUBSTEPS");
+    const char* jacobi = getenv("CLOTH_XPBD_JACOBI");
+    const char* relaxation = getenv("CLOTH_XPBD_RELAXATION");
+
+    if (iterations)
+        xpbd.iterations_ = std::max(1, atoi(iterations));
+    if (substeps)
+        xpbd.substeps_ = std::max(1, atoi(substeps));
+    if (jacobi && atoi(jacobi))
+        xpbd.mode_ = XpbdSolver::kJacobi;
+    if (relaxation)
+        xpbd.relaxation_ = atof(relaxation);
+
+    const char* projective = getenv("CLOTH_PD_ITERATIONS");
+    if (projective)
+        object_->projective_solver_.iterations_ = std::max(1, atoi(projective));
+
+    // adaptive explicit step (0 keeps delta_time_ fixed) and its upper limit in milliseconds
+    const char* adaptive = getenv("CLOTH_ADAPTIVE_STEP");
+    if (adaptive)
+        adaptive_step_ = atoi(adaptive) != 0;
+    const char* max_step = getenv("CLOTH_MAX_STEP_MS");
+    if (max_step)
+        step_controller_.max_step_ = std::max(step_controller_.min_step_, (float)(atof(max_step) / 1000.0));
+
+    const char* force_mode = getenv("CLOTH_FORCE_MODE");
+    if (force_mode)
+        object_->force_mode_ = strcmp(force_mode, "gather") == 0 ? ClothObject::kParticleGather
+                                                                  : ClothObject::kColoredScatter;
+
+    const char* reader = getenv("CLOTH_OBJ_READER");
+    if (reader && strcmp(reader, "stream") == 0)
+        object_->obj_reader_ = ClothObject::kStreamReader;
+    else if (reader && strcmp(reader, "mapped") == 0)
+        object_->obj_reader_ = ClothObject::kMappedReader;
+    else if (reader)
+        object_->obj_reader_ = ClothObject::kParallelReader;
+    const char* cache = getenv("CLOTH_OBJ_CACHE");
+    if (cache)
+        object_->use_cache_ = atoi(cache) != 0;
+    const char* bend = getenv("CLOTH_BEND_SPRINGS");
+    if (bend)
+        object_->bend_springs_ = atoi(bend) != 0;
+
+    SelfCollision &self = object_->self_collision_;
+    const char* self_collision = getenv("CLOTH_SELF_COLLISION");
+    const char* thickness = getenv("CLOTH_SELF_THICKNESS");
+    const char* lookahead = getenv("CLOTH_SELF_LOOKAHEAD");
+    const char* cell_limit = getenv("CLOTH_SELF_CELL_LIMIT");
+    if (self_collision)
+    {
+        self.enabled_ = atoi(self_collision) != 0;
+        self.triangles_enabled_ = atoi(self_collision) == 2;
+    }
+    if (thickness)
+        self.thickness_scale_ = std::max(0.0, atof(thickness));
+    if (lookahead)
+        self.lookahead_ = std::max(0.0, atof(lookahead));
+    if (cell_limit)
+        self.cell_limit_ = std::max(1, atoi(cell_limit));
+}
+
+//
+// Scenes
+//
+
+// will place a floor in the scene
+void Simulation::SetDefaultScene()
+{
+    current_scene_ = kDefault;
+    object_->y_pos_ = 1.5 * size_;
+    // remove previous collidables and objects
+    object_->ClearObject();
+    // collidable is a Floor
+    PlaceCollidables(false);
+    Reset();
+}
+
+// will place a floor and a sphere in the scene
+void Simulation::SetSceneOne()
+{
+    object_->ClearObject();
+    current_scene_ = kScenarioOne;
+    object_->y_pos_ = 0.75 * size_;
+    // generate a cloth grid (removes previous object)
+    object_->GenClothGrid(50, 50, 1.5 * size_);
+    // place a floor in the scene and a ball
+    PlaceCollidables(true);
+    // the cloth will not change, factor the projective dynamics system once
+    object_->projective_solver_.Factor(object_->mass_particles_, object_->springs_, frame_delta_time_);
+    Reset();
+}
+
+// will place a floor in the scene
+void Simulation::SetSceneTwo()
+{
+    object_->ClearObject();
+    current_scene_ = kScenarioTwo;
+    object_->y_pos_ = 0.75 * size_;
+    // generate a cloth grid (removes previous object)
+    object_->GenClothGrid(30, 30, 1.5 * size_);
+    // the cloth is held by two opposing corners
+    object_->mass_particles_.Pin(0);
+    object_->mass_particles_.Pin(object_->mass_particles_.Size() - 1);
+    // the cloth and its pins will not change, factor the projective dynamics system once
+    object_->projective_solver_.Factor(object_->mass_particles_, object_->springs_, frame_delta_time_);
+    // create a floor object
+    PlaceCollidables(false);
+    Reset();
+}
+
+bool Simulation::ReadObjFile(std::string obj_file)
+{
+    object_->y_pos_ = 1.5 * size_;
+    if (!object_->ReadObject(obj_file))
+        return false;
+    // the topology is final, factor the projective dynamics system now rather than on the first step
+    object_->projective_solver_.Factor(object_->mass_particles_, object_->springs_, frame_delta_time_);
+    return true;
+}
+
+void Simulation::Reset()
+{
+    // reset the properties of the simulation to default ie
+    for (unsigned int p = 0; p < object_->mass_particles_.Size(); p++)
+    {
+        // velocity of zero
+        object_->mass_particles_.SetVelocity(p, glm::vec3(0));
+        // initial vertex positions
+        object_->mass_particles_.SetPosition(p, object_->vertices_[p] + glm::vec3(0, object_->y_pos_, 0));
+    }
+    pending_time_ = 0.0;
+    time_ = 0.0;
+}
+
+void Simulation::PlaceCollidables(bool ball)
+{
+    ClearCollidables();
+    n_collidables_ = ball ? 2 : 1;
+    collidables_ = new Collidable*[n_collidables_];
+    collidables_[0] = new Floor(static_, kinetic_, 2.0 * size_, glm::vec3(0.0));
+    if (ball)
+        collidables_[1] = new Sphere(static_, kinetic_, size_ / 4.0, glm::vec3(0.0, size_ / 4.0, 0.0));
+}
+
+void Simulation::ClearCollidables()
+{
+    for (unsigned int obj = 0; obj < n_collidables_; obj++)
+        delete collidables_[obj];
+    delete[] collidables_;
+    collidables_ = NULL;
+    n_collidables_ = 0;
+}
+
+//
+// Properties
+//
+
+void Simulation::SetMass(float mass)
+{
+    object_->cloth_mass_ = mass;
+    object_->mass_particles_.SetMass(object_->cloth_mass_);
+    object_->projective_solver_.Invalidate();
+}
+
+void Simulation::SetStiffness(float k)
+{
+    object_->cloth_k_ = k;
+    object_->springs_.SetStiffness(object_->cloth_k_);
+    object_->projective_solver_.Invalidate();
+}
+
+void Simulation::SetDamping(float d)
+{
+    object_->cloth_d_ = d;
+    object_->springs_.SetDamping(object_->cloth_d_);
+    object_->projective_solver_.Invalidate();
+}
+
+void Simulation::SetFriction(float friction_s, float friction_k)
+{
+    static_ = friction_s;
+    kinetic_ = friction_k;
+    for (unsigned int obj = 0; obj < n_collidables_; obj++)
+    {
+        collidables_[obj]->static_friction_ = static_;
+        collidables_[obj]->kinetic_friction_ = kinetic_;
+    }
+}
+
+//
+// Integration
+//
+
+void Simulation::AdaptStep()
+{
+    if (method_ == kExplicitEuler && adaptive_step_)
+        delta_time_ = step_controller_.Update(object_->mass_particles_, object_->springs_, delta_time_, thread_pool_);
+}
+
+float Simulation::StepSize() const
+{
+    // the explicit integrator needs small steps, the others take a display frame at a time
+    return method_ == kExplicitEuler ? delta_time_ : frame_delta_time_;
+}
+
+float Simulation::Step()
+{
+    PROFILE_SCOPE("Step");
+    switch (method_)
+    {
+        case (kExplicitEuler):
+            StepExplicitEuler();
+            break;
+        case (kImplicitEuler):
+            StepImplicitEuler();
+            break;
+        case (kXpbd):
+            StepXpbd();
+            break;
+        case (kProjectiveDynamics):
+            StepProjectiveDynamics();
+            break;
+
+        default:
+            break;
+    }
+    time_ += StepSize();
+    return StepSize();
+}
+
+unsigned int Simulation::Advance(double time)
+{
+    AdaptStep();
+    pending_time_ += time;
+    unsigned int steps = 0;
+    // the step is a float, so a step owed up to rounding is taken now rather than on the next call
+    while (pending_time_ >= StepSize() * (1.0 - STEP_SLACK))
+    {
+        pending_time_ -= Step();
+        steps++;
+    }
+    return steps;
+}
+
+void Simulation::StepExplicitEuler()
+{
+    ParticleSystem &particles = object_->mass_particles_;
+
+    // step 1 compute forces
+    ComputeForces();
+
+    // step 2 check collisions with collidables
+    CollideParticles(delta_time_);
+
+    // loop over particles (pinned particles have no inverse mass and no velocity so they stay put)
+    PROFILE_PHASE("Integrate", phase_time_[kIntegrate]);
+    object_->ForEachParticle([this, &particles] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int particle = first; particle < last; particle++)
+        {
+            float step = particles.inv_mass_[particle] * delta_time_;
+            // step 3 update velocities
+            particles.vel_x_[particle] += particles.force_x_[particle] * step;
+            particles.vel_y_[particle] += particles.force_y_[particle] * step;
+            particles.vel_z_[particle] += particles.force_z_[particle] * step;
+            // step 4 update positions with the new velocities (symplectic Euler, the step controller's bound
+            // assumes this order, the other one is unstable without damping at any step)
+            particles.pos_x_[particle] += particles.vel_x_[particle] * delta_time_;
+            particles.pos_y_[particle] += particles.vel_y_[particle] * delta_time_;
+            particles.pos_z_[particle] += particles.vel_z_[particle] * delta_time_;
+        }
+    });
+}
+
+void Simulation::StepImplicitEuler()
+{
+    ParticleSystem &particles = object_->mass_particles_;
+    ImplicitSolver &solver = object_->implicit_solver_;
+    float h = frame_delta_time_;
+
+    // step 1 compute forces
+    ComputeForces();
+
+    // step 2 check collisions with collidables
+    CollideParticles(h);
+
+    // step 3 solve for the velocity change of the step (pinned particles are filtered out of the system)
+    PROFILE_PHASE("Integrate", phase_time_[kIntegrate]);
+    solver.Solve(particles, object_->springs_, h, object_->cloth_air_, thread_pool_);
+
+    object_->ForEachParticle([&particles, &solver, h] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int particle = first; particle < last; particle++)
+        {
+            // step 4 update the velocities
+            glm::vec3 delta_v = solver.VelocityChange(particle);
+            particles.vel_x_[particle] += delta_v.x;
+            particles.vel_y_[particle] += delta_v.y;
+            particles.vel_z_[particle] += delta_v.z;
+            // step 5 update the positions with the new velocities
+            particles.pos_x_[particle] += particles.vel_x_[particle] * h;
+            particles.pos_y_[particle] += particles.vel_y_[particle] * h;
+            particles.pos_z_[particle] += particles.vel_z_[particle] * h;
+        }
+    });
+
+    // step 6 the solve can still carry a layer into another, which is taken back out before the next step. A frame
+    // step carries particles between the particles of the other layer, only its triangles catch them
+    {
+        PROFILE_PHASE("Collide", phase_time_[kCollide]);
+        object_->self_collision_.Resolve(particles, h, thread_pool_, true);
+    }
+}
+
+void Simulation::StepXpbd()
+{
+    ParticleSystem &particles = object_->mass_particles_;
+    XpbdSolver &solver = object_->xpbd_solver_;
+    // a frame is split in substeps, which converge much faster than extra iterations
+    float h = frame_delta_time_ / solver.substeps_;
+
+    for (unsigned int substep = 0; substep < solver.substeps_; substep++)
+    {
+        // step 1 external forces only, the springs are constraints
+        ComputeExternalForces();
+        {
+            PROFILE_PHASE("Integrate", phase_time_[kIntegrate]);
+            // step 2 move the particles freely
+            solver.Predict(particles, h, thread_pool_);
+            // step 3 pull them back onto the springs
+            solver.Project(particles, object_->springs_, h, thread_pool_);
+            // step 4 velocities from the distance travelled
+            solver.UpdateVelocities(particles, h, thread_pool_);
+        }
+        // step 5 check collisions with collidables
+        CollideParticles(h);
+    }
+}
+
+void Simulation::StepProjectiveDynamics()
+{
+    // step 1 external forces only, the springs are handled by the solver
+    ComputeExternalForces();
+    // the floor may have put a layer back against another at the end of the last step, which the whole frame step
+    // would carry it through
+    {
+        PROFILE_PHASE("Collide", phase_time_[kCollide]);
+        object_->self_collision_.Resolve(object_->mass_particles_, frame_delta_time_, thread_pool_);
+    }
+    // step 2 local projections and global solves (refactors first if the pins changed)
+    {
+        PROFILE_PHASE("Integrate", phase_time_[kIntegrate]);
+        object_->projective_solver_.Step(object_->mass_particles_, object_->springs_, frame_delta_time_, thread_pool_);
+    }
+    // step 3 check collisions with collidables
+    CollideParticles(frame_delta_time_);
+}
+
+void Simulation::ComputeForces()
+{
+    PROFILE_PHASE("Forces", phase_time_[kForces]);
+    object_->ComputeForces(glm::vec3(0.0, -gravity_, 0.0), wind_ * wind_dir_, air_resistance_);
+}
+
+void Simulation::ComputeExternalForces()
+{
+    PROFILE_PHASE("Forces", phase_time_[kForces]);
+    object_->ComputeExternalForces(glm::vec3(0.0, -gravity_, 0.0), wind_ * wind_dir_);
+}
+
+// a collision only moves the particle being tested, so every chunk of particles is independent. The cloth is pushed
+// out of itself first (against its triangles too under the frame steps of implicit Euler), the collidables have the
+// last word
+void Simulation::CollideParticles(float h)
+{
+    PROFILE_PHASE("Collide", phase_time_[kCollide]);
+    ParticleSystem &particles = object_->mass_particles_;
+    object_->self_collision_.Resolve(particles, h, thread_pool_, method_ == kImplicitEuler);
+    object_->ForEachParticle([this, &particles] (unsigned int first, unsigned int last)
+    {
+        // contacts only last for the step they are found in
+        for (unsigned int point = first; point < last; point++)
+            particles.flags_[point] &= ~ParticleSystem::kContact;
+        for (unsigned int obj = 0; obj < n_collidables_; obj++)
+            for (unsigned int point = first; point < last; point++)
+                collidables_[obj]->ComputeCollision(PointMass(&particles, point), object_->cloth_gravity_);
+    });
+}
@@ -0,0 +1,137 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// the object loaded from an Obj file
+#include "ClothObject.h"
+// the collidable objects
+#include "Collidable.h"
+// the step size of the explicit integrator
+#include "StepController.h"
+
+#include <cstdint>
+#include <string>
+
+// the simulated scene without any Qt or OpenGL: the cloth, the collidables, the scene parameters and the integrators.
+// The widget draws it and the batch runner steps it without a display.
+class Simulation
+{
+    public:
+    // enums to determine current scene type and how clothObject should be handled
+    enum Scene : unsigned int
+    {
+        kDefault = 0,
+        kScenarioOne = 1,
+        kScenarioTwo = 2
+    };
+
+    // enums to determine current integration
+    enum Integration : unsigned int
+    {
+        kExplicitEuler = 0,
+        kImplicitEuler = 1,
+        kXpbd = 2,
+        kProjectiveDynamics = 3
+    };
+
+    // the phases of a step, timed for the viewer's overlay
+    enum Phase : unsigned int
+    {
+        kForces = 0,
+        kCollide = 1,
+        kIntegrate = 2,
+        kPhaseCount = 3
+    };
+
+    // constructor
+    Simulation();
+    // destructor
+    ~Simulation();
+
+    // creates the worker threads
+    void ConfigureThreads();
+    // reads the solver settings
+    void ConfigureSolvers();
+
+    // scene setting
+    void SetDefaultScene();
+    void SetSceneOne();
+    void SetSceneTwo();
+    // loads an obj cloth above the floor, returns false when the file could not be read
+    bool ReadObjFile(std::string obj_file);
+    // puts the cloth back where it started, at rest
+    void Reset();
+
+    // cloth and collidable properties
+    void SetMass(float mass);
+    void SetStiffness(float k);
+    void SetDamping(float d);
+    void SetFriction(float friction_s, float friction_k);
+
+    // picks the explicit step from the stability estimate of the cloth as it is now
+    void AdaptStep();
+    // one step of the selected integrator, returns the simulated time
+    float Step();
+    float StepSize() const;
+    // steps until time more seconds have been simulated, the remainder carries over to the next call,
+    // returns the number of steps taken
+    unsigned int Advance(double time);
+
+    // integration
+    void StepExplicitEuler();
+    void StepImplicitEuler();
+    void StepXpbd();
+    void StepProjectiveDynamics();
+    // integration phases shared by the integrators
+    void ComputeForces();
+    void ComputeExternalForces();
+    // h is the step the particles move by next, the cloth's layers are kept from passing each other within it
+    void CollideParticles(float h);
+
+    // the object in the scene
+    ClothObject* object_;
+
+    // worker threads shared by the simulation loops
+    ThreadPool* thread_pool_;
+
+    // the collidable objects in the scene
+    Collidable **collidables_;
+    unsigned int n_collidables_;
+
+    // the current scene, dictates how some object behave
+    Scene current_scene_;
+
+    // integration method selected
+    Integration method_;
+
+    // the time step delta t in seconds, picked from the stiffness, masses and velocities of the cloth
+    // unless adaptive stepping is turned off
+    float delta_time_;
+    StepController step_controller_;
+    bool adaptive_step_;
+    // the implicit and position based integrators are stable at much larger steps, they take one display frame per step
+    float frame_delta_time_;
+    // simulated time owed by Advance
+    double pending_time_;
+    // seconds simulated since the last reset
+    double time_;
+    // nanoseconds spent in every phase since whoever reads them last set them to zero
+    int64_t phase_time_[kPhaseCount];
+
+    // scene parameters
+    float air_resistance_;
+    float gravity_;
+    float kinetic_;
+    float static_;
+    float wind_;
+    glm::vec3 wind_dir_;
+
+    // arbitrary size of the scene
+    float size_;
+
+    private:
+    // replaces the collidables with a floor, and a ball when asked
+    void PlaceCollidables(bool ball);
+    void ClearCollidables();
+};
+
+#endif // SIMULATION_H
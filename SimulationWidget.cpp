@@ -1,8 +1,14 @@
 // the widget declaration
 #include <SimulationWidget.h>
 
-// file stream 
-#include <fstream>
+// getenv, atoi
+#include <cstdlib>
+// std::max
+#include <algorithm>
+// INT_MAX
+#include <climits>
+// std::fmod
+#include <cmath>
 
 // opengGL functions
 #include <GL/gl.h>
@@ -11,31 +17,56 @@
 // making a matrix from an array of values
 #include <glm/gtc/type_ptr.hpp>
 
+// scoped timers and the trace export
+#include "Profiler.h"
+
+// longest real time a tick can owe the simulation, so a pause does not queue up a burst of steps
+#define MAX_TICK_TIME 0.1
+// default share of a tick (in seconds) spent stepping, the rest is left for drawing
+#define STEP_BUDGET 0.012
+
+// ticks shown by the frame time graph, and the frame time filling its height in ms
+#define HUD_FRAMES 120
+#define HUD_GRAPH_MS 50.0
+// overlay panel in pixels
+#define HUD_WIDTH 360
+#define HUD_HEIGHT 150
+
 // directional light along z axis
 static float light_position[] = {1.0, 1.0, 1.0, 0.0};	
 
 // constructor
 SimulationWidget::SimulationWidget(QWidget* parent) : QGLWidget(parent)
 {
-    // initialise the pointer to the cloth object
-    object_ = new ClothObject();
-    // and to the collidables
-    collidables_ = NULL;
-    n_collidables_ = 0;
-    // simulation parameters
-    delta_time_ = 0.0016;
+    // the scene being simulated, starts with the default one
+    simulation_ = new Simulation();
+    // playback parameters
+    accumulator_ = 0.0;
+    step_budget_ = STEP_BUDGET;
+    sim_ratio_ = 0.0;
+    tick_steps_ = 0;
+    record_every_ = 1;
+    ConfigurePlayback();
+    timeline_.Start(*simulation_);
+
+    // no texture being loaded
+    texture_generation_ = 0;
 
     // tell qt to enable mouse tracking
     setMouseTracking(true);
     
     // init state
     show_points_ = 0;
-    current_scene_ = kDefault;
-    method_ = kExplicitEuler;
-    SetDefaultScene();
-    size_ = 2.0;
-    wind_ = 0;
-    wind_dir_= glm::vec3(0, 1, 0);
+    size_ = simulation_->size_;
+
+    // performance overlay, hidden until asked for
+    show_hud_ = 0;
+    steps_per_second_ = 0.0;
+    for (unsigned int phase = 0; phase <= Simulation::kPhaseCount; phase++)
+        phase_ms_[phase] = 0.0;
+    render_time_ = 0;
+    frame_times_.assign(HUD_FRAMES, 0.0f);
+    frame_index_ = 0;
 
     // init arc ball (take into account the scene transform to be in view)
     Ball_Init(&arc_ball_);
@@ -46,7 +77,30 @@ SimulationWidget::SimulationWidget(QWidget* parent) : QGLWidget(parent)
 // destructor
 SimulationWidget::~SimulationWidget()
 {
-    // do something
+    // the textures still loading are waited for, their uploads are dropped
+    for (TextureLoads::iterator load = texture_loads_.begin(); load != texture_loads_.end(); ++load)
+        load->second.wait();
+    // joins the worker threads
+    delete simulation_;
+}
+
+// milliseconds of every tick the accumulator may spend stepping, CLOTH_STEP_BUDGET_MS, the frames kept by
+// a recording, one out of CLOTH_RECORD_EVERY, and the timeline's steps between key frames, CLOTH_TIMELINE_KEY_STEPS,
+// and memory in MB, CLOTH_TIMELINE_MB (0 keeps no history)
+void SimulationWidget::ConfigurePlayback()
+{
+    const char* budget = getenv("CLOTH_STEP_BUDGET_MS");
+    if (budget)
+        step_budget_ = atof(budget) / 1000.0;
+    const char* every = getenv("CLOTH_RECORD_EVERY");
+    if (every)
+        record_every_ = std::max(1, atoi(every));
+    const char* key_steps = getenv("CLOTH_TIMELINE_KEY_STEPS");
+    if (key_steps)
+        timeline_.key_steps_ = std::max(1, atoi(key_steps));
+    const char* timeline_mb = getenv("CLOTH_TIMELINE_MB");
+    if (timeline_mb)
+        timeline_.budget_ = (size_t)std::max(0, atoi(timeline_mb)) << 20;
 }
 
 //
@@ -55,19 +109,47 @@ SimulationWidget::~SimulationWidget()
 
 void SimulationWidget::UpdateObjects()
 { 
-    switch (method_)
+    PROFILE_SCOPE("UpdateObjects");
+    // real time since the previous tick, the first tick after a reset owes one timer interval
+    double elapsed = tick_clock_.isValid() ? tick_clock_.nsecsElapsed() * 1e-9 : simulation_->frame_delta_time_;
+    tick_clock_.start();
+    accumulator_ += std::min(elapsed, MAX_TICK_TIME);
+
+    // the explicit step follows the stability estimate of the cloth as it is at the start of the tick
+    simulation_->AdaptStep();
+
+    // pay back the owed time in fixed steps, without redrawing, for as long as the budget allows
+    QElapsedTimer budget;
+    budget.start();
+    double simulated = 0.0;
+    tick_steps_ = 0;
+    float h = simulation_->StepSize();
+    while (accumulator_ >= h && budget.nsecsElapsed() * 1e-9 < step_budget_)
     {
-        case (kExplicitEuler):
-            StepExplicitEuler();
-            break;
-        case (kImplicitEuler):
-            StepImplicitEuler();
-            break;
-        
-        default:
-            break;
-    }  
-    updateGL();
+        float step = simulation_->Step();
+        accumulator_ -= step;
+        simulated += step;
+        tick_steps_++;
+    }
+    // out of budget: the simulation runs behind real time, drop the backlog rather than chase it
+    if (accumulator_ >= h)
+        accumulator_ = std::fmod(accumulator_, (double)h);
+
+    // a snapshot for the writer thread, dropped rather than waited for when it is behind
+    if (tick_steps_ > 0)
+        recorder_.Capture(*simulation_->object_, false);
+    timeline_.Record(*simulation_, tick_steps_);
+    EmitTimeline();
+
+    {
+        PROFILE_SCOPE("Redraw");
+        updateGL();
+    }
+
+    // report the simulated time per real time, smoothed over a few ticks
+    UpdateHud(elapsed, simulated);
+    emit SimulationRate(QString("sim/real %1 (%2 steps/tick, dt %3 ms)").arg(sim_ratio_, 0, 'f', 2).arg(tick_steps_)
+                        .arg(h * 1000.0, 0, 'f', 3));
 }
 
 //
@@ -76,22 +158,124 @@ void SimulationWidget::UpdateObjects()
 
 void SimulationWidget::ReadObjFile(QString file_name)
 {
-    std::string obj = file_name.toStdString();
-    object_->y_pos_ = 1.5 * size_; 
-    object_->ReadObject(obj);
+    simulation_->ReadObjFile(file_name.toStdString());
+    RestartTimeline();
 }
 
 void SimulationWidget::ReadPpmFile(QString file_name)
 {
+    // a large texture takes a while to read, the GUI keeps running meanwhile and the texture is uploaded once decoded
     std::string ppm = file_name.toStdString();
-    object_->ReadTexture(ppm);
-    object_->SetTexture();
+    unsigned int generation = ++texture_generation_;
+    texture_loads_.emplace_back(generation, std::async(std::launch::async, [this, ppm, generation] ()
+    {
+        std::unique_ptr<PpmImage> image(new PpmImage());
+        if (!image->Read(ppm))
+            image.reset();
+        QMetaObject::invokeMethod(this, "ApplyTexture", Qt::QueuedConnection, Q_ARG(unsigned int, generation));
+        return image;
+    }));
+}
+
+void SimulationWidget::ApplyTexture(unsigned int generation)
+{
+    TextureLoads::iterator load = texture_loads_.begin();
+    while (load != texture_loads_.end() && load->first != generation)
+        ++load;
+    if (load == texture_loads_.end())
+        return;
+    // the load asked for its upload just before returning the image
+    std::unique_ptr<PpmImage> image = load->second.get();
+    texture_loads_.erase(load);
+    // a later load replaced this one
+    if (generation != texture_generation_ || !image)
+        return;
+    simulation_->object_->SetImage(*image);
+    makeCurrent();
+    simulation_->object_->SetTexture();
+    updateGL();
 }
 
 void SimulationWidget::WriteObjFile(QString file_name)
 {
     std::string obj = file_name.toStdString();
-    object_->WriteObject(obj);
+    simulation_->object_->WriteObject(obj);
+}
+
+//
+// Trace Slots
+//
+
+void SimulationWidget::StartTrace()
+{
+    Profiler::Clear();
+    Profiler::SetEnabled(true);
+}
+
+void SimulationWidget::WriteTrace(QString file_name)
+{
+    Profiler::SetEnabled(false);
+    if (!file_name.isEmpty())
+        Profiler::WriteChromeTrace(file_name.toStdString());
+}
+
+//
+// Recording Slots
+//
+
+void SimulationWidget::StartRecording(QString file_name)
+{
+    recorder_.Start(file_name.toStdString(), *simulation_->object_, record_every_);
+}
+
+void SimulationWidget::StopRecording()
+{
+    // waits for the frames still queued
+    recorder_.Stop();
+}
+
+//
+// Timeline Slots
+//
+
+void SimulationWidget::SeekTimeline(int step)
+{
+    timeline_.Seek(timeline_.FirstStep() + std::max(step, 0), *simulation_);
+    // the time spent seeking is not owed to the simulation
+    accumulator_ = 0.0;
+    tick_clock_.invalidate();
+    updateGL();
+    EmitTimeline();
+}
+
+void SimulationWidget::PreviewTimeline(int step)
+{
+    if (timeline_.Preview(timeline_.FirstStep() + std::max(step, 0), simulation_->object_->mass_particles_))
+        updateGL();
+}
+
+void SimulationWidget::RestartTimeline()
+{
+    timeline_.Start(*simulation_);
+    EmitTimeline();
+}
+
+void SimulationWidget::SplitTimeline()
+{
+    timeline_.Split(*simulation_);
+    EmitTimeline();
+}
+
+// a count of steps for the int of a slider, which a long run could pass
+static inline int SliderSteps(uint64_t steps)
+{
+    return (int)std::min<uint64_t>(steps, INT_MAX);
+}
+
+void SimulationWidget::EmitTimeline()
+{
+    uint64_t first = timeline_.FirstStep();
+    emit TimelineChanged(0, SliderSteps(timeline_.LastStep() - first), SliderSteps(timeline_.CurrentStep() - first));
 }
 
 //
@@ -100,14 +284,12 @@ void SimulationWidget::WriteObjFile(QString file_name)
 
 void SimulationWidget::ResetSimulation()
 {
-    // reset the properties of the simulation to default ie
-    for (unsigned int p = 0; p < object_->mass_particles_.size(); p++)
-    {
-        // velocity of zero
-        object_->mass_particles_[p]->velocity_ = glm::vec3(0);
-        // initial vertex positions
-        object_->mass_particles_[p]->position_ = object_->vertices_[p] + glm::vec3(0, object_->y_pos_, 0);
-    }
+    // reset the properties of the simulation to default ie velocity of zero and initial vertex positions
+    simulation_->Reset();
+    // start timing afresh on the next tick
+    accumulator_ = 0.0;
+    tick_clock_.invalidate();
+    RestartTimeline();
     updateGL();
 }
 
@@ -117,23 +299,32 @@ void SimulationWidget::ShowPoints(int state)
     updateGL();
 }
 
+void SimulationWidget::ShowHud(int state)
+{
+    show_hud_ = state;
+    updateGL();
+}
+
 //
 // Cloth Slots 
 //
 
 void SimulationWidget::UpdateMass(int new_mass)
 {
-    object_->cloth_mass_ = new_mass / 10.0;
+    simulation_->SetMass(new_mass / 10.0);
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateStiffness(int new_k)
 {
-    object_->cloth_k_ = new_k * 100.0;
+    simulation_->SetStiffness(new_k * 100.0);
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateDampening(int new_d)
 {
-    object_->cloth_d_ = new_d;
+    simulation_->SetDamping(new_d);
+    SplitTimeline();
 }
 
 //
@@ -142,88 +333,63 @@ void SimulationWidget::UpdateDampening(int new_d)
 
 void SimulationWidget::UpdateGravity(int new_gravity)
 {
-    gravity_ = new_gravity / 10.0;
+    simulation_->gravity_ = new_gravity / 10.0;
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateAirResistance(int new_air)
 {
-    air_resistance_ = new_air / 50.0;
+    simulation_->air_resistance_ = new_air / 50.0;
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateWind(int new_wind)
 {
-    wind_ = new_wind / 10.0;
+    simulation_->wind_ = new_wind / 10.0;
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateStatic(int new_static)
 {
-    static_ = new_static / 10.0;
-    collidables_[0]->static_friction_ = static_;
+    simulation_->SetFriction(new_static / 10.0, simulation_->kinetic_);
+    SplitTimeline();
 }
 
 void SimulationWidget::UpdateKinetic(int new_kinetic)
 {
-    kinetic_ = new_kinetic / 10.0;
-    collidables_[0]->kinetic_friction_ = kinetic_;
+    simulation_->SetFriction(simulation_->static_, new_kinetic / 10.0);
+    SplitTimeline();
+}
+
+void SimulationWidget::UpdateSelfCollision(int state)
+{
+    simulation_->object_->self_collision_.enabled_ = state != Qt::Unchecked;
+    SplitTimeline();
 }
 
 
 //
-// Scene Slots (also setup)
+// Scene Slots
 //
 
 // will place a floor in the scene
 void SimulationWidget::SetDefaultScene()
 {
-    current_scene_ = kDefault;
-    object_->y_pos_ = 1.5 * size_;
-    // remove previous collidables and objects
-    object_->ClearObject();
-    delete collidables_;
-    // create collidables
-    n_collidables_ = 1;
-    collidables_ = new Collidable*[n_collidables_];
-    // collidable is a Floor
-    collidables_[0] = new Floor(static_, kinetic_, 2.0 * size_, glm::vec3(0.0));
+    simulation_->SetDefaultScene();
     ResetSimulation();
 }
 
 // will place a floor and a sphere in the scene
 void SimulationWidget::SetSceneOne()
 {
-    object_->ClearObject();
-    current_scene_ = kScenarioOne;
-    object_->y_pos_ = 0.75 * size_;
-    // generate a cloth grid (removes previous object)
-    object_->GenClothGrid(50, 50, 1.5 * size_);
-    // remove collidables of the previous scene
-    delete collidables_;
-    // create two collidables
-    n_collidables_ = 2;
-    collidables_ = new Collidable*[n_collidables_];
-    // place a floor in the scene and a ball
-    collidables_[0] = new Floor(static_, kinetic_, 2.0 * size_, glm::vec3(0.0));
-    collidables_[1] = new Sphere(static_, kinetic_, size_ / 4.0, glm::vec3(0.0, size_ / 4.0, 0.0));
-    // update the scene
+    simulation_->SetSceneOne();
     ResetSimulation();
 }
 
 // will place a floor in the scene
 void SimulationWidget::SetSceneTwo()
 {
-    object_->ClearObject();
-    current_scene_ = kScenarioTwo;
-    object_->y_pos_ = 0.75 * size_;
-    // generate a cloth grid (removes previous object)
-    object_->GenClothGrid(30, 30, 1.5 * size_);
-    // remove previous collidables
-    delete collidables_;
-    // create a collidable
-    n_collidables_ = 1;
-    collidables_ = new Collidable*[n_collidables_];
-    // create a floor object
-    collidables_[0] = new Floor(static_, kinetic_, 2.0 * size_, glm::vec3(0.0));
-    // update the scene
+    simulation_->SetSceneTwo();
     ResetSimulation();
 }
 
@@ -270,6 +436,7 @@ void SimulationWidget::resizeGL(int w, int h)
 // called every time the widget needs painting
 void SimulationWidget::paintGL()
 {
+    PROFILE_PHASE("Render", render_time_);
     // set up scene parameters
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_COLOR_MATERIAL);
@@ -319,82 +486,114 @@ void SimulationWidget::paintGL()
     glColor3f(1, 1, 1);
 
     // render the collidable objects
-    for (unsigned int obj = 0; obj < n_collidables_; obj++)
-        collidables_[obj]->DrawCollidable();
+    for (unsigned int obj = 0; obj < simulation_->n_collidables_; obj++)
+        simulation_->collidables_[obj]->DrawCollidable();
 
+    ClothObject* object = simulation_->object_;
     glPushMatrix();
     // centre the object
-    glTranslatef(-object_->centre_of_gravity_.x, -object_->centre_of_gravity_.y, -object_->centre_of_gravity_.z);
-    object_->Render();
+    glTranslatef(-object->centre_of_gravity_.x, -object->centre_of_gravity_.y, -object->centre_of_gravity_.z);
+    object->Render();
     if (show_points_)
-        object_->ShowPoints();
+        object->ShowPoints();
     glPopMatrix();
+
+    if (show_hud_)
+        DrawHud();
     
 }
 
 //
-// Integration
+// Performance overlay
 //
 
-void SimulationWidget::StepExplicitEuler()
+void SimulationWidget::UpdateHud(double elapsed, double simulated)
 {
-    unsigned int first_particle = 0;
-    unsigned int last_particle = object_->mass_particles_.size();
-
-    if (current_scene_ == kScenarioTwo)
+    if (elapsed > 0.0)
     {
-        first_particle++;
-        last_particle--;
+        sim_ratio_ = 0.9 * sim_ratio_ + 0.1 * (simulated / elapsed);
+        steps_per_second_ = 0.9 * steps_per_second_ + 0.1 * (tick_steps_ / elapsed);
     }
-
-    // step 1 compute forces
-    object_->ComputeForces(glm::vec3(0.0, -gravity_, 0.0), wind_ * wind_dir_, air_resistance_);
-    
-    // step 2 check collisions with collidables
-    for (unsigned int obj = 0; obj < n_collidables_; obj++)
-        for (unsigned int point = 0; point < object_->mass_particles_.size(); point++)
-            collidables_[obj]->ComputeCollision(object_->mass_particles_[point], object_->cloth_gravity_);
-    
-    // loop over particles
-    for (unsigned int particle = first_particle; particle < last_particle; particle++)
+    // milliseconds per tick of every phase, the render time is the redraw of this tick
+    for (unsigned int phase = 0; phase <= Simulation::kPhaseCount; phase++)
     {
-        // step 3 update positions
-        object_->mass_particles_[particle]->position_ += object_->mass_particles_[particle]->velocity_ * delta_time_;
-        // step 4 update velocities
-        object_->mass_particles_[particle]->velocity_ += (object_->mass_particles_[particle]->net_F_ / object_->cloth_mass_) * delta_time_;
-
+        int64_t &time = phase < Simulation::kPhaseCount ? simulation_->phase_time_[phase] : render_time_;
+        phase_ms_[phase] = 0.9 * phase_ms_[phase] + 0.1 * (time * 1e-6);
+        time = 0;
     }
+    frame_times_[frame_index_] = elapsed * 1000.0;
+    frame_index_ = (frame_index_ + 1) % HUD_FRAMES;
 }
 
-void SimulationWidget::StepImplicitEuler()
+void SimulationWidget::DrawHud()
 {
-    unsigned int first_particle = 0;
-    unsigned int last_particle = object_->mass_particles_.size();
+    // window coordinates, origin in the top left corner, on top of the scene
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width(), height(), 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // translucent panel
+    float left = 10, top = 10;
+    glColor4f(0.0, 0.0, 0.0, 0.6);
+    glBegin(GL_QUADS);
+    glVertex2f(left, top);
+    glVertex2f(left + HUD_WIDTH, top);
+    glVertex2f(left + HUD_WIDTH, top + HUD_HEIGHT);
+    glVertex2f(left, top + HUD_HEIGHT);
+    glEnd();
 
-    if (current_scene_ == kScenarioTwo)
+    // frame time graph along the bottom of the panel, oldest tick on the left
+    float graph_bottom = top + HUD_HEIGHT - 8, graph_height = 60;
+    float column = (HUD_WIDTH - 16.0) / HUD_FRAMES;
+    glColor4f(0.4, 1.0, 0.4, 0.9);
+    glBegin(GL_LINE_STRIP);
+    for (unsigned int i = 0; i < HUD_FRAMES; i++)
     {
-        first_particle++;
-        last_particle--;
+        float ms = std::min(frame_times_[(frame_index_ + i) % HUD_FRAMES], (float)HUD_GRAPH_MS);
+        glVertex2f(left + 8 + i * column, graph_bottom - graph_height * ms / HUD_GRAPH_MS);
     }
-    // step 1 compute forces
-    object_->ComputeForces(glm::vec3(0.0, -gravity_, 0.0), wind_ * wind_dir_, air_resistance_);
+    glEnd();
+    // the 60 Hz budget
+    float budget = graph_bottom - graph_height * (1000.0 / 60.0) / HUD_GRAPH_MS;
+    glColor4f(1.0, 0.4, 0.4, 0.9);
+    glBegin(GL_LINES);
+    glVertex2f(left + 8, budget);
+    glVertex2f(left + HUD_WIDTH - 8, budget);
+    glEnd();
 
-    // step 2 check collisions with collidables
-    for (unsigned int obj = 0; obj < n_collidables_; obj++)
-        for (unsigned int point = 0; point < object_->mass_particles_.size(); point++)
-            collidables_[obj]->ComputeCollision(object_->mass_particles_[point], object_->cloth_gravity_);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 
-    // loop over particles
-    for (unsigned int particle = first_particle; particle < last_particle; particle++)
-    {
-        // step 3 update the velocities
-        object_->mass_particles_[particle]->velocity_ += (object_->mass_particles_[particle]->net_F_ / object_->cloth_mass_) * delta_time_;
-        // step 4 update the positions
-        object_->mass_particles_[particle]->position_ += object_->mass_particles_[particle]->velocity_ * delta_time_;
-    }    
+    // figures, text positions are in window coordinates too
+    ClothObject* object = simulation_->object_;
+    glColor3f(1.0, 1.0, 1.0);
+    renderText(left + 8, top + 16, QString("steps/s %1   sim/real %2   dt %3 ms")
+               .arg(steps_per_second_, 0, 'f', 0).arg(sim_ratio_, 0, 'f', 2)
+               .arg(simulation_->StepSize() * 1000.0, 0, 'f', 3));
+    renderText(left + 8, top + 32, QString("forces %1  collide %2  integrate %3  render %4 ms")
+               .arg(phase_ms_[Simulation::kForces], 0, 'f', 2).arg(phase_ms_[Simulation::kCollide], 0, 'f', 2)
+               .arg(phase_ms_[Simulation::kIntegrate], 0, 'f', 2)
+               .arg(phase_ms_[Simulation::kPhaseCount], 0, 'f', 2));
+    renderText(left + 8, top + 48, QString("particles %1   springs %2   threads %3")
+               .arg(object->mass_particles_.Size()).arg(object->springs_.Size())
+               .arg(simulation_->thread_pool_->Size()));
+    renderText(left + 8, top + 72, QString("frame time (%1 ms full scale, red: 60 Hz)").arg(HUD_GRAPH_MS, 0, 'f', 0));
+
+    glPopAttrib();
 }
 
-
 //
 // Mouse input
 // 
@@ -471,5 +670,5 @@ void SimulationWidget::TransformWind(float matrix[16])
     // get the transform (will always be a rotation)
     glm::mat4 transform = glm::make_mat4(matrix);
     // apply rotation (convert to vec4, apply rotation, convert back to vec3)
-    wind_dir_ = glm::vec3(transform * glm::vec4(wind_dir_, 0.0));
+    simulation_->wind_dir_ = glm::vec3(transform * glm::vec4(simulation_->wind_dir_, 0.0));
 }
\ No newline at end of file
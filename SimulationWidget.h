@@ -4,45 +4,54 @@
 // for Qt
 #include <QGLWidget>
 #include <QMouseEvent>
+#include <QElapsedTimer>
 
 // the ball in the scene
 #include "Ball.h"
-// the spring tying the ball
-#include "Spring.h"
-// the object loaded from an Obj file
-#include "ClothObject.h"
-// the collidable objects
-#include "Collidable.h"
+// the simulated scene
+#include "Simulation.h"
+// textures decoded off the GUI thread
+#include "PpmImage.h"
+// frame sequences written off the GUI thread
+#include "FrameRecorder.h"
+// the recent steps, for scrubbing back
+#include "Timeline.h"
+
+#include <future>
+#include <list>
+#include <memory>
+#include <utility>
 
 class SimulationWidget : public QGLWidget
 {
-    public:
-    // enums to determine current scene type and how clothObject should be handled
-    enum Scene : unsigned int
-    {
-        kDefault = 0,
-        kScenarioOne = 1,
-        kScenarioTwo = 2
-    };
-
-    // enums to determine current integration
-    enum Integration : unsigned int
-    {
-        kExplicitEuler = 0,
-        kImplicitEuler = 1
-    };
-
     Q_OBJECT
 
     public slots:
-    // integration slots for updating the cloth, called by timer every 1/60 seconds
+    // integration slots for updating the cloth, called by timer every 1/60 seconds: runs as many steps as the
+    // real time since the last call asks for (within the step budget), then redraws once
     void UpdateObjects();
     // file I/O slots
     void ReadObjFile(QString file_name);
     void ReadPpmFile(QString file_name);
     void WriteObjFile(QString file_name);
+    // uploads the texture decoded by the load of the given generation, posted by the loader thread once done
+    void ApplyTexture(unsigned int generation);
+    // trace slots, recording starts from scratch and stops when the trace is written
+    void StartTrace();
+    void WriteTrace(QString file_name);
+    // frame sequence slots, every tick that steps the cloth is a frame
+    void StartRecording(QString file_name);
+    void StopRecording();
+    // timeline slots, steps counted from the oldest one kept: puts the cloth back at a recorded step (simulated again
+    // from the key frame before it), shows the positions of a recorded step without simulating, forgets the history
+    // from the current state on, and keys the history on the current state after a change of setting
+    void SeekTimeline(int step);
+    void PreviewTimeline(int step);
+    void RestartTimeline();
+    void SplitTimeline();
     // display slots
     void ShowPoints(int state);
+    void ShowHud(int state);
     void ResetSimulation();
     // cloth slots
     void UpdateMass(int new_mass);
@@ -54,11 +63,19 @@ class SimulationWidget : public QGLWidget
     void UpdateWind(int new_wind);
     void UpdateStatic(int new_static);
     void UpdateKinetic(int new_kinetic);
+    void UpdateSelfCollision(int state);
     // scene setting
     void SetDefaultScene();
     void SetSceneOne();
     void SetSceneTwo();
 
+    signals:
+    // achieved simulated time per real time, sent every tick
+    void SimulationRate(QString rate);
+    // the steps held by the timeline and the one the cloth is at, counted from the oldest one kept (first is 0) and
+    // clamped to an int, sent every tick and after seeking
+    void TimelineChanged(int first, int last, int current);
+
     public:
     // constructor
     SimulationWidget(QWidget* parent);
@@ -74,9 +91,14 @@ class SimulationWidget : public QGLWidget
 	// called every time the widget needs painting
 	void paintGL();
 
-    // integration
-    void StepExplicitEuler();
-    void StepImplicitEuler();
+    // reads the playback settings
+    void ConfigurePlayback();
+    // draws the performance overlay over the scene
+    void DrawHud();
+    // folds the phase times of the last tick into the overlay's figures
+    void UpdateHud(double elapsed, double simulated);
+    // sends the steps of the timeline to the slider
+    void EmitTimeline();
 
     // mouse input
     HVect mouseToWorld(float mouseX, float mouseY);
@@ -85,36 +107,46 @@ class SimulationWidget : public QGLWidget
     void mouseReleaseEvent(QMouseEvent *event);
     void TransformWind(float matrix[16]);
 
-    // the object in the scene
-    ClothObject* object_;
-
-    // the collidable objects in the scene
-    Collidable **collidables_;
-    unsigned int n_collidables_;
-
-    // the current scene, dictates how some object behave
-    Scene current_scene_;
-
-    // integration method selected
-    Integration method_;
+    // the cloth, collidables and integrators, stepped by the timer
+    Simulation* simulation_;
 
     // arc ball data
     BallData arc_ball_;
     int button_pressed_;
     HVect ball_centre_;
 
-    // the time step delta t in seconds
-    float delta_time_;
-    float air_resistance_;
-    float gravity_;
-    float kinetic_;
-    float static_;
-    float wind_;
-    glm::vec3 wind_dir_;
+    // fixed time step accumulator: real time owed to the simulation, and how much of a tick may go to stepping
+    QElapsedTimer tick_clock_;
+    double accumulator_;
+    float step_budget_;
+    // smoothed simulated time per real time, and steps taken in the last tick
+    double sim_ratio_;
+    unsigned int tick_steps_;
+
+    // textures being decoded on their own threads by generation, every load removes itself once done and only the
+    // latest one (texture_generation_) is uploaded. Destroying a future of std::async waits for its thread, so a
+    // newer load never replaces an older one in place
+    typedef std::list<std::pair<unsigned int, std::future<std::unique_ptr<PpmImage> > > > TextureLoads;
+    TextureLoads texture_loads_;
+    unsigned int texture_generation_;
+
+    // .obj sequence being recorded, one file every record_every_ frames
+    FrameRecorder recorder_;
+    unsigned int record_every_;
+    // every tick since the last reset or change of setting, seeking replays with the current settings
+    Timeline timeline_;
 
     // flag for showing an object's mass points as spheres
     int show_points_;
 
+    // performance overlay: flag, smoothed figures and the real time of the last HUD_FRAMES ticks in ms
+    int show_hud_;
+    double steps_per_second_;
+    double phase_ms_[Simulation::kPhaseCount + 1];
+    int64_t render_time_;
+    std::vector<float> frame_times_;
+    unsigned int frame_index_;
+
     // arbitrary size for view space
     float size_;
 };
@@ -0,0 +1,149 @@
+// class declaration
+#include "SpatialHash.h"
+
+// the passes run on the worker threads
+#include "ThreadPool.h"
+
+// points handed to a thread at a time
+#define HASH_GRAIN 4096
+// buckets summed by a block of the prefix sum
+#define HASH_SCAN_BLOCK 4096
+
+// constructor
+SpatialHash::SpatialHash()
+{
+    inv_cell_ = 1.0f;
+    mask_ = 0;
+    counts_size_ = 0;
+}
+
+// destructor
+SpatialHash::~SpatialHash()
+{
+
+}
+
+void SpatialHash::Clear()
+{
+    offsets_.clear();
+    entries_.clear();
+    keys_.clear();
+    counts_.reset();
+    counts_size_ = 0;
+    block_sums_.clear();
+    mask_ = 0;
+}
+
+void SpatialHash::Build(const float* x, const float* y, const float* z, unsigned int count, float cell,
+                        ThreadPool* pool)
+{
+    inv_cell_ = 1.0f / cell;
+    unsigned int size = 1;
+    while (size < 2 * count)
+        size <<= 1;
+    mask_ = size - 1;
+    if (counts_size_ < size)
+    {
+        counts_.reset(new std::atomic<unsigned int>[size]);
+        counts_size_ = size;
+    }
+    offsets_.resize(size + 1);
+    keys_.resize(count);
+    entries_.resize(count);
+
+    // step 1 the bucket of every point, and how many points every bucket gets
+    ThreadPool::RunRange(pool, 0, size, HASH_GRAIN, [this] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int b = first; b < last; b++)
+            counts_[b].store(0, std::memory_order_relaxed);
+    });
+    ThreadPool::RunRange(pool, 0, count, HASH_GRAIN, [this, x, y, z] (unsigned int first, unsigned int last)
+    {
+        int cell[3];
+        for (unsigned int p = first; p < last; p++)
+        {
+            Cell(x[p], y[p], z[p], cell);
+            keys_[p] = Bucket(cell[0], cell[1], cell[2]);
+            counts_[keys_[p]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // step 2 exclusive prefix sum of the sizes: the total of every block, the blocks offset one after the other, then
+    // every bucket within its block
+    unsigned int blocks = (size + HASH_SCAN_BLOCK - 1) / HASH_SCAN_BLOCK;
+    block_sums_.assign(blocks + 1, 0);
+    ThreadPool::RunRange(pool, 0, blocks, 1, [this, size] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int block = first; block < last; block++)
+        {
+            unsigned int sum = 0;
+            for (unsigned int b = block * HASH_SCAN_BLOCK; b < std::min(size, (block + 1) * HASH_SCAN_BLOCK); b++)
+                sum += counts_[b].load(std::memory_order_relaxed);
+            block_sums_[block + 1] = sum;
+        }
+    });
+    for (unsigned int block = 0; block < blocks; block++)
+        block_sums_[block + 1] += block_sums_[block];
+    ThreadPool::RunRange(pool, 0, blocks, 1, [this, size] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int block = first; block < last; block++)
+        {
+            unsigned int offset = block_sums_[block];
+            for (unsigned int b = block * HASH_SCAN_BLOCK; b < std::min(size, (block + 1) * HASH_SCAN_BLOCK); b++)
+            {
+                unsigned int bucket_size = counts_[b].load(std::memory_order_relaxed);
+                offsets_[b] = offset;
+                // the count becomes the next free slot of the bucket
+                counts_[b].store(offset, std::memory_order_relaxed);
+                offset += bucket_size;
+            }
+        }
+    });
+    offsets_[size] = count;
+
+    // step 3 every point into a slot of its bucket, in whatever order the threads get there
+    ThreadPool::RunRange(pool, 0, count, HASH_GRAIN, [this] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+            entries_[counts_[keys_[p]].fetch_add(1, std::memory_order_relaxed)] = p;
+    });
+
+    // step 4 which is undone by sorting every (short) bucket, most are still in order as the chunks are handed out in
+    // order
+    ThreadPool::RunRange(pool, 0, size, HASH_GRAIN, [this] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int b = first; b < last; b++)
+        {
+            std::vector<unsigned int>::iterator begin = entries_.begin() + offsets_[b];
+            std::vector<unsigned int>::iterator end = entries_.begin() + offsets_[b + 1];
+            if (end - begin > 1 && !std::is_sorted(begin, end))
+                std::sort(begin, end);
+        }
+    });
+}
+
+unsigned int SpatialHash::Around(float x, float y, float z, unsigned int buckets[8]) const
+{
+    // the cell along every axis, then the one next to it on the side of the point
+    float scaled[3] = { Scaled(x), Scaled(y), Scaled(z) };
+    int cells[3][2];
+    for (unsigned int axis = 0; axis < 3; axis++)
+    {
+        float cell = std::floor(scaled[axis]);
+        cells[axis][0] = (int)cell;
+        cells[axis][1] = scaled[axis] - cell < 0.5f ? (int)cell - 1 : (int)cell + 1;
+    }
+
+    unsigned int count = 0;
+    for (unsigned int corner = 0; corner < 8; corner++)
+    {
+        unsigned int bucket = Bucket(cells[0][corner & 1], cells[1][(corner >> 1) & 1], cells[2][corner >> 2]);
+        // two cells sharing a bucket must not make its points count twice
+        unsigned int b = 0;
+        while (b < count && buckets[b] != bucket)
+            b++;
+        if (b == count)
+            buckets[count++] = bucket;
+    }
+    return count;
+}
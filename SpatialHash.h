@@ -0,0 +1,81 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+// std::min, std::max
+#include <algorithm>
+#include <atomic>
+// std::floor
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// the points are bucketed on the worker threads
+class ThreadPool;
+
+// cell coordinates are kept within +-this many cells
+#define SPATIAL_HASH_RANGE 1e8f
+
+// uniform grid of cubic cells over an unbounded space, the cells hashed into a table of buckets twice as long as the
+// number of points (rounded up to a power of two). Build is a parallel counting sort: the bucket of every point, the
+// bucket sizes counted with atomics, their prefix sum by blocks, the points scattered with atomics, then every bucket
+// sorted by point so the order never depends on the threads. Several cells can share a bucket, a query must check the
+// distance to whatever it finds there. Searches are meant to reach no further than half a cell, which keeps them to
+// 8 cells rather than 27.
+class SpatialHash
+{
+    public:
+    // constructor
+    SpatialHash();
+    // destructor
+    ~SpatialHash();
+
+    // buckets the count points (x[i], y[i], z[i]) in cells cell wide
+    void Build(const float* x, const float* y, const float* z, unsigned int count, float cell, ThreadPool* pool);
+    void Clear();
+
+    // the cell holding a position, and the bucket of a cell
+    void Cell(float x, float y, float z, int cell[3]) const;
+    unsigned int Bucket(int cx, int cy, int cz) const;
+    // the different buckets of the 8 cells a point closer than half a cell to (x, y, z) can be in: its own cell and the
+    // neighbours on the side of the nearer face along every axis. Returns how many
+    unsigned int Around(float x, float y, float z, unsigned int buckets[8]) const;
+
+    // the points in bucket b are entries_[offsets_[b] .. offsets_[b + 1]), in increasing order
+    std::vector<unsigned int> offsets_;
+    std::vector<unsigned int> entries_;
+
+    private:
+    float Scaled(float x) const;
+
+    float inv_cell_;
+    unsigned int mask_;
+    // the bucket of every point
+    std::vector<unsigned int> keys_;
+    // bucket sizes then fill positions, shared by the threads
+    std::unique_ptr<std::atomic<unsigned int>[]> counts_;
+    unsigned int counts_size_;
+    // totals of the blocks of the prefix sum
+    std::vector<unsigned int> block_sums_;
+};
+
+// a coordinate in cells, clamped so a cloth that blew up (or a NaN) still lands in some cell
+inline float SpatialHash::Scaled(float x) const
+{
+    return std::max(-SPATIAL_HASH_RANGE, std::min(x * inv_cell_, SPATIAL_HASH_RANGE));
+}
+
+inline void SpatialHash::Cell(float x, float y, float z, int cell[3]) const
+{
+    // floor rather than truncation so the cells either side of zero are not merged
+    cell[0] = (int)std::floor(Scaled(x));
+    cell[1] = (int)std::floor(Scaled(y));
+    cell[2] = (int)std::floor(Scaled(z));
+}
+
+inline unsigned int SpatialHash::Bucket(int cx, int cy, int cz) const
+{
+    // Teschner et al., Optimized Spatial Hashing for Collision Detection of Deformable Objects
+    return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u ^ (unsigned int)cz * 83492791u) & mask_;
+}
+
+#endif // SPATIAL_HASH_H
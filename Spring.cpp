@@ -1,23 +1,331 @@
 // class declaration of the spring
 #include "Spring.h"
 
+// the vector force kernels
+#include "SpringKernels.h"
+// the pool the force passes run on
+#include "ThreadPool.h"
+
 #include <iostream>
+// sorting the table
+#include <algorithm>
+#include <cmath>
+
+// number of springs handed to a thread at a time, a multiple of SPRING_BATCH
+#define SPRING_GRAIN 4096
+
+//
+// Spring Table
+//
+
+// constructor
+SpringTable::SpringTable()
+{
+
+}
+
+// destructor
+SpringTable::~SpringTable()
+{
+    // arrays release themselves
+}
+
+void SpringTable::Clear()
+{
+    left_.resize(0);
+    right_.resize(0);
+    rest_.resize(0);
+    k_.resize(0);
+    d_.resize(0);
+    color_offsets_.resize(0);
+    incidence_offsets_.resize(0);
+    incidence_.resize(0);
+}
+
+unsigned int SpringTable::Add(unsigned int left, unsigned int right, float rest, float stiffness, float damper)
+{
+    left_.push_back(left);
+    right_.push_back(right);
+    rest_.push_back(rest);
+    k_.push_back(stiffness);
+    d_.push_back(damper);
+    return left_.size() - 1;
+}
+
+void SpringTable::SetStiffness(float k)
+{
+    std::fill(k_.begin(), k_.end(), k);
+}
+
+void SpringTable::SetDamping(float d)
+{
+    std::fill(d_.begin(), d_.end(), d);
+}
+
+// helper for SortForLocality, orders springs by their lowest then highest particle
+struct SpringOrder
+{
+    const SpringTable* springs;
+
+    bool operator () (unsigned int a, unsigned int b) const
+    {
+        unsigned int low_a = std::min(springs->left_[a], springs->right_[a]);
+        unsigned int low_b = std::min(springs->left_[b], springs->right_[b]);
+        if (low_a != low_b)
+            return low_a < low_b;
+        return std::max(springs->left_[a], springs->right_[a]) < std::max(springs->left_[b], springs->right_[b]);
+    }
+};
+
+void SpringTable::SortForLocality()
+{
+    // sort a permutation of the table
+    std::vector<unsigned int> order(Size());
+    for (unsigned int s = 0; s < order.size(); s++)
+        order[s] = s;
+    SpringOrder compare = { this };
+    std::stable_sort(order.begin(), order.end(), compare);
+
+    // then gather every array through it, any previous coloring is lost
+    Permute(order);
+    color_offsets_.resize(0);
+    incidence_offsets_.resize(0);
+    incidence_.resize(0);
+}
+
+void SpringTable::BuildColors(unsigned int particle_count)
+{
+    // colors already taken by the springs of each particle, as bit masks of 64 colors per word
+    std::vector<std::vector<unsigned long long> > used(particle_count);
+    std::vector<unsigned int> color(Size());
+    unsigned int colors = 0;
+
+    // greedy coloring in table order, each spring takes the lowest color free at both of its ends
+    for (unsigned int s = 0; s < Size(); s++)
+    {
+        std::vector<unsigned long long> &left = used[left_[s]];
+        std::vector<unsigned long long> &right = used[right_[s]];
+        unsigned int word = 0;
+        unsigned long long taken = 0;
+        while (true)
+        {
+            taken = (word < left.size() ? left[word] : 0) | (word < right.size() ? right[word] : 0);
+            if (taken != ~0ULL)
+                break;
+            word++;
+        }
+        unsigned int bit = __builtin_ctzll(~taken);
+
+        // mark the color as taken at both ends
+        if (left.size() <= word)
+            left.resize(word + 1, 0);
+        if (right.size() <= word)
+            right.resize(word + 1, 0);
+        left[word] |= 1ULL << bit;
+        right[word] |= 1ULL << bit;
+
+        color[s] = word * 64 + bit;
+        colors = std::max(colors, color[s] + 1);
+    }
+
+    // counting sort by color, springs keep their table order within a class
+    color_offsets_.assign(colors + 1, 0);
+    for (unsigned int s = 0; s < Size(); s++)
+        color_offsets_[color[s] + 1]++;
+    for (unsigned int c = 0; c < colors; c++)
+        color_offsets_[c + 1] += color_offsets_[c];
+    std::vector<unsigned int> slot(color_offsets_.begin(), color_offsets_.end() - 1);
+    std::vector<unsigned int> order(Size());
+    for (unsigned int s = 0; s < Size(); s++)
+        order[slot[color[s]]++] = s;
+    Permute(order);
+}
+
+void SpringTable::BuildIncidence(unsigned int particle_count)
+{
+    // count the springs of every particle
+    incidence_offsets_.assign(particle_count + 1, 0);
+    for (unsigned int s = 0; s < Size(); s++)
+    {
+        incidence_offsets_[left_[s] + 1]++;
+        incidence_offsets_[right_[s] + 1]++;
+    }
+    for (unsigned int p = 0; p < particle_count; p++)
+        incidence_offsets_[p + 1] += incidence_offsets_[p];
+
+    // then list them, in table order for every particle
+    incidence_.resize(2 * Size());
+    std::vector<unsigned int> slot(incidence_offsets_.begin(), incidence_offsets_.end() - 1);
+    for (unsigned int s = 0; s < Size(); s++)
+    {
+        incidence_[slot[left_[s]]++] = 2 * s + 1;
+        incidence_[slot[right_[s]]++] = 2 * s;
+    }
+
+    // room for the per spring forces
+    force_x_.resize(Size());
+    force_y_.resize(Size());
+    force_z_.resize(Size());
+}
+
+void SpringTable::Permute(const std::vector<unsigned int> &order)
+{
+    SpringTable permuted;
+    for (unsigned int s = 0; s < order.size(); s++)
+        permuted.Add(left_[order[s]], right_[order[s]], rest_[order[s]], k_[order[s]], d_[order[s]]);
+    left_.swap(permuted.left_);
+    right_.swap(permuted.right_);
+    rest_.swap(permuted.rest_);
+    k_.swap(permuted.k_);
+    d_.swap(permuted.d_);
+}
+
+// streams over the table, springs pull their ends together along the spring and damp the relative velocity
+void SpringTable::ComputeForces(ParticleSystem &particles, unsigned int first, unsigned int last) const
+{
+    const float* pos_x = particles.pos_x_.data();
+    const float* pos_y = particles.pos_y_.data();
+    const float* pos_z = particles.pos_z_.data();
+    const float* vel_x = particles.vel_x_.data();
+    const float* vel_y = particles.vel_y_.data();
+    const float* vel_z = particles.vel_z_.data();
+    float* force_x = particles.force_x_.data();
+    float* force_y = particles.force_y_.data();
+    float* force_z = particles.force_z_.data();
+
+    for (unsigned int s = first; s < last; s++)
+    {
+        unsigned int left = left_[s];
+        unsigned int right = right_[s];
+
+        // spring vector (from left to right) and current length
+        float dx = pos_x[right] - pos_x[left];
+        float dy = pos_y[right] - pos_y[left];
+        float dz = pos_z[right] - pos_z[left];
+        float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+        // unit vector for the spring force direction
+        float inv_length = 1.0f / length;
+        dx *= inv_length;
+        dy *= inv_length;
+        dz *= inv_length;
+
+        // project relative velocity onto the spring for dampening
+        float relative = (vel_x[right] - vel_x[left]) * dx
+                       + (vel_y[right] - vel_y[left]) * dy
+                       + (vel_z[right] - vel_z[left]) * dz;
+
+        // magnitude of the force applied on both ends of the spring
+        float magnitude = -k_[s] * (length - rest_[s]) - d_[s] * relative;
+
+        force_x[left] -= magnitude * dx;
+        force_y[left] -= magnitude * dy;
+        force_z[left] -= magnitude * dz;
+        force_x[right] += magnitude * dx;
+        force_y[right] += magnitude * dy;
+        force_z[right] += magnitude * dz;
+    }
+}
+
+void SpringTable::ComputeConflictFreeForces(ParticleSystem &particles, unsigned int first, unsigned int last) const
+{
+    static const SpringKernel kernel = SelectSpringKernel();
+    // whole batches go through the vector kernel, the remainder through the scalar loop
+    unsigned int vector_last = first + (last - first) / SPRING_BATCH * SPRING_BATCH;
+    kernel(*this, particles, first, vector_last);
+    ComputeForces(particles, vector_last, last);
+}
+
+void SpringTable::ComputeColoredForces(ParticleSystem &particles, ThreadPool* pool) const
+{
+    // without classes the table can only be walked serially
+    if (color_offsets_.empty())
+    {
+        ComputeForces(particles, 0, Size());
+        return;
+    }
+
+    // a particle appears at most once per class, so every chunk of a class can run on its own thread
+    for (unsigned int c = 0; c + 1 < color_offsets_.size(); c++)
+        ThreadPool::RunRange(pool, color_offsets_[c], color_offsets_[c + 1], SPRING_GRAIN,
+                             [this, &particles] (unsigned int first, unsigned int last)
+        {
+            ComputeConflictFreeForces(particles, first, last);
+        });
+}
+
+void SpringTable::ComputeGatheredForces(ParticleSystem &particles, ThreadPool* pool)
+{
+    // a cleared table has no incidence lists, nor springs
+    if (incidence_offsets_.empty())
+        return;
+    const float* pos_x = particles.pos_x_.data();
+    const float* pos_y = particles.pos_y_.data();
+    const float* pos_z = particles.pos_z_.data();
+    const float* vel_x = particles.vel_x_.data();
+    const float* vel_y = particles.vel_y_.data();
+    const float* vel_z = particles.vel_z_.data();
+
+    // step 1 the force of every spring on its right end
+    ThreadPool::RunRange(pool, 0, Size(), SPRING_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int s = first; s < last; s++)
+        {
+            unsigned int left = left_[s];
+            unsigned int right = right_[s];
+            float dx = pos_x[right] - pos_x[left];
+            float dy = pos_y[right] - pos_y[left];
+            float dz = pos_z[right] - pos_z[left];
+            float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            float inv_length = 1.0f / length;
+            dx *= inv_length;
+            dy *= inv_length;
+            dz *= inv_length;
+            float relative = (vel_x[right] - vel_x[left]) * dx
+                           + (vel_y[right] - vel_y[left]) * dy
+                           + (vel_z[right] - vel_z[left]) * dz;
+            float magnitude = -k_[s] * (length - rest_[s]) - d_[s] * relative;
+            force_x_[s] = magnitude * dx;
+            force_y_[s] = magnitude * dy;
+            force_z_[s] = magnitude * dz;
+        }
+    });
 
-// glm maths
-//#include <glm/geometric.hpp>
+    // step 2 every particle sums the forces of its springs, always in the same order
+    float* force_x = particles.force_x_.data();
+    float* force_y = particles.force_y_.data();
+    float* force_z = particles.force_z_.data();
+    ThreadPool::RunRange(pool, 0, incidence_offsets_.size() - 1, SPRING_GRAIN,
+                         [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+            for (unsigned int i = incidence_offsets_[p]; i < incidence_offsets_[p + 1]; i++)
+            {
+                unsigned int s = incidence_[i] >> 1;
+                // the left end is pulled the other way
+                float sign = (incidence_[i] & 1) ? -1.0f : 1.0f;
+                sum_x += sign * force_x_[s];
+                sum_y += sign * force_y_[s];
+                sum_z += sign * force_z_[s];
+            }
+            force_x[p] += sum_x;
+            force_y[p] += sum_y;
+            force_z[p] += sum_z;
+        }
+    });
+}
+
+//
+// Spring View
+//
 
-// create a spring between two balls
-Spring::Spring(PointMass* left, PointMass* right, float stiffness, float damper)
+// view on a spring of the table
+Spring::Spring(SpringTable* springs, ParticleSystem* particles, unsigned int spring)
 {
-    // update pointers
-    left_ = left;
-    right_ = right;
-    // initialise current and rest length
-    rest_ = glm::distance(right->position_, left->position_);
-    curr_ = rest_;
-    // arbitrary constants
-    k_ = stiffness;
-    d_ = damper;
+    springs_ = springs;
+    particles_ = particles;
+    index = spring;
 }
 
 // destructor
@@ -29,31 +337,28 @@ Spring::~Spring()
 // compute the force exerced by the spring in Newtons
 void Spring::UpdateParticles()
 {
-    // compute current length
-    curr_ = glm::distance(right_->position_, left_->position_);
-    // unit vector for the spring force direction (from left to right)
-    glm::vec3 spring = glm::normalize(right_->position_ - left_->position_); 
- 
-    // compute the forces applied on both ends of the spring
-    glm::vec3 force = 
-    (-k_ * (curr_ - rest_) // spring force
-    - d_ * glm::dot(right_->velocity_ - left_->velocity_, spring)) // dampening (project relative velocity onto the spring)
-    * spring;
-    
-    // apply the forces to the corresponding masses along with air resistance
-    left_->net_F_ -= force;
-    right_->net_F_ += force;
+    springs_->ComputeForces(*particles_, index, index + 1);
 }
 
 void Spring::UpdateParticles(float k, float d)
 {
-    k_ = k;
-    d_ = d;
+    springs_->k_[index] = k;
+    springs_->d_[index] = d;
     UpdateParticles();
 }
 
+PointMass Spring::Left() const
+{
+    return PointMass(particles_, springs_->left_[index]);
+}
+
+PointMass Spring::Right() const
+{
+    return PointMass(particles_, springs_->right_[index]);
+}
+
 std::ostream & operator << (std::ostream &outStream, const Spring &spring)
 {
-    outStream << "spring links " << *spring.left_ << " to " << *spring.right_;
-    return outStream; 
-}
\ No newline at end of file
+    outStream << "spring links " << spring.Left() << " to " << spring.Right();
+    return outStream;
+}
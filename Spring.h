@@ -4,12 +4,85 @@
 // a point mass particle class
 #include "PointMass.h"
 
-// spring class connecting to point masses
+// cache line aligned arrays
+#include "AlignedAllocator.h"
+
+// for the std::vector of color offsets
+#include <vector>
+
+// number of springs evaluated together by the widest vector kernel (AVX-512)
+#define SPRING_BATCH 16
+
+// pool the force passes are spread over
+class ThreadPool;
+
+// packed table of every spring in a cloth, one array per spring property
+class SpringTable
+{
+    public:
+    // constructor
+    SpringTable();
+    // destructor
+    ~SpringTable();
+
+    // table size management
+    void Clear();
+    unsigned int Size() const;
+
+    // appends a spring between two particles and returns its index
+    unsigned int Add(unsigned int left, unsigned int right, float rest, float stiffness, float damper);
+
+    // set the spring scalars of the whole table
+    void SetStiffness(float k);
+    void SetDamping(float d);
+
+    // reorders the table by lowest then highest endpoint so that consecutive springs touch nearby particles
+    void SortForLocality();
+    // reorders the table into color classes, no two springs of a class share a particle (greedy edge coloring)
+    void BuildColors(unsigned int particle_count);
+    // lists the springs attached to every particle, for the gather pass
+    void BuildIncidence(unsigned int particle_count);
+    // gathers every array through a permutation of the table
+    void Permute(const std::vector<unsigned int> &order);
+
+    // compute the forces of springs [first, last) and add them to the particles they link
+    void ComputeForces(ParticleSystem &particles, unsigned int first, unsigned int last) const;
+    // same with the vector kernel, springs [first, last) must not share any particle
+    void ComputeConflictFreeForces(ParticleSystem &particles, unsigned int first, unsigned int last) const;
+    // every spring, one color class after the other with each class split across the pool
+    void ComputeColoredForces(ParticleSystem &particles, ThreadPool* pool) const;
+    // every spring, forces are computed per spring then summed per particle in a fixed order
+    void ComputeGatheredForces(ParticleSystem &particles, ThreadPool* pool);
+
+    // endpoint particle indices
+    AlignedVector<unsigned int> left_;
+    AlignedVector<unsigned int> right_;
+    // rest lengths
+    AlignedVector<float> rest_;
+    // spring scalars (stiffness, damper)
+    AlignedVector<float> k_;
+    AlignedVector<float> d_;
+
+    // color class c holds the springs [color_offsets_[c], color_offsets_[c + 1])
+    std::vector<unsigned int> color_offsets_;
+
+    // the springs of particle p are incidence_[incidence_offsets_[p] .. incidence_offsets_[p + 1]),
+    // stored as spring index * 2 plus one when p is the left end
+    AlignedVector<unsigned int> incidence_offsets_;
+    AlignedVector<unsigned int> incidence_;
+
+    // force of every spring on its right end, written by the gather pass
+    AlignedVector<float> force_x_;
+    AlignedVector<float> force_y_;
+    AlignedVector<float> force_z_;
+};
+
+// view of a single spring stored in a SpringTable
 class Spring
 {
     public:
     // constructor
-    Spring(PointMass* right, PointMass* left, float stiffness, float damper);
+    Spring(SpringTable* springs, ParticleSystem* particles, unsigned int spring);
     // destructor
     ~Spring();
 
@@ -18,20 +91,24 @@ class Spring
     // overload for new k and d
     void UpdateParticles(float k, float d);
 
-    // spring scalars (stiffness, damper, viscosity)
-    float k_;
-    float d_;
+    // views of the particles the spring is connected to
+    PointMass Left() const;
+    PointMass Right() const;
 
-    // spring lengths
-    float rest_;
-    float curr_;
+    // the table and particles being viewed
+    SpringTable* springs_;
+    ParticleSystem* particles_;
 
-    // pointers to the balls the spring is connected to
-    PointMass* right_;
-    PointMass* left_;
+    // spring index in the table
+    unsigned int index;
 };
 
+inline unsigned int SpringTable::Size() const
+{
+    return left_.size();
+}
+
 std::ostream & operator << (std::ostream &outStream, const Spring &spring);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,218 @@
+// kernel declarations
+#include "SpringKernels.h"
+
+// getenv, strcmp
+#include <cstdlib>
+#include <cstring>
+
+// the vector kernels are compiled for their own target so the rest of the program runs on any x86-64 cpu
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPRING_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+//
+// Scalar
+//
+
+// the reference loop of the table
+static void SpringKernelScalar(const SpringTable &springs, ParticleSystem &particles, unsigned int first, unsigned int last)
+{
+    springs.ComputeForces(particles, first, last);
+}
+
+#ifdef SPRING_KERNELS_X86
+
+//
+// AVX2, 8 springs at a time
+//
+
+__attribute__((target("avx2,fma")))
+static void SpringKernelAvx2(const SpringTable &springs, ParticleSystem &particles, unsigned int first, unsigned int last)
+{
+    const float* pos_x = particles.pos_x_.data();
+    const float* pos_y = particles.pos_y_.data();
+    const float* pos_z = particles.pos_z_.data();
+    const float* vel_x = particles.vel_x_.data();
+    const float* vel_y = particles.vel_y_.data();
+    const float* vel_z = particles.vel_z_.data();
+    float* force_x = particles.force_x_.data();
+    float* force_y = particles.force_y_.data();
+    float* force_z = particles.force_z_.data();
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    // AVX2 has gathers but no scatter, the updated forces go back through these one lane at a time
+    alignas(32) unsigned int left_index[8], right_index[8];
+    alignas(32) float left_x[8], left_y[8], left_z[8], right_x[8], right_y[8], right_z[8];
+
+    for (unsigned int s = first; s < last; s += 8)
+    {
+        __m256i left = _mm256_loadu_si256((const __m256i*)(springs.left_.data() + s));
+        __m256i right = _mm256_loadu_si256((const __m256i*)(springs.right_.data() + s));
+
+        // spring vectors (from left to right) and current lengths
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(pos_x, right, 4), _mm256_i32gather_ps(pos_x, left, 4));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(pos_y, right, 4), _mm256_i32gather_ps(pos_y, left, 4));
+        __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(pos_z, right, 4), _mm256_i32gather_ps(pos_z, left, 4));
+        __m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+        // unit spring directions
+        __m256 inv_length = _mm256_div_ps(one, length);
+        dx = _mm256_mul_ps(dx, inv_length);
+        dy = _mm256_mul_ps(dy, inv_length);
+        dz = _mm256_mul_ps(dz, inv_length);
+
+        // relative velocities projected onto the springs
+        __m256 relative = _mm256_mul_ps(_mm256_sub_ps(_mm256_i32gather_ps(vel_x, right, 4), _mm256_i32gather_ps(vel_x, left, 4)), dx);
+        relative = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_i32gather_ps(vel_y, right, 4), _mm256_i32gather_ps(vel_y, left, 4)), dy, relative);
+        relative = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_i32gather_ps(vel_z, right, 4), _mm256_i32gather_ps(vel_z, left, 4)), dz, relative);
+
+        // -k (length - rest) - d relative
+        __m256 stretch = _mm256_sub_ps(length, _mm256_loadu_ps(springs.rest_.data() + s));
+        __m256 magnitude = _mm256_fmadd_ps(_mm256_loadu_ps(springs.k_.data() + s), stretch,
+                                           _mm256_mul_ps(_mm256_loadu_ps(springs.d_.data() + s), relative));
+        magnitude = _mm256_sub_ps(_mm256_setzero_ps(), magnitude);
+        __m256 fx = _mm256_mul_ps(magnitude, dx);
+        __m256 fy = _mm256_mul_ps(magnitude, dy);
+        __m256 fz = _mm256_mul_ps(magnitude, dz);
+
+        // no two springs share a particle, so gathering, updating and writing back is race free
+        _mm256_store_ps(left_x, _mm256_sub_ps(_mm256_i32gather_ps(force_x, left, 4), fx));
+        _mm256_store_ps(left_y, _mm256_sub_ps(_mm256_i32gather_ps(force_y, left, 4), fy));
+        _mm256_store_ps(left_z, _mm256_sub_ps(_mm256_i32gather_ps(force_z, left, 4), fz));
+        _mm256_store_ps(right_x, _mm256_add_ps(_mm256_i32gather_ps(force_x, right, 4), fx));
+        _mm256_store_ps(right_y, _mm256_add_ps(_mm256_i32gather_ps(force_y, right, 4), fy));
+        _mm256_store_ps(right_z, _mm256_add_ps(_mm256_i32gather_ps(force_z, right, 4), fz));
+        _mm256_store_si256((__m256i*)left_index, left);
+        _mm256_store_si256((__m256i*)right_index, right);
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            force_x[left_index[lane]] = left_x[lane];
+            force_y[left_index[lane]] = left_y[lane];
+            force_z[left_index[lane]] = left_z[lane];
+            force_x[right_index[lane]] = right_x[lane];
+            force_y[right_index[lane]] = right_y[lane];
+            force_z[right_index[lane]] = right_z[lane];
+        }
+    }
+}
+
+//
+// AVX-512, 16 springs at a time
+//
+
+__attribute__((target("avx512f")))
+static void SpringKernelAvx512(const SpringTable &springs, ParticleSystem &particles, unsigned int first, unsigned int last)
+{
+    const float* pos_x = particles.pos_x_.data();
+    const float* pos_y = particles.pos_y_.data();
+    const float* pos_z = particles.pos_z_.data();
+    const float* vel_x = particles.vel_x_.data();
+    const float* vel_y = particles.vel_y_.data();
+    const float* vel_z = particles.vel_z_.data();
+    float* force_x = particles.force_x_.data();
+    float* force_y = particles.force_y_.data();
+    float* force_z = particles.force_z_.data();
+
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    for (unsigned int s = first; s < last; s += 16)
+    {
+        __m512i left = _mm512_loadu_si512((const void*)(springs.left_.data() + s));
+        __m512i right = _mm512_loadu_si512((const void*)(springs.right_.data() + s));
+
+        // spring vectors (from left to right) and current lengths
+        __m512 dx = _mm512_sub_ps(_mm512_i32gather_ps(right, pos_x, 4), _mm512_i32gather_ps(left, pos_x, 4));
+        __m512 dy = _mm512_sub_ps(_mm512_i32gather_ps(right, pos_y, 4), _mm512_i32gather_ps(left, pos_y, 4));
+        __m512 dz = _mm512_sub_ps(_mm512_i32gather_ps(right, pos_z, 4), _mm512_i32gather_ps(left, pos_z, 4));
+        __m512 length = _mm512_sqrt_ps(_mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz))));
+        // unit spring directions
+        __m512 inv_length = _mm512_div_ps(one, length);
+        dx = _mm512_mul_ps(dx, inv_length);
+        dy = _mm512_mul_ps(dy, inv_length);
+        dz = _mm512_mul_ps(dz, inv_length);
+
+        // relative velocities projected onto the springs
+        __m512 relative = _mm512_mul_ps(_mm512_sub_ps(_mm512_i32gather_ps(right, vel_x, 4), _mm512_i32gather_ps(left, vel_x, 4)), dx);
+        relative = _mm512_fmadd_ps(_mm512_sub_ps(_mm512_i32gather_ps(right, vel_y, 4), _mm512_i32gather_ps(left, vel_y, 4)), dy, relative);
+        relative = _mm512_fmadd_ps(_mm512_sub_ps(_mm512_i32gather_ps(right, vel_z, 4), _mm512_i32gather_ps(left, vel_z, 4)), dz, relative);
+
+        // -k (length - rest) - d relative
+        __m512 stretch = _mm512_sub_ps(length, _mm512_loadu_ps(springs.rest_.data() + s));
+        __m512 magnitude = _mm512_fmadd_ps(_mm512_loadu_ps(springs.k_.data() + s), stretch,
+                                           _mm512_mul_ps(_mm512_loadu_ps(springs.d_.data() + s), relative));
+        magnitude = _mm512_sub_ps(_mm512_setzero_ps(), magnitude);
+        __m512 fx = _mm512_mul_ps(magnitude, dx);
+        __m512 fy = _mm512_mul_ps(magnitude, dy);
+        __m512 fz = _mm512_mul_ps(magnitude, dz);
+
+        // no two springs share a particle, so the gather, add, scatter sequence is race free
+        _mm512_i32scatter_ps(force_x, left, _mm512_sub_ps(_mm512_i32gather_ps(left, force_x, 4), fx), 4);
+        _mm512_i32scatter_ps(force_y, left, _mm512_sub_ps(_mm512_i32gather_ps(left, force_y, 4), fy), 4);
+        _mm512_i32scatter_ps(force_z, left, _mm512_sub_ps(_mm512_i32gather_ps(left, force_z, 4), fz), 4);
+        _mm512_i32scatter_ps(force_x, right, _mm512_add_ps(_mm512_i32gather_ps(right, force_x, 4), fx), 4);
+        _mm512_i32scatter_ps(force_y, right, _mm512_add_ps(_mm512_i32gather_ps(right, force_y, 4), fy), 4);
+        _mm512_i32scatter_ps(force_z, right, _mm512_add_ps(_mm512_i32gather_ps(right, force_z, 4), fz), 4);
+    }
+}
+
+#endif // SPRING_KERNELS_X86
+
+//
+// Dispatch
+//
+
+SimdLevel DetectSimdLevel()
+{
+    SimdLevel level = kScalar;
+#ifdef SPRING_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        level = kAvx2;
+    if (__builtin_cpu_supports("avx512f"))
+        level = kAvx512;
+#endif
+
+    // allow forcing a narrower kernel, for comparisons
+    const char* request = getenv("CLOTH_SIMD");
+    if (request != NULL)
+    {
+        if (strcmp(request, "scalar") == 0)
+            level = kScalar;
+        else if (strcmp(request, "avx2") == 0 && level > kAvx2)
+            level = kAvx2;
+    }
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case (kAvx2):
+            return "avx2";
+        case (kAvx512):
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+SpringKernel GetSpringKernel(SimdLevel level)
+{
+    switch (level)
+    {
+#ifdef SPRING_KERNELS_X86
+        case (kAvx2):
+            return SpringKernelAvx2;
+        case (kAvx512):
+            return SpringKernelAvx512;
+#endif
+        default:
+            return SpringKernelScalar;
+    }
+}
+
+SpringKernel SelectSpringKernel()
+{
+    return GetSpringKernel(DetectSimdLevel());
+}
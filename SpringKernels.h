@@ -0,0 +1,27 @@
+#ifndef SPRING_KERNELS_H
+#define SPRING_KERNELS_H
+
+// the spring table and particle arrays the kernels work on
+#include "Spring.h"
+
+// instruction sets a spring kernel can be written for, in increasing width
+enum SimdLevel : unsigned int
+{
+    kScalar = 0,
+    kAvx2 = 1,
+    kAvx512 = 2
+};
+
+// a kernel computes the forces of springs [first, last) of a table, the springs must not share any particle
+// and their number must be a multiple of SPRING_BATCH
+typedef void (*SpringKernel)(const SpringTable &springs, ParticleSystem &particles, unsigned int first, unsigned int last);
+
+// widest instruction set supported by the cpu, can be lowered with CLOTH_SIMD=scalar|avx2 in the environment
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// kernel for a given level, and the one for the detected level
+SpringKernel GetSpringKernel(SimdLevel level);
+SpringKernel SelectSpringKernel();
+
+#endif // SPRING_KERNELS_H
@@ -0,0 +1,91 @@
+// class declaration
+#include "StepController.h"
+
+// the estimate runs on the worker threads
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// particles handed to a thread at a time
+#define STEP_GRAIN 4096
+
+// constructor
+StepController::StepController()
+{
+    min_step_ = MIN_STEP;
+    max_step_ = MAX_STEP;
+    safety_ = STEP_SAFETY;
+    cfl_ = STEP_CFL;
+    growth_ = STEP_GROWTH;
+    estimate_ = MAX_STEP;
+}
+
+float StepController::StableStep(const ParticleSystem &particles, const SpringTable &springs, ThreadPool* pool)
+{
+    // stiffest and most damped free particle, the fastest one and the shortest spring it has, pinned particles have
+    // no inverse mass and do not move. Every chunk keeps its own maxima, the order they are combined in does not
+    // matter
+    unsigned int chunks = (particles.Size() + STEP_GRAIN - 1) / STEP_GRAIN;
+    partial_.assign(4 * chunks, 0.0f);
+    ThreadPool::RunRange(pool, 0, particles.Size(), STEP_GRAIN, [this, &particles, &springs] (unsigned int first,
+                                                                                            unsigned int last)
+    {
+        float max_w2 = 0.0f, max_g = 0.0f, max_v2 = 0.0f, max_inv_rest = 0.0f;
+        for (unsigned int p = first; p < last; p++)
+        {
+            float inv_mass = particles.inv_mass_[p];
+            if (inv_mass == 0.0f)
+                continue;
+            float sum_k = 0.0f, sum_d = 0.0f;
+            if (!springs.incidence_offsets_.empty())
+                for (unsigned int i = springs.incidence_offsets_[p]; i < springs.incidence_offsets_[p + 1]; i++)
+                {
+                    unsigned int s = springs.incidence_[i] >> 1;
+                    sum_k += springs.k_[s];
+                    sum_d += springs.d_[s];
+                    if (springs.rest_[s] > 0.0f)
+                        max_inv_rest = std::max(max_inv_rest, 1.0f / springs.rest_[s]);
+                }
+            max_w2 = std::max(max_w2, 2.0f * sum_k * inv_mass);
+            max_g = std::max(max_g, 2.0f * sum_d * inv_mass);
+            max_v2 = std::max(max_v2, particles.vel_x_[p] * particles.vel_x_[p]
+                                    + particles.vel_y_[p] * particles.vel_y_[p]
+                                    + particles.vel_z_[p] * particles.vel_z_[p]);
+        }
+        float* partial = &partial_[4 * (first / STEP_GRAIN)];
+        partial[0] = max_w2;
+        partial[1] = max_g;
+        partial[2] = max_v2;
+        partial[3] = max_inv_rest;
+    });
+    float max_w2 = 0.0f, max_g = 0.0f, max_v2 = 0.0f, max_inv_rest = 0.0f;
+    for (unsigned int c = 0; c < chunks; c++)
+    {
+        max_w2 = std::max(max_w2, partial_[4 * c]);
+        max_g = std::max(max_g, partial_[4 * c + 1]);
+        max_v2 = std::max(max_v2, partial_[4 * c + 2]);
+        max_inv_rest = std::max(max_inv_rest, partial_[4 * c + 3]);
+    }
+
+    // a share of the positive root of w^2 h^2 + 2 g h - 4 = 0, or of 2 / g without springs that pull
+    float step = max_step_;
+    if (max_w2 > 0.0f)
+        step = safety_ * (std::sqrt(max_g * max_g + 4.0f * max_w2) - max_g) / max_w2;
+    else if (max_g > 0.0f)
+        step = safety_ * 2.0f / max_g;
+
+    // no particle crosses more than a share of the shortest spring of a moving particle
+    if (max_v2 > 0.0f && max_inv_rest > 0.0f)
+        step = std::min(step, cfl_ / (max_inv_rest * std::sqrt(max_v2)));
+    return step;
+}
+
+float StepController::Update(const ParticleSystem &particles, const SpringTable &springs, float step,
+                             ThreadPool* pool)
+{
+    estimate_ = StableStep(particles, springs, pool);
+    // shrink at once when the cloth got stiffer, but grow slowly so a lull does not overshoot
+    float next = std::min(estimate_, step * growth_);
+    return std::max(min_step_, std::min(max_step_, next));
+}
@@ -0,0 +1,54 @@
+#ifndef STEP_CONTROLLER_H
+#define STEP_CONTROLLER_H
+
+// the particles and springs of the cloth
+#include "ParticleSystem.h"
+#include "Spring.h"
+
+#include <vector>
+
+// pool the estimate runs on
+class ThreadPool;
+
+// default limits of the explicit time step in seconds
+#define MIN_STEP 1e-5f
+#define MAX_STEP (1.0f / 240.0f)
+// share of the estimated stable step of the springs actually taken
+#define STEP_SAFETY 0.5f
+// largest share of the shortest spring a particle may cross in one step
+#define STEP_CFL 0.25f
+// largest growth of the step from one frame to the next, shrinking is immediate
+#define STEP_GROWTH 1.25f
+
+// picks the step of the explicit integrator from a stability estimate of the current cloth.
+// For symplectic Euler on a damped oscillator with eigenvalue w^2 = k / m and damping rate g = d / m the step is
+// stable while h^2 w^2 + 2 h g < 4, and bounding the largest eigenvalue of the springs by the row sums of the
+// stiffness and damping matrices (Gershgorin) gives, per particle, w^2 <= 2 sum(k) / m and g <= 2 sum(d) / m.
+// A share safety_ of that step is taken. A second, CFL like, bound keeps every particle from moving further than a
+// share cfl_ of the shortest rest length, which is already a share and is taken as it is.
+class StepController
+{
+    public:
+    // constructor
+    StepController();
+
+    // largest stable step for the springs and particles as they are now, one pass over the particles on pool
+    float StableStep(const ParticleSystem &particles, const SpringTable &springs, ThreadPool* pool);
+    // moves the step towards the stable one, growing at most by growth_ per call, and returns it
+    float Update(const ParticleSystem &particles, const SpringTable &springs, float step, ThreadPool* pool);
+
+    // settings
+    float min_step_;
+    float max_step_;
+    float safety_;
+    float cfl_;
+    float growth_;
+    // stable step found by the last update, before the limits
+    float estimate_;
+
+    private:
+    // stiffness, damping, speed and inverse rest length maxima of every chunk of particles
+    std::vector<float> partial_;
+};
+
+#endif // STEP_CONTROLLER_H
@@ -0,0 +1,192 @@
+// class declaration
+#include "ThreadPool.h"
+
+// std::min and std::max
+#include <algorithm>
+
+// scoped timers
+#include "Profiler.h"
+
+// thread affinity
+#include <pthread.h>
+#include <sched.h>
+
+// how many times a thread polls before blocking on a condition variable (a few tens of microseconds)
+#define SPIN_COUNT 2000
+
+// tells the cpu we are busy waiting
+static inline void CpuRelax()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// constructor starts the workers, they sleep until a job comes in
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    grain_size_ = DEFAULT_GRAIN;
+    generation_ = 0;
+    busy_ = 0;
+    quit_ = false;
+    task_ = NULL;
+    first_ = last_ = 0;
+    grain_ = 1;
+    next_ = 0;
+
+    // the calling thread is the first member of the pool
+    for (unsigned int worker = 1; worker < threads; worker++)
+        workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+// destructor
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (unsigned int worker = 0; worker < workers_.size(); worker++)
+        workers_[worker].join();
+}
+
+unsigned int ThreadPool::Size() const
+{
+    return workers_.size() + 1;
+}
+
+void ThreadPool::SetGrain(unsigned int grain)
+{
+    grain_size_ = std::max(1u, grain);
+}
+
+unsigned int ThreadPool::Grain() const
+{
+    return grain_size_;
+}
+
+bool ThreadPool::PinToCores()
+{
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    bool pinned = true;
+    for (unsigned int worker = 0; worker < workers_.size(); worker++)
+    {
+        // worker i is the (i + 1)th member of the pool, core 0 is left to the calling thread
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET((worker + 1) % cores, &cpus);
+        pinned &= pthread_setaffinity_np(workers_[worker].native_handle(), sizeof(cpu_set_t), &cpus) == 0;
+    }
+    return pinned;
+}
+
+void ThreadPool::ParallelFor(unsigned int first, unsigned int last, const RangeTask &task)
+{
+    ParallelFor(first, last, grain_size_, task);
+}
+
+void ThreadPool::RunRange(ThreadPool* pool, unsigned int first, unsigned int last, unsigned int grain,
+                          const RangeTask &task)
+{
+    if (grain == 0)
+        grain = 1;
+    if (pool && !pool->workers_.empty())
+    {
+        pool->ParallelFor(first, last, grain, task);
+        return;
+    }
+    while (first < last)
+    {
+        unsigned int end = last - first > grain ? first + grain : last;
+        task(first, end);
+        first = end;
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int first, unsigned int last, unsigned int grain, const RangeTask &task)
+{
+    if (first >= last)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    // not worth waking anybody up
+    if (workers_.empty() || last - first <= grain)
+    {
+        task(first, last);
+        return;
+    }
+
+    // publish the job, the generation is bumped last so spinning workers see a complete job
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        first_ = first;
+        last_ = last;
+        grain_ = grain;
+        next_ = first;
+        busy_ = workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    // help out, then wait for the stragglers (briefly spinning, they are usually just finishing a chunk)
+    RunChunks();
+    for (unsigned int spin = 0; spin < SPIN_COUNT && busy_ != 0; spin++)
+        CpuRelax();
+    if (busy_ != 0)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return busy_ == 0; });
+    }
+    task_ = NULL;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    unsigned long seen = 0;
+    while (true)
+    {
+        // poll for the next phase for a little while
+        for (unsigned int spin = 0; spin < SPIN_COUNT && generation_ == seen && !quit_; spin++)
+            CpuRelax();
+
+        // then sleep until there is a new job or the pool shuts down
+        if (generation_ == seen)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, seen] { return quit_ || generation_ != seen; });
+        }
+        if (quit_)
+            return;
+        seen = generation_;
+
+        RunChunks();
+
+        // last one out tells the caller
+        if (busy_.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunChunks()
+{
+    // one event per thread and phase, not per chunk
+    PROFILE_SCOPE("Chunks");
+    while (true)
+    {
+        unsigned int chunk = next_.fetch_add(grain_);
+        if (chunk >= last_)
+            return;
+        (*task_)(chunk, std::min(chunk + grain_, last_));
+    }
+}
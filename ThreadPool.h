@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// worker threads and their synchronisation
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// default number of indices handed to a thread at a time by the per particle loops
+#define DEFAULT_GRAIN 1024
+
+// persistent pool of worker threads splitting index ranges into chunks, the calling thread takes part in the work.
+// Every ParallelFor returns once all of its chunks are done, so consecutive calls are phases separated by a barrier.
+// Workers spin for a short while after a phase before going to sleep, so back to back phases do not pay for a wake up.
+class ThreadPool
+{
+    public:
+    // a task processes the indices [first, last)
+    typedef std::function<void(unsigned int first, unsigned int last)> RangeTask;
+
+    // constructor, 0 threads means one per hardware thread (the caller counts as one of them)
+    ThreadPool(unsigned int threads);
+    // destructor joins the workers
+    ~ThreadPool();
+
+    // number of threads working on a range, including the caller
+    unsigned int Size() const;
+
+    // chunk size used when a loop does not ask for one
+    void SetGrain(unsigned int grain);
+    unsigned int Grain() const;
+
+    // binds worker i to core i (modulo the core count), the calling thread is left free to move
+    bool PinToCores();
+
+    // runs task over [first, last) in chunks of grain indices and returns once every chunk is done,
+    // chunks are handed out dynamically so a task must not depend on which thread runs it (no nesting)
+    void ParallelFor(unsigned int first, unsigned int last, unsigned int grain, const RangeTask &task);
+    // same with the pool's grain
+    void ParallelFor(unsigned int first, unsigned int last, const RangeTask &task);
+    // runs task over [first, last) in chunks of grain indices, on pool when it has workers and one chunk after the
+    // other on the calling thread otherwise, so results kept per chunk (at first / grain) are the same either way
+    static void RunRange(ThreadPool* pool, unsigned int first, unsigned int last, unsigned int grain,
+                         const RangeTask &task);
+
+    private:
+    // worker thread body
+    void WorkerLoop();
+    // grab and run chunks of the current job until there are none left
+    void RunChunks();
+
+    std::vector<std::thread> workers_;
+    unsigned int grain_size_;
+
+    // job hand over
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::atomic<unsigned long> generation_;
+    std::atomic<unsigned int> busy_;
+    std::atomic<bool> quit_;
+
+    // the current job
+    const RangeTask* task_;
+    unsigned int first_;
+    unsigned int last_;
+    unsigned int grain_;
+    std::atomic<unsigned int> next_;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,400 @@
+// class declaration
+#include "Timeline.h"
+
+// the recorded simulation
+#include "Simulation.h"
+
+// std::min, std::max
+#include <algorithm>
+#include <cstring>
+
+// seven bits a byte, the high bit set on every byte but the last
+static inline void PutVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// returns NULL when the varint runs past end or is too long
+static inline const uint8_t* GetVarint(const uint8_t* in, const uint8_t* end, uint32_t &value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 35 && in < end; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return in;
+    }
+    return NULL;
+}
+
+// constructor
+Timeline::Timeline()
+{
+    key_steps_ = TIMELINE_KEY_STEPS;
+    budget_ = (size_t)TIMELINE_BUDGET_MB << 20;
+    bytes_ = 0;
+    current_step_ = 0;
+    settled_step_ = 0;
+    sought_ = false;
+}
+
+void Timeline::Start(const Simulation &simulation)
+{
+    Clear();
+    // no budget, no history
+    if (budget_ == 0)
+        return;
+    KeyState state;
+    TakeState(simulation, state);
+    last_positions_ = state.positions;
+    AddSegment(state, 0);
+}
+
+void Timeline::Clear()
+{
+    segments_.clear();
+    bytes_ = 0;
+    current_step_ = 0;
+    settled_step_ = 0;
+    last_positions_.clear();
+    sought_ = false;
+}
+
+void Timeline::Split(const Simulation &simulation)
+{
+    if (budget_ == 0)
+        return;
+    if (segments_.empty() || last_positions_.size() != 3 * (size_t)simulation.object_->mass_particles_.Size())
+    {
+        Start(simulation);
+        return;
+    }
+    if (sought_)
+        ResumeSought();
+    settled_step_ = current_step_;
+    // already a key frame
+    Segment &last = segments_.back();
+    if (last.frames.size() == 1 && last.frames.front().step == current_step_)
+        return;
+
+    // the last tick moves from the frames of the segment to the key of the next
+    if (last.frames.size() > 1)
+    {
+        size_t bytes = sizeof(Frame) + last.frames.back().delta.size();
+        last.bytes -= bytes;
+        bytes_ -= bytes;
+        last.frames.pop_back();
+    }
+    KeyState state;
+    TakeState(simulation, state);
+    last_positions_ = state.positions;
+    AddSegment(state, current_step_);
+    EnforceBudget();
+}
+
+uint64_t Timeline::FirstStep() const
+{
+    return segments_.empty() ? 0 : segments_.front().frames.front().step;
+}
+
+uint64_t Timeline::LastStep() const
+{
+    return segments_.empty() ? 0 : segments_.back().frames.back().step;
+}
+
+void Timeline::TakeState(const Simulation &simulation, KeyState &state)
+{
+    const ParticleSystem &particles = simulation.object_->mass_particles_;
+    size_t n = particles.Size();
+    state.positions.resize(3 * n);
+    state.velocities.resize(3 * n);
+    std::copy(particles.pos_x_.begin(), particles.pos_x_.begin() + n, state.positions.begin());
+    std::copy(particles.pos_y_.begin(), particles.pos_y_.begin() + n, state.positions.begin() + n);
+    std::copy(particles.pos_z_.begin(), particles.pos_z_.begin() + n, state.positions.begin() + 2 * n);
+    std::copy(particles.vel_x_.begin(), particles.vel_x_.begin() + n, state.velocities.begin());
+    std::copy(particles.vel_y_.begin(), particles.vel_y_.begin() + n, state.velocities.begin() + n);
+    std::copy(particles.vel_z_.begin(), particles.vel_z_.begin() + n, state.velocities.begin() + 2 * n);
+    state.flags.assign(particles.flags_.begin(), particles.flags_.begin() + n);
+    state.time = simulation.time_;
+    state.pending_time = simulation.pending_time_;
+    state.delta_time = simulation.delta_time_;
+    state.wind_dir[0] = simulation.wind_dir_.x;
+    state.wind_dir[1] = simulation.wind_dir_.y;
+    state.wind_dir[2] = simulation.wind_dir_.z;
+}
+
+void Timeline::PutState(const KeyState &state, Simulation &simulation)
+{
+    ParticleSystem &particles = simulation.object_->mass_particles_;
+    size_t n = particles.Size();
+    std::copy(state.positions.begin(), state.positions.begin() + n, particles.pos_x_.begin());
+    std::copy(state.positions.begin() + n, state.positions.begin() + 2 * n, particles.pos_y_.begin());
+    std::copy(state.positions.begin() + 2 * n, state.positions.end(), particles.pos_z_.begin());
+    std::copy(state.velocities.begin(), state.velocities.begin() + n, particles.vel_x_.begin());
+    std::copy(state.velocities.begin() + n, state.velocities.begin() + 2 * n, particles.vel_y_.begin());
+    std::copy(state.velocities.begin() + 2 * n, state.velocities.end(), particles.vel_z_.begin());
+    std::copy(state.flags.begin(), state.flags.end(), particles.flags_.begin());
+    simulation.time_ = state.time;
+    simulation.pending_time_ = state.pending_time;
+    simulation.delta_time_ = state.delta_time;
+    simulation.wind_dir_ = glm::vec3(state.wind_dir[0], state.wind_dir[1], state.wind_dir[2]);
+}
+
+void Timeline::AddSegment(KeyState &state, uint64_t step)
+{
+    segments_.push_back(Segment());
+    Segment &segment = segments_.back();
+    Frame frame;
+    frame.step = step;
+    frame.delta_time = state.delta_time;
+    std::copy(state.wind_dir, state.wind_dir + 3, frame.wind_dir);
+    segment.frames.push_back(frame);
+    segment.key.positions.swap(state.positions);
+    segment.key.velocities.swap(state.velocities);
+    segment.key.flags.swap(state.flags);
+    segment.key.time = state.time;
+    segment.key.pending_time = state.pending_time;
+    segment.key.delta_time = state.delta_time;
+    std::copy(state.wind_dir, state.wind_dir + 3, segment.key.wind_dir);
+    segment.bytes = sizeof(Segment) + sizeof(Frame)
+                    + (segment.key.positions.size() + segment.key.velocities.size()) * sizeof(float)
+                    + segment.key.flags.size() * sizeof(unsigned int);
+    bytes_ += segment.bytes;
+}
+
+void Timeline::CodeFrame(const std::vector<float> &positions, std::vector<uint8_t> &delta)
+{
+    // byte b of every xor-ed word goes to plane b
+    size_t count = positions.size();
+    planes_.resize(4 * count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t word, last;
+        memcpy(&word, &positions[i], sizeof(word));
+        memcpy(&last, &last_positions_[i], sizeof(last));
+        word ^= last;
+        for (unsigned int b = 0; b < 4; b++)
+            planes_[b * count + i] = (uint8_t)(word >> (8 * b));
+    }
+
+    // literal bytes, runs of zeros as a zero byte and the run length
+    delta.clear();
+    uint32_t run = 0;
+    for (size_t i = 0; i < planes_.size(); i++)
+    {
+        if (planes_[i] == 0)
+        {
+            run++;
+            continue;
+        }
+        if (run > 0)
+        {
+            delta.push_back(0);
+            PutVarint(delta, run - 1);
+            run = 0;
+        }
+        delta.push_back(planes_[i]);
+    }
+    if (run > 0)
+    {
+        delta.push_back(0);
+        PutVarint(delta, run - 1);
+    }
+    delta.shrink_to_fit();
+}
+
+bool Timeline::DecodeFrame(const std::vector<uint8_t> &delta, std::vector<float> &positions)
+{
+    size_t count = positions.size();
+    planes_.resize(4 * count);
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+    size_t i = 0;
+    while (in < end && i < planes_.size())
+    {
+        if (*in != 0)
+        {
+            planes_[i++] = *in++;
+            continue;
+        }
+        uint32_t run;
+        in = GetVarint(in + 1, end, run);
+        if (!in || run >= planes_.size() - i)
+            return false;
+        memset(&planes_[i], 0, run + 1);
+        i += run + 1;
+    }
+    if (i != planes_.size() || in != end)
+        return false;
+
+    for (size_t w = 0; w < count; w++)
+    {
+        uint32_t word;
+        memcpy(&word, &positions[w], sizeof(word));
+        for (unsigned int b = 0; b < 4; b++)
+            word ^= (uint32_t)planes_[b * count + w] << (8 * b);
+        memcpy(&positions[w], &word, sizeof(word));
+    }
+    return true;
+}
+
+void Timeline::Record(const Simulation &simulation, unsigned int steps)
+{
+    if (budget_ == 0 || steps == 0)
+        return;
+    // a history of another cloth, or none yet
+    if (segments_.empty() || last_positions_.size() != 3 * (size_t)simulation.object_->mass_particles_.Size())
+    {
+        Start(simulation);
+        return;
+    }
+
+    // the frames after a step sought are replaced by the ones from it
+    if (sought_)
+        ResumeSought();
+    current_step_ += steps;
+
+    Segment &last = segments_.back();
+    if (current_step_ - last.frames.front().step >= key_steps_)
+    {
+        KeyState state;
+        TakeState(simulation, state);
+        last_positions_ = state.positions;
+        AddSegment(state, current_step_);
+    }
+    else
+    {
+        const ParticleSystem &particles = simulation.object_->mass_particles_;
+        size_t n = particles.Size();
+        positions_.resize(3 * n);
+        std::copy(particles.pos_x_.begin(), particles.pos_x_.begin() + n, positions_.begin());
+        std::copy(particles.pos_y_.begin(), particles.pos_y_.begin() + n, positions_.begin() + n);
+        std::copy(particles.pos_z_.begin(), particles.pos_z_.begin() + n, positions_.begin() + 2 * n);
+        last.frames.push_back(Frame());
+        Frame &frame = last.frames.back();
+        frame.step = current_step_;
+        frame.delta_time = simulation.delta_time_;
+        frame.wind_dir[0] = simulation.wind_dir_.x;
+        frame.wind_dir[1] = simulation.wind_dir_.y;
+        frame.wind_dir[2] = simulation.wind_dir_.z;
+        CodeFrame(positions_, frame.delta);
+        size_t bytes = sizeof(Frame) + frame.delta.size();
+        last.bytes += bytes;
+        bytes_ += bytes;
+        last_positions_.swap(positions_);
+    }
+    EnforceBudget();
+}
+
+void Timeline::ResumeSought()
+{
+    Truncate(current_step_);
+    // a step inside a tick becomes a key frame, the ticks after it start from there
+    if (LastStep() != current_step_)
+    {
+        AddSegment(sought_state_, current_step_);
+        last_positions_ = segments_.back().key.positions;
+    }
+    else
+        last_positions_.swap(sought_state_.positions);
+    // the ticks from here on are taken with the current settings
+    settled_step_ = std::min(settled_step_, current_step_);
+    sought_ = false;
+}
+
+uint64_t Timeline::Seek(uint64_t step, Simulation &simulation)
+{
+    if (segments_.empty()
+        || segments_.front().key.positions.size() != 3 * (size_t)simulation.object_->mass_particles_.Size())
+        return current_step_;
+    step = std::max(FirstStep(), std::min(step, LastStep()));
+
+    // the last key frame at or before the step
+    size_t s = segments_.size() - 1;
+    while (segments_[s].frames.front().step > step)
+        s--;
+    const Segment &segment = segments_[s];
+    PutState(segment.key, simulation);
+
+    // the ticks after it again, each with its own step size and wind, unless they were taken with other settings
+    uint64_t reached = segment.frames.front().step;
+    if (step < settled_step_)
+        step = reached;
+    for (size_t f = 1; f < segment.frames.size() && reached < step; f++)
+    {
+        const Frame &frame = segment.frames[f];
+        simulation.delta_time_ = frame.delta_time;
+        simulation.wind_dir_ = glm::vec3(frame.wind_dir[0], frame.wind_dir[1], frame.wind_dir[2]);
+        uint64_t until = std::min(frame.step, step);
+        for (; reached < until; reached++)
+            simulation.Step();
+    }
+    // a step inside the tick that ends on the next key frame
+    if (reached < step && s + 1 < segments_.size())
+    {
+        const Frame &frame = segments_[s + 1].frames.front();
+        simulation.delta_time_ = frame.delta_time;
+        simulation.wind_dir_ = glm::vec3(frame.wind_dir[0], frame.wind_dir[1], frame.wind_dir[2]);
+        for (; reached < step; reached++)
+            simulation.Step();
+    }
+
+    current_step_ = step;
+    sought_ = true;
+    TakeState(simulation, sought_state_);
+    return step;
+}
+
+bool Timeline::Preview(uint64_t step, ParticleSystem &particles)
+{
+    size_t n = particles.Size();
+    if (segments_.empty() || segments_.front().key.positions.size() != 3 * n)
+        return false;
+    step = std::max(FirstStep(), std::min(step, LastStep()));
+
+    size_t s = segments_.size() - 1;
+    while (segments_[s].frames.front().step > step)
+        s--;
+    const Segment &segment = segments_[s];
+    positions_ = segment.key.positions;
+    for (size_t f = 1; f < segment.frames.size() && segment.frames[f].step <= step; f++)
+        if (!DecodeFrame(segment.frames[f].delta, positions_))
+            return false;
+
+    std::copy(positions_.begin(), positions_.begin() + n, particles.pos_x_.begin());
+    std::copy(positions_.begin() + n, positions_.begin() + 2 * n, particles.pos_y_.begin());
+    std::copy(positions_.begin() + 2 * n, positions_.end(), particles.pos_z_.begin());
+    return true;
+}
+
+void Timeline::Truncate(uint64_t step)
+{
+    while (segments_.size() > 1 && segments_.back().frames.front().step > step)
+    {
+        bytes_ -= segments_.back().bytes;
+        segments_.pop_back();
+    }
+    Segment &last = segments_.back();
+    while (last.frames.size() > 1 && last.frames.back().step > step)
+    {
+        size_t bytes = sizeof(Frame) + last.frames.back().delta.size();
+        last.bytes -= bytes;
+        bytes_ -= bytes;
+        last.frames.pop_back();
+    }
+}
+
+void Timeline::EnforceBudget()
+{
+    while (bytes_ > budget_ && segments_.size() > 1)
+    {
+        bytes_ -= segments_.front().bytes;
+        segments_.pop_front();
+    }
+}
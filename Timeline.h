@@ -0,0 +1,140 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class ParticleSystem;
+class Simulation;
+
+// default steps between key frames
+#define TIMELINE_KEY_STEPS 240
+// default memory the history may take, in MB
+#define TIMELINE_BUDGET_MB 256
+
+// the recent history of a running simulation, kept in memory to seek back to any step of it. Every tick that steps
+// the cloth is recorded as a frame. A frame at least key_steps_ steps after the last key frame is a key frame: the
+// positions and velocities of every particle, the explicit step and the simulated time, as they are. The frames
+// between key frames only keep the positions, coded against the frame before them: the bits of every float xor-ed with
+// the previous ones, split into byte planes (signs and exponents hardly ever change) and zero runs coded. Seeking
+// restores the key frame at or before the step and takes the steps after it again, tick by tick with the step size
+// and wind direction each tick had, which lands on the very same state. Preview decodes the positions of a recorded tick alone, for
+// scrubbing without simulating. When the history takes more than budget_ bytes the oldest key frame and the frames
+// after it are dropped. Seeking then stepping from there replaces the frames after the step sought. Seeking replays
+// with the current settings, so a change of setting splits the history: the state becomes a key frame, and seeking
+// to a step recorded before it stops at the key frame at or before that step rather than take the ticks again with
+// settings they were not taken with. A new cloth or a reset restarts the history.
+class Timeline
+{
+    public:
+    // constructor
+    Timeline();
+
+    // forgets the history, the state of simulation is the first key frame, at step 0
+    void Start(const Simulation &simulation);
+    void Clear();
+    // the settings of simulation changed, its state becomes a key frame that the ticks after it replay from
+    void Split(const Simulation &simulation);
+
+    // records the state of simulation after a tick of steps steps
+    void Record(const Simulation &simulation, unsigned int steps);
+
+    // puts simulation back at step (kept within the history), returns the step reached
+    uint64_t Seek(uint64_t step, Simulation &simulation);
+    // the positions of the last tick recorded at or before step, into particles, without simulating. Returns false
+    // when there is no history or it is of another cloth
+    bool Preview(uint64_t step, ParticleSystem &particles);
+
+    bool Empty() const;
+    // the oldest and newest steps recorded, and the one simulation is at
+    uint64_t FirstStep() const;
+    uint64_t LastStep() const;
+    uint64_t CurrentStep() const;
+    // memory taken by the history
+    size_t Bytes() const;
+
+    // settings
+    unsigned int key_steps_;
+    size_t budget_;
+
+    private:
+    // the particles as they were at a key frame
+    struct KeyState
+    {
+        std::vector<float> positions;
+        std::vector<float> velocities;
+        // the contacts of the last step, which the self collision of the next one reads
+        std::vector<unsigned int> flags;
+        double time;
+        double pending_time;
+        float delta_time;
+        float wind_dir[3];
+    };
+
+    // a recorded tick: the step reached, the step size and wind direction it took and its positions coded against the
+    // tick before (nothing for the key frame)
+    struct Frame
+    {
+        uint64_t step;
+        float delta_time;
+        float wind_dir[3];
+        std::vector<uint8_t> delta;
+    };
+
+    // a key frame and the ticks after it
+    struct Segment
+    {
+        KeyState key;
+        std::vector<Frame> frames;
+        size_t bytes;
+    };
+
+    // copies the state of simulation
+    static void TakeState(const Simulation &simulation, KeyState &state);
+    static void PutState(const KeyState &state, Simulation &simulation);
+    // a new segment keyed on state, reached at step
+    void AddSegment(KeyState &state, uint64_t step);
+    // after a seek back, drops the frames after the step sought and goes on from its state
+    void ResumeSought();
+    // xor codes positions against last_positions_ into delta
+    void CodeFrame(const std::vector<float> &positions, std::vector<uint8_t> &delta);
+    // undoes CodeFrame on positions, which hold the frame before
+    bool DecodeFrame(const std::vector<uint8_t> &delta, std::vector<float> &positions);
+    // drops the ticks after step, from seeking back
+    void Truncate(uint64_t step);
+    // drops the oldest segments while over budget, always keeping the newest
+    void EnforceBudget();
+
+    std::deque<Segment> segments_;
+    size_t bytes_;
+    uint64_t current_step_;
+    // first step taken with the current settings, the ticks before it are not taken again
+    uint64_t settled_step_;
+    // the positions of the newest frame, the next is coded against them
+    std::vector<float> last_positions_;
+    // a seek back leaves the frames after it until the next record, which replaces them from the state sought
+    bool sought_;
+    KeyState sought_state_;
+    // reused buffers
+    std::vector<float> positions_;
+    std::vector<uint8_t> planes_;
+};
+
+inline bool Timeline::Empty() const
+{
+    return segments_.empty();
+}
+
+inline uint64_t Timeline::CurrentStep() const
+{
+    return current_step_;
+}
+
+inline size_t Timeline::Bytes() const
+{
+    return bytes_;
+}
+
+#endif // TIMELINE_H
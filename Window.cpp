@@ -36,6 +36,10 @@ Window::Window(QWidget* parent) : QWidget(parent)
     open_obj_ = new QAction(tr("&Open .obj"));
     open_ppm_ = new QAction(tr("&Open .ppm"));
     save_obj_ = new QAction(tr("&Save .obj"));
+    record_trace_ = new QAction(tr("&Record trace"));
+    record_trace_->setCheckable(true);
+    record_frames_ = new QAction(tr("Record &frames"));
+    record_frames_->setCheckable(true);
     // connect to file IO
     QObject::connect(open_obj_, SIGNAL(triggered()), this, SLOT(OpenObjDialog()));
     QObject::connect(this, SIGNAL(SelectedReadObj(QString)), simulator_, SLOT(ReadObjFile(QString)));
@@ -43,10 +47,19 @@ Window::Window(QWidget* parent) : QWidget(parent)
     QObject::connect(this, SIGNAL(SelectedReadPpm(QString)), simulator_, SLOT(ReadPpmFile(QString)));
     QObject::connect(save_obj_, SIGNAL(triggered()), this, SLOT(SaveObjDialog()));
     QObject::connect(this, SIGNAL(SelectedWriteObj(QString)), simulator_, SLOT(WriteObjFile(QString)));
+    QObject::connect(record_trace_, SIGNAL(toggled(bool)), this, SLOT(RecordTrace(bool)));
+    QObject::connect(this, SIGNAL(StartedTrace()), simulator_, SLOT(StartTrace()));
+    QObject::connect(this, SIGNAL(SelectedWriteTrace(QString)), simulator_, SLOT(WriteTrace(QString)));
+    QObject::connect(record_frames_, SIGNAL(toggled(bool)), this, SLOT(RecordFrames(bool)));
+    QObject::connect(this, SIGNAL(SelectedRecordFrames(QString)), simulator_, SLOT(StartRecording(QString)));
+    QObject::connect(this, SIGNAL(StoppedRecording()), simulator_, SLOT(StopRecording()));
     // add to menu
     file_menu_->addAction(open_obj_);
     file_menu_->addAction(open_ppm_);
     file_menu_->addAction(save_obj_);
+    file_menu_->addSeparator();
+    file_menu_->addAction(record_trace_);
+    file_menu_->addAction(record_frames_);
 
     // create scene menu
     scene_menu_ = menu_bar_->addMenu(tr("&Scene"));
@@ -74,10 +87,24 @@ Window::Window(QWidget* parent) : QWidget(parent)
     QObject::connect(stop_, SIGNAL(pressed()), timer_, SLOT(stop()));
     QObject::connect(reset_, SIGNAL(pressed()), timer_, SLOT(stop()));
     QObject::connect(reset_, SIGNAL(pressed()), simulator_, SLOT(ResetSimulation()));
+    // simulation speed readout
+    rate_label_ = new QLabel(tr("sim/real -"), this);
+    QObject::connect(simulator_, SIGNAL(SimulationRate(QString)), rate_label_, SLOT(setText(QString)));
+    // timeline of the recent steps, pressing it stops the playback
+    timeline_slider_ = new QSlider(Qt::Horizontal, this);
+    timeline_slider_->setRange(0, 0);
+    QObject::connect(simulator_, SIGNAL(TimelineChanged(int, int, int)), this, SLOT(UpdateTimeline(int, int, int)));
+    QObject::connect(timeline_slider_, SIGNAL(sliderPressed()), timer_, SLOT(stop()));
+    QObject::connect(timeline_slider_, SIGNAL(valueChanged(int)), this, SLOT(ScrubTimeline(int)));
+    QObject::connect(timeline_slider_, SIGNAL(sliderReleased()), this, SLOT(ReleaseTimeline()));
+    QObject::connect(this, SIGNAL(SelectedStep(int)), simulator_, SLOT(SeekTimeline(int)));
+    QObject::connect(this, SIGNAL(PreviewedStep(int)), simulator_, SLOT(PreviewTimeline(int)));
     // add to the control layout
     player_layout_->addWidget(play_, 0, 0);
     player_layout_->addWidget(stop_, 0, 1);
     player_layout_->addWidget(reset_, 0, 2);
+    player_layout_->addWidget(rate_label_, 0, 3);
+    player_layout_->addWidget(timeline_slider_, 1, 0, 1, 4);
 
 
     // init the cloth properties controller
@@ -90,11 +117,13 @@ Window::Window(QWidget* parent) : QWidget(parent)
     damp_label_ = new QLabel(tr("dampening"), this);
     damp_slider_ = new QSlider(Qt::Horizontal, this);
     show_mass_ = new QCheckBox(tr("&show mass points"));
+    show_hud_ = new QCheckBox(tr("show &performance"));
     // connect widgets
     QObject::connect(mass_slider_, SIGNAL(valueChanged(int)), simulator_, SLOT(UpdateMass(int)));
     QObject::connect(stiff_slider_, SIGNAL(valueChanged(int)), simulator_, SLOT(UpdateStiffness(int)));
     QObject::connect(damp_slider_, SIGNAL(valueChanged(int)), simulator_, SLOT(UpdateDampening(int)));
     QObject::connect(show_mass_, SIGNAL(stateChanged(int)), simulator_, SLOT(ShowPoints(int)));
+    QObject::connect(show_hud_, SIGNAL(stateChanged(int)), simulator_, SLOT(ShowHud(int)));
     // set widget settings
     cloth_group_->setMaximumWidth(300);
     mass_slider_->setRange(10, 100);
@@ -111,6 +140,7 @@ Window::Window(QWidget* parent) : QWidget(parent)
     cloth_layout_->addWidget(damp_label_, 2, 0);
     cloth_layout_->addWidget(damp_slider_, 2, 1);
     cloth_layout_->addWidget(show_mass_, 3, 0);
+    cloth_layout_->addWidget(show_hud_, 3, 1);
     // set the box's layout
     cloth_group_->setLayout(cloth_layout_);
 
@@ -183,19 +213,30 @@ Window::Window(QWidget* parent) : QWidget(parent)
     integration_boxes_ = new QButtonGroup;
     exp_Euler_ = new QCheckBox(tr("&explicit Euler")); 
     imp_Euler_ = new QCheckBox(tr("&implicit Euler"));
+    xpbd_ = new QCheckBox(tr("&XPBD"));
+    projective_ = new QCheckBox(tr("&projective dynamics"));
+    self_collision_ = new QCheckBox(tr("self co&llision"));
     // connect the widgets
 
     // set widget settings
     integration_group_->setMaximumWidth(300);
     integration_boxes_->addButton(exp_Euler_, 0);// int is button id
     integration_boxes_->addButton(imp_Euler_, 1);
+    integration_boxes_->addButton(xpbd_, 2);
+    integration_boxes_->addButton(projective_, 3);
     integration_boxes_->setExclusive(true);
     imp_Euler_->setCheckState(Qt::Checked);
+    // self collision is not a scheme, it stays out of the exclusive group and starts as the simulation was configured
+    self_collision_->setChecked(simulator_->simulation_->object_->self_collision_.enabled_);
     // connect checkboxes
     QObject::connect(integration_boxes_, SIGNAL(buttonClicked(QAbstractButton*)), this, SLOT(SetIntegrationMethod(QAbstractButton*)));
+    QObject::connect(self_collision_, SIGNAL(stateChanged(int)), simulator_, SLOT(UpdateSelfCollision(int)));
     // add to the layout
     integration_layout_->addWidget(exp_Euler_);
     integration_layout_->addWidget(imp_Euler_);
+    integration_layout_->addWidget(xpbd_);
+    integration_layout_->addWidget(projective_);
+    integration_layout_->addWidget(self_collision_);
     // set the box's layout
     integration_group_->setLayout(integration_layout_);
 
@@ -270,6 +311,36 @@ void Window::SaveObjDialog()
     }
 }
 
+// starts recording when checked, asks where to save the trace when unchecked (an empty name drops it)
+void Window::RecordTrace(bool record)
+{
+    if (record)
+    {
+        emit StartedTrace();
+        return;
+    }
+    QString file_name = QFileDialog::getSaveFileName(this, tr("Save trace"), "./trace.json", tr(".json (*.json)"));
+    emit SelectedWriteTrace(file_name);
+}
+
+// asks where to record when checked (no name unchecks it again), stops recording when unchecked
+void Window::RecordFrames(bool record)
+{
+    if (!record)
+    {
+        emit StoppedRecording();
+        return;
+    }
+    QString file_name = QFileDialog::getSaveFileName(this, tr("Record frames"), "./frame.obj",
+                                                     tr(".obj sequence (*.obj);;point cache (*.clothpc)"));
+    if (file_name.isEmpty())
+    {
+        record_frames_->setChecked(false);
+        return;
+    }
+    emit SelectedRecordFrames(file_name);
+}
+
 void Window::SetGravitySlider(QAbstractButton* box_clicked)
 {
     // call the setValue slider slot, which will update the gavity applied on the cloth
@@ -294,12 +365,47 @@ void Window::SetIntegrationMethod(QAbstractButton* box_clicked)
     {
         // explicit euler
         case (0):
-            simulator_->method_ = SimulationWidget::kExplicitEuler;
+            simulator_->simulation_->method_ = Simulation::kExplicitEuler;
             break;
         // implicit euler
         case (1):
-            simulator_->method_ = SimulationWidget::kImplicitEuler;
+            simulator_->simulation_->method_ = Simulation::kImplicitEuler;
+            break;
+        // extended position based dynamics
+        case (2):
+            simulator_->simulation_->method_ = Simulation::kXpbd;
+            break;
+        // projective dynamics
+        case (3):
+            simulator_->simulation_->method_ = Simulation::kProjectiveDynamics;
             break;
     }
+    // the history was simulated with the other method, seeking into it goes back to its key frames only
+    simulator_->SplitTimeline();
+}
+
+// the slider follows the simulation unless it is being dragged
+void Window::UpdateTimeline(int first, int last, int current)
+{
+    if (timeline_slider_->isSliderDown())
+        return;
+    timeline_slider_->blockSignals(true);
+    timeline_slider_->setRange(first, last);
+    timeline_slider_->setValue(current);
+    timeline_slider_->blockSignals(false);
+}
+
+// while dragging only the recorded positions are shown, a click or a key seeks at once
+void Window::ScrubTimeline(int step)
+{
+    if (timeline_slider_->isSliderDown())
+        emit PreviewedStep(step);
+    else
+        emit SelectedStep(step);
+}
+
+void Window::ReleaseTimeline()
+{
+    emit SelectedStep(timeline_slider_->value());
 }
 
@@ -30,14 +30,29 @@ class Window : public QWidget
     void OpenObjDialog();
     void OpenPpmDialog();
     void SaveObjDialog();
+    void RecordTrace(bool record);
+    void RecordFrames(bool record);
     void SetGravitySlider(QAbstractButton* box_clicked);
     void SetIntegrationMethod(QAbstractButton* box_clicked);
+    // timeline slots: follows the simulation's history, and scrubs through it
+    void UpdateTimeline(int first, int last, int current);
+    void ScrubTimeline(int step);
+    void ReleaseTimeline();
 
     // signals for file loading and saving
     signals:
     void SelectedReadObj(QString file_name);
     void SelectedReadPpm(QString file_name);
     void SelectedWriteObj(QString file_name);
+    // signals for recording a trace of the simulation phases
+    void StartedTrace();
+    void SelectedWriteTrace(QString file_name);
+    // signals for recording the cloth as a sequence of .obj files
+    void SelectedRecordFrames(QString file_name);
+    void StoppedRecording();
+    // signals for going back to a step of the timeline, for good or only to show it
+    void SelectedStep(int step);
+    void PreviewedStep(int step);
 
     private:
 
@@ -61,6 +76,10 @@ class Window : public QWidget
     QAction* open_obj_;
     QAction* open_ppm_;
     QAction* save_obj_;
+    // starts recording a trace, writes it out when unchecked
+    QAction* record_trace_;
+    // asks where to record a sequence of .obj files, stops when unchecked
+    QAction* record_frames_;
 
     // widgets for changing scenes
     QMenu* scene_menu_;
@@ -85,6 +104,10 @@ class Window : public QWidget
     CtrlButton* play_;
     CtrlButton* stop_;
     CtrlButton* reset_;
+    // achieved simulation speed
+    QLabel* rate_label_;
+    // the steps held by the timeline, dragging it shows them and letting go seeks to one
+    QSlider* timeline_slider_;
 
     //
     // SIMULATION PROPERTIES EDITOR
@@ -100,6 +123,7 @@ class Window : public QWidget
     QLabel* damp_label_;
     QSlider* damp_slider_;
     QCheckBox* show_mass_;
+    QCheckBox* show_hud_;
     // container for simulation properties
     QGroupBox* properties_group_;
     QVBoxLayout* properties_layout_;
@@ -125,6 +149,9 @@ class Window : public QWidget
     QVBoxLayout* integration_layout_;
     QCheckBox* exp_Euler_;
     QCheckBox* imp_Euler_;
+    QCheckBox* xpbd_;
+    QCheckBox* projective_;
+    QCheckBox* self_collision_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,203 @@
+// class declaration
+#include "XpbdSolver.h"
+
+// the pool the passes run on
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// number of springs or particles handed to a thread at a time
+#define XPBD_GRAIN 2048
+
+// constructor
+XpbdSolver::XpbdSolver()
+{
+    mode_ = kGaussSeidel;
+    iterations_ = XPBD_ITERATIONS;
+    substeps_ = XPBD_SUBSTEPS;
+    relaxation_ = XPBD_RELAXATION;
+}
+
+// destructor
+XpbdSolver::~XpbdSolver()
+{
+    // arrays release themselves
+}
+
+void XpbdSolver::Build(const SpringTable &springs, unsigned int particle_count)
+{
+    prev_x_.assign(particle_count, 0.0f);
+    prev_y_.assign(particle_count, 0.0f);
+    prev_z_.assign(particle_count, 0.0f);
+    lambda_.assign(springs.Size(), 0.0f);
+    correction_x_.assign(springs.Size(), 0.0f);
+    correction_y_.assign(springs.Size(), 0.0f);
+    correction_z_.assign(springs.Size(), 0.0f);
+    // the color classes the Gauss-Seidel passes go through, a single one when the springs are not colored
+    classes_ = springs.color_offsets_;
+    if (classes_.empty())
+    {
+        classes_.push_back(0);
+        classes_.push_back(springs.Size());
+    }
+}
+
+void XpbdSolver::Clear()
+{
+    Build(SpringTable(), 0);
+}
+
+void XpbdSolver::Predict(ParticleSystem &particles, float h, ThreadPool* pool)
+{
+    ThreadPool::RunRange(pool, 0, particles.Size(), XPBD_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            // explicit step for the external forces (pinned particles have no inverse mass and no velocity)
+            float step = particles.inv_mass_[p] * h;
+            particles.vel_x_[p] += particles.force_x_[p] * step;
+            particles.vel_y_[p] += particles.force_y_[p] * step;
+            particles.vel_z_[p] += particles.force_z_[p] * step;
+            prev_x_[p] = particles.pos_x_[p];
+            prev_y_[p] = particles.pos_y_[p];
+            prev_z_[p] = particles.pos_z_[p];
+            particles.pos_x_[p] += particles.vel_x_[p] * h;
+            particles.pos_y_[p] += particles.vel_y_[p] * h;
+            particles.pos_z_[p] += particles.vel_z_[p] * h;
+        }
+    });
+}
+
+void XpbdSolver::Project(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool)
+{
+    // the multipliers accumulate over the iterations of a substep only
+    std::fill(lambda_.begin(), lambda_.end(), 0.0f);
+    for (unsigned int iteration = 0; iteration < iterations_; iteration++)
+    {
+        if (mode_ == kJacobi)
+            ProjectJacobi(particles, springs, h, pool);
+        else
+            ProjectGaussSeidel(particles, springs, h, pool);
+    }
+}
+
+void XpbdSolver::UpdateVelocities(ParticleSystem &particles, float h, ThreadPool* pool)
+{
+    float inv_h = 1.0f / h;
+    ThreadPool::RunRange(pool, 0, particles.Size(), XPBD_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            particles.vel_x_[p] = (particles.pos_x_[p] - prev_x_[p]) * inv_h;
+            particles.vel_y_[p] = (particles.pos_y_[p] - prev_y_[p]) * inv_h;
+            particles.vel_z_[p] = (particles.pos_z_[p] - prev_z_[p]) * inv_h;
+        }
+    });
+}
+
+// XPBD update of a distance constraint C = |x_r - x_l| - rest with compliance alpha = 1 / k and damping d:
+//      dlambda = (-C - alpha~ lambda - gamma grad C . (x - x_prev)) / ((1 + gamma) (w_l + w_r) + alpha~)
+// where alpha~ = alpha / h^2 and gamma = alpha~ d h
+float XpbdSolver::ConstraintDelta(const ParticleSystem &particles, const SpringTable &springs, unsigned int s, float h, float n[3]) const
+{
+    unsigned int left = springs.left_[s];
+    unsigned int right = springs.right_[s];
+    float weight = particles.inv_mass_[left] + particles.inv_mass_[right];
+    if (weight == 0.0f || springs.k_[s] <= 0.0f)
+        return 0.0f;
+
+    n[0] = particles.pos_x_[right] - particles.pos_x_[left];
+    n[1] = particles.pos_y_[right] - particles.pos_y_[left];
+    n[2] = particles.pos_z_[right] - particles.pos_z_[left];
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f)
+        return 0.0f;
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+
+    float alpha = 1.0f / (springs.k_[s] * h * h);
+    float gamma = alpha * springs.d_[s] * h;
+    // relative motion of the ends along the spring during the substep
+    float motion = n[0] * ((particles.pos_x_[right] - prev_x_[right]) - (particles.pos_x_[left] - prev_x_[left]))
+                 + n[1] * ((particles.pos_y_[right] - prev_y_[right]) - (particles.pos_y_[left] - prev_y_[left]))
+                 + n[2] * ((particles.pos_z_[right] - prev_z_[right]) - (particles.pos_z_[left] - prev_z_[left]));
+    float constraint = length - springs.rest_[s];
+    return (-constraint - alpha * lambda_[s] - gamma * motion) / ((1.0f + gamma) * weight + alpha);
+}
+
+void XpbdSolver::ProjectGaussSeidel(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool)
+{
+    // within a color class no two springs share a particle, so a class can be projected in parallel, the single class
+    // of uncolored springs cannot
+    if (springs.color_offsets_.empty())
+        pool = NULL;
+
+    for (unsigned int c = 0; c + 1 < classes_.size(); c++)
+        ThreadPool::RunRange(pool, classes_[c], classes_[c + 1], XPBD_GRAIN, [&] (unsigned int first, unsigned int last)
+        {
+            for (unsigned int s = first; s < last; s++)
+            {
+                float n[3];
+                float delta = ConstraintDelta(particles, springs, s, h, n);
+                if (delta == 0.0f)
+                    continue;
+                lambda_[s] += delta;
+                unsigned int left = springs.left_[s];
+                unsigned int right = springs.right_[s];
+                float left_step = particles.inv_mass_[left] * delta;
+                float right_step = particles.inv_mass_[right] * delta;
+                particles.pos_x_[left] -= left_step * n[0];
+                particles.pos_y_[left] -= left_step * n[1];
+                particles.pos_z_[left] -= left_step * n[2];
+                particles.pos_x_[right] += right_step * n[0];
+                particles.pos_y_[right] += right_step * n[1];
+                particles.pos_z_[right] += right_step * n[2];
+            }
+        });
+}
+
+void XpbdSolver::ProjectJacobi(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool)
+{
+    // step 1 every spring works out its correction from the same positions
+    ThreadPool::RunRange(pool, 0, springs.Size(), XPBD_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int s = first; s < last; s++)
+        {
+            // ConstraintDelta leaves n alone for a spring without stiffness or weight, whose correction must be zero
+            float n[3] = { 0.0f, 0.0f, 0.0f };
+            float delta = ConstraintDelta(particles, springs, s, h, n);
+            lambda_[s] += delta;
+            correction_x_[s] = delta * n[0];
+            correction_y_[s] = delta * n[1];
+            correction_z_[s] = delta * n[2];
+        }
+    });
+
+    // step 2 every particle averages the corrections of its springs
+    ThreadPool::RunRange(pool, 0, particles.Size(), XPBD_GRAIN, [&] (unsigned int first, unsigned int last)
+    {
+        for (unsigned int p = first; p < last; p++)
+        {
+            unsigned int begin = springs.incidence_offsets_[p];
+            unsigned int end = springs.incidence_offsets_[p + 1];
+            if (begin == end || particles.inv_mass_[p] == 0.0f)
+                continue;
+            float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+            for (unsigned int i = begin; i < end; i++)
+            {
+                unsigned int s = springs.incidence_[i] >> 1;
+                // the left end moves the other way
+                float sign = (springs.incidence_[i] & 1) ? -1.0f : 1.0f;
+                sum_x += sign * correction_x_[s];
+                sum_y += sign * correction_y_[s];
+                sum_z += sign * correction_z_[s];
+            }
+            float scale = relaxation_ * particles.inv_mass_[p] / (end - begin);
+            particles.pos_x_[p] += scale * sum_x;
+            particles.pos_y_[p] += scale * sum_y;
+            particles.pos_z_[p] += scale * sum_z;
+        }
+    });
+}
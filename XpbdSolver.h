@@ -0,0 +1,74 @@
+#ifndef XPBD_SOLVER_H
+#define XPBD_SOLVER_H
+
+// the particles and springs of the cloth
+#include "ParticleSystem.h"
+#include "Spring.h"
+
+// default solver settings
+#define XPBD_ITERATIONS 4
+#define XPBD_SUBSTEPS 8
+#define XPBD_RELAXATION 1.0f
+
+// pool the constraint passes are spread over
+class ThreadPool;
+
+// extended position based dynamics (Macklin, Muller & Chentanez, XPBD: Position-Based Simulation of Compliant
+// Constrained Dynamics). Every spring is a distance constraint |x_r - x_l| = rest with compliance 1 / k and
+// damping d, so the stiffness and damping of the spring table carry over. A substep predicts positions from the
+// external forces, projects the constraints a fixed number of times and derives the velocities from the motion.
+class XpbdSolver
+{
+    public:
+    // how a projection pass visits the constraints
+    enum Mode : unsigned int
+    {
+        // one color class after the other, every constraint sees the corrections of the classes before it
+        kGaussSeidel = 0,
+        // every constraint from the same positions, corrections averaged per particle
+        kJacobi = 1
+    };
+
+    // constructor
+    XpbdSolver();
+    // destructor
+    ~XpbdSolver();
+
+    // sizes the per spring and per particle arrays, needed again whenever the springs change
+    void Build(const SpringTable &springs, unsigned int particle_count);
+    void Clear();
+
+    // the three phases of a substep of h seconds, the forces in the particles must be the external ones
+    void Predict(ParticleSystem &particles, float h, ThreadPool* pool);
+    void Project(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool);
+    void UpdateVelocities(ParticleSystem &particles, float h, ThreadPool* pool);
+
+    // settings
+    Mode mode_;
+    unsigned int iterations_;
+    unsigned int substeps_;
+    // scales the averaged Jacobi corrections (over relaxation above one)
+    float relaxation_;
+
+    private:
+    // one pass over the constraints
+    void ProjectGaussSeidel(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool);
+    void ProjectJacobi(ParticleSystem &particles, const SpringTable &springs, float h, ThreadPool* pool);
+    // multiplier change of spring s, also returns the unit spring direction in n
+    float ConstraintDelta(const ParticleSystem &particles, const SpringTable &springs, unsigned int s, float h, float n[3]) const;
+
+    // positions at the start of the substep
+    AlignedVector<float> prev_x_;
+    AlignedVector<float> prev_y_;
+    AlignedVector<float> prev_z_;
+    // Lagrange multiplier of every spring, reset every substep
+    AlignedVector<float> lambda_;
+    // correction of every spring on its right end, for the Jacobi passes
+    AlignedVector<float> correction_x_;
+    AlignedVector<float> correction_y_;
+    AlignedVector<float> correction_z_;
+    // color class c is springs classes_[c] .. classes_[c + 1], copied from the spring table by Build
+    std::vector<unsigned int> classes_;
+};
+
+#endif // XPBD_SOLVER_H